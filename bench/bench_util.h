@@ -0,0 +1,40 @@
+#pragma once
+
+// Helpers shared by the benchmarks.
+
+#include <chrono>
+#include <random>
+
+#include "layout.h"
+
+// Largest graph each engine is run on by default.
+inline int size_cap(LayoutEngine engine) {
+  switch (engine) {
+  case LAYOUT_NODE_RESPECTER:
+  case LAYOUT_STRESS:
+    return 10000;
+  default:
+    return 2000000;
+  }
+}
+
+// rand() only reaches 32767 on some platforms, far fewer values than these
+// graphs have nodes. Each bench seeds it before generating a graph.
+inline std::mt19937 rng;
+
+// Uniform in [0, n).
+inline int random_below(int n) {
+  return std::uniform_int_distribution<int>(0, n - 1)(rng);
+}
+
+// Uniform in [0, below).
+inline float random_float(float below) {
+  return std::uniform_real_distribution<float>(0.0f, below)(rng);
+}
+
+using Clock = std::chrono::steady_clock;
+
+inline double ms_since(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
@@ -0,0 +1,267 @@
+// Headless layout benchmark.
+//
+//   layout_bench [--layout=ENGINE] [--threads=N] [--nodes=N] [--all]
+//
+// With --nodes it lays out one synthetic graph with one engine and prints a
+// single result row. Without it, it re-runs itself for every engine and
+// graph size so that each row reports the peak RSS of a fresh process.
+// Engines with quadratic time or memory are skipped on large graphs unless
+// --all is given.
+//
+// Columns: wall time of the layout call, peak RSS of the process, the share
+// of sampled nodes overlapping another node, and normalized stress on
+// sampled BFS pairs (scale-invariant, 0 = distances match graph distance).
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include <algorithm>
+#include <math.h>
+#include <ogdf/basic/Graph.h>
+#include <ogdf/basic/GraphAttributes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "bench_util.h"
+#include "layout.h"
+
+static const int bench_sizes[] = {10000, 50000, 200000, 1000000, 2000000};
+
+static double peak_rss_mb() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return 0.0;
+  return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+  return usage.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+struct BenchGraph {
+  int n = 0;
+  std::vector<float> x, y, w, h;
+  std::vector<int> offsets, adjacency; // undirected CSR
+};
+
+// Random spanning tree plus n/2 random extra edges: connected, average
+// degree 3, node sizes drawn like the viewer's generated scene.
+static void make_graph(int n, ogdf::Graph &G, ogdf::GraphAttributes &GA,
+                       std::vector<ogdf::node> &nodes, BenchGraph &bench) {
+  rng.seed(1);
+  bench.n = n;
+  float side = sqrtf((float)n) * 60.0f;
+  nodes.resize(n);
+  for (int i = 0; i < n; ++i) {
+    ogdf::node v = G.newNode();
+    float t = 2.0f + (float)random_below(5);
+    GA.x(v) = random_float(side);
+    GA.y(v) = random_float(side);
+    GA.width(v) = 20.0f + (float)random_below(80) + 2.0f * t;
+    GA.height(v) = 20.0f + (float)random_below(80) + 2.0f * t;
+    nodes[i] = v;
+  }
+
+  std::vector<std::pair<int, int>> edges;
+  for (int i = 1; i < n; ++i)
+    edges.push_back({random_below(i), i});
+  for (int k = 0; k < n / 2; ++k) {
+    int a = random_below(n), b = random_below(n);
+    if (a != b)
+      edges.push_back({a, b});
+  }
+  bench.offsets.assign(n + 1, 0);
+  for (auto &e : edges) {
+    G.newEdge(nodes[e.first], nodes[e.second]);
+    bench.offsets[e.first + 1]++;
+    bench.offsets[e.second + 1]++;
+  }
+  for (int i = 0; i < n; ++i)
+    bench.offsets[i + 1] += bench.offsets[i];
+  bench.adjacency.resize(bench.offsets[n]);
+  std::vector<int> cursor(bench.offsets.begin(), bench.offsets.end() - 1);
+  for (auto &e : edges) {
+    bench.adjacency[cursor[e.first]++] = e.second;
+    bench.adjacency[cursor[e.second]++] = e.first;
+  }
+}
+
+// Fraction of sampled nodes whose box overlaps any other box. Candidates
+// come from a uniform grid with cells as large as the largest node.
+static double overlap_share(const BenchGraph &g) {
+  float cell = 1.0f;
+  float min_x = g.x[0], min_y = g.y[0];
+  for (int i = 0; i < g.n; ++i) {
+    cell = std::max(cell, std::max(g.w[i], g.h[i]));
+    min_x = std::min(min_x, g.x[i]);
+    min_y = std::min(min_y, g.y[i]);
+  }
+  auto key = [&](long long cx, long long cy) { return (cx << 32) ^ cy; };
+  std::vector<std::pair<long long, int>> cells(g.n);
+  for (int i = 0; i < g.n; ++i) {
+    long long cx = (long long)((g.x[i] - min_x) / cell);
+    long long cy = (long long)((g.y[i] - min_y) / cell);
+    cells[i] = {key(cx, cy), i};
+  }
+  std::sort(cells.begin(), cells.end());
+
+  int samples = std::min(g.n, 20000);
+  int overlapping = 0;
+  for (int s = 0; s < samples; ++s) {
+    int i = (int)((long long)s * g.n / samples);
+    long long cx = (long long)((g.x[i] - min_x) / cell);
+    long long cy = (long long)((g.y[i] - min_y) / cell);
+    bool hit = false;
+    int checked = 0;
+    for (long long dx = -1; dx <= 1 && !hit; ++dx) {
+      for (long long dy = -1; dy <= 1 && !hit; ++dy) {
+        auto it = std::lower_bound(cells.begin(), cells.end(),
+                                   std::make_pair(key(cx + dx, cy + dy), -1));
+        for (; it != cells.end() && it->first == key(cx + dx, cy + dy) &&
+               !hit && checked < 1000;
+             ++it, ++checked) {
+          int j = it->second;
+          hit = j != i &&
+                fabsf(g.x[i] - g.x[j]) * 2.0f < g.w[i] + g.w[j] &&
+                fabsf(g.y[i] - g.y[j]) * 2.0f < g.h[i] + g.h[j];
+        }
+      }
+    }
+    overlapping += hit;
+  }
+  return (double)overlapping / samples;
+}
+
+// Stress over pairs drawn from a few BFS trees, after scaling the layout by
+// the factor that minimises it.
+static double sampled_stress(const BenchGraph &g) {
+  std::vector<int> dist(g.n), queue(g.n);
+  std::vector<double> layout_d, graph_d;
+  rng.seed(2);
+  for (int s = 0; s < 16; ++s) {
+    int source = random_below(g.n);
+    std::fill(dist.begin(), dist.end(), -1);
+    int head = 0, tail = 0;
+    dist[source] = 0;
+    queue[tail++] = source;
+    while (head < tail) {
+      int v = queue[head++];
+      for (int k = g.offsets[v]; k < g.offsets[v + 1]; ++k) {
+        int u = g.adjacency[k];
+        if (dist[u] < 0) {
+          dist[u] = dist[v] + 1;
+          queue[tail++] = u;
+        }
+      }
+    }
+    for (int t = 0; t < 500; ++t) {
+      int target = queue[1 + random_below(std::max(1, tail - 1))];
+      if (target == source || dist[target] <= 0)
+        continue;
+      double dx = g.x[source] - g.x[target];
+      double dy = g.y[source] - g.y[target];
+      layout_d.push_back(sqrt(dx * dx + dy * dy));
+      graph_d.push_back(dist[target]);
+    }
+  }
+  // Weights 1/d^2: optimal scale is sum(e/d) / sum(e^2/d^2).
+  double num = 0.0, den = 0.0;
+  for (size_t k = 0; k < layout_d.size(); ++k) {
+    num += layout_d[k] / graph_d[k];
+    den += layout_d[k] * layout_d[k] / (graph_d[k] * graph_d[k]);
+  }
+  if (den == 0.0)
+    return 0.0;
+  double scale = num / den, stress = 0.0;
+  for (size_t k = 0; k < layout_d.size(); ++k) {
+    double r = scale * layout_d[k] / graph_d[k] - 1.0;
+    stress += r * r;
+  }
+  return stress / layout_d.size();
+}
+
+static int run_one(const LayoutOptions &options, int n) {
+  ogdf::Graph G;
+  ogdf::GraphAttributes GA(G, ogdf::GraphAttributes::nodeGraphics);
+  std::vector<ogdf::node> nodes;
+  BenchGraph bench;
+  make_graph(n, G, GA, nodes, bench);
+
+  Clock::time_point start = Clock::now();
+  run_layout(GA, options);
+  double wall_ms = ms_since(start);
+  double rss = peak_rss_mb();
+
+  bench.x.resize(n);
+  bench.y.resize(n);
+  bench.w.resize(n);
+  bench.h.resize(n);
+  for (int i = 0; i < n; ++i) {
+    bench.x[i] = (float)GA.x(nodes[i]);
+    bench.y[i] = (float)GA.y(nodes[i]);
+    bench.w[i] = (float)GA.width(nodes[i]);
+    bench.h[i] = (float)GA.height(nodes[i]);
+  }
+  printf("%-10s %9d %9d %7d %12.1f %10.1f %9.2f%% %8.4f\n",
+         layout_engine_name(options.engine), n, G.numberOfEdges(),
+         options.threads, wall_ms, rss, 100.0 * overlap_share(bench),
+         sampled_stress(bench));
+  fflush(stdout);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  LayoutOptions options;
+  bool has_engine = false, all = false;
+  int nodes = 0;
+  for (int i = 1; i < argc; ++i) {
+    int parsed = parse_layout_arg(argv[i], options);
+    if (parsed == 1) {
+      has_engine |= strncmp(argv[i], "--layout=", 9) == 0;
+    } else if (parsed == 0 && strncmp(argv[i], "--nodes=", 8) == 0) {
+      nodes = atoi(argv[i] + 8);
+    } else if (parsed == 0 && strcmp(argv[i], "--all") == 0) {
+      all = true;
+    } else {
+      fprintf(stderr, "usage: %s [--nodes=N] [--all] [options]\n", argv[0]);
+      print_layout_usage(stderr);
+      return 2;
+    }
+  }
+
+  if (nodes > 0)
+    return run_one(options, nodes);
+
+  printf("%-10s %9s %9s %7s %12s %10s %10s %8s\n", "engine", "nodes", "edges",
+         "threads", "wall_ms", "peak_mb", "overlap", "stress");
+  fflush(stdout);
+  for (int e = 0; e < LAYOUT_ENGINE_COUNT; ++e) {
+    if (has_engine && e != options.engine)
+      continue;
+    for (int n : bench_sizes) {
+      if (!all && n > size_cap((LayoutEngine)e))
+        continue;
+      char cmd[1024];
+      snprintf(cmd, sizeof(cmd), "\"%s\" --layout=%s --threads=%d --nodes=%d",
+               argv[0], layout_engine_name((LayoutEngine)e), options.threads,
+               n);
+      if (system(cmd) != 0)
+        fprintf(stderr, "%s on %d nodes failed\n",
+                layout_engine_name((LayoutEngine)e), n);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,204 @@
+// Headless benchmark of full versus incremental relayout after small edits.
+//
+//   relayout_bench [--layout=ENGINE] [--threads=N] [--nodes=N] [--edits=N]
+//                  [--budget=MS]
+//
+// Lays out a synthetic graph with the engine, then applies a few live
+// edits through apply_updates() as the viewer does: each edit adds a node
+// next to a random one, linked to it and to one more random node, and every
+// other edit also moves a random node. The edited graph is then laid out
+// again both ways from the same positions: by the engine over the whole
+// graph, warm-started, and by relayout_incremental() around the edits.
+// Without --nodes every size in bench_sizes up to the engine's cap is run
+// in turn. The engine defaults to fme, as the viewer's default is too slow for
+// the larger sizes.
+//
+// Columns: wall time of the initial layout, of the full relayout and of the
+// incremental one, the nodes the incremental one freed and the pinned ones
+// it pushed them against, and the speedup of incremental over full.
+
+#include <math.h>
+#include <ogdf/basic/Graph.h>
+#include <ogdf/basic/GraphAttributes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "bench_util.h"
+#include "graph_stream.h"
+#include "incremental_layout.h"
+#include "layout.h"
+
+static const int bench_sizes[] = {10000, 100000, 1000000};
+
+// Random spanning tree plus n/2 random extra edges, scattered nodes sized
+// like the viewer's generated scene.
+static void make_graph(int n, NodeStore &nodes, EdgeCSR &csr) {
+  rng.seed(1);
+  float side = sqrtf((float)n) * 60.0f;
+  nodes.resize(n);
+  for (int i = 0; i < n; ++i) {
+    nodes.data[i] = (Uint32)i;
+    nodes.x[i] = random_float(side);
+    nodes.y[i] = random_float(side);
+    nodes.width[i] = 20.0f + (float)random_below(80);
+    nodes.height[i] = 20.0f + (float)random_below(80);
+    nodes.border_thickness[i] = 2.0f + (float)random_below(5);
+    nodes.color[i] = pack_rgba(128 + random_below(128),
+                               128 + random_below(128),
+                               128 + random_below(128), 255);
+  }
+  std::vector<Uint32> sources, targets;
+  for (int i = 1; i < n; ++i) {
+    sources.push_back(random_below(i));
+    targets.push_back(i);
+  }
+  for (int k = 0; k < n / 2; ++k) {
+    int a = random_below(n), b = random_below(n);
+    if (a != b) {
+      sources.push_back(a);
+      targets.push_back(b);
+    }
+  }
+  csr.assign(n, sources.data(), targets.data(), sources.size());
+}
+
+// Lays out the whole graph from the current positions, the way the layout
+// worker does, and returns the wall time including the OGDF conversion.
+static double full_layout(NodeStore &nodes, const EdgeCSR &csr,
+                          const LayoutOptions &options) {
+  Clock::time_point start = Clock::now();
+  ogdf::Graph G;
+  ogdf::GraphAttributes GA(G, ogdf::GraphAttributes::nodeGraphics);
+  std::vector<ogdf::node> ogdf_nodes(nodes.size());
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    ogdf::node v = G.newNode();
+    float t = nodes.border_thickness[i];
+    GA.x(v) = nodes.x[i];
+    GA.y(v) = nodes.y[i];
+    GA.width(v) = nodes.width[i] + 2.0f * t;
+    GA.height(v) = nodes.height[i] + 2.0f * t;
+    ogdf_nodes[i] = v;
+  }
+  for (int s = 0; s < csr.node_count; ++s)
+    for (Uint64 e = csr.offsets[s]; e < csr.offsets[s + 1]; ++e)
+      G.newEdge(ogdf_nodes[s], ogdf_nodes[csr.targets[e]]);
+  run_layout(GA, options);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    nodes.x[i] = (float)GA.x(ogdf_nodes[i]);
+    nodes.y[i] = (float)GA.y(ogdf_nodes[i]);
+  }
+  return ms_since(start);
+}
+
+static void make_edits(int n, int count, float step,
+                       const NodeStore &nodes,
+                       std::vector<GraphUpdate> &updates) {
+  rng.seed(3);
+  for (int k = 0; k < count; ++k) {
+    int near = random_below(n);
+    GraphUpdate u = {};
+    u.kind = UPDATE_ADD_NODE;
+    u.x = nodes.x[near] + step;
+    u.y = nodes.y[near];
+    u.color = pack_rgba(255, 255, 255, 255);
+    updates.push_back(u);
+    u = {};
+    u.kind = UPDATE_ADD_EDGE;
+    u.node = (Uint32)(n + k);
+    u.other = (Uint32)near;
+    updates.push_back(u);
+    u.other = (Uint32)(random_below(n));
+    updates.push_back(u);
+    if (k % 2 == 0) {
+      int moved = random_below(n);
+      u = {};
+      u.kind = UPDATE_MOVE_NODE;
+      u.node = (Uint32)moved;
+      u.x = nodes.x[moved] + step;
+      u.y = nodes.y[moved] - step;
+      updates.push_back(u);
+    }
+  }
+}
+
+static void run_one(const LayoutOptions &options, int n, int edits,
+                    double budget_ms) {
+  NodeStore nodes;
+  EdgeLayer edges;
+  SpatialIndex index;
+  make_graph(n, nodes, edges.csr);
+  double initial_ms = full_layout(nodes, edges.csr, options);
+  edges.rebuild(nodes);
+  index.build(nodes);
+
+  std::vector<GraphUpdate> updates;
+  make_edits(n, edits, 60.0f, nodes, updates);
+  UpdateStats stats;
+  stats.track_changes = true;
+  apply_updates(updates.data(), updates.size(), nodes, index, edges, stats);
+
+  // Both relayouts start from the edited positions.
+  NodeStore whole = nodes;
+  IncrementalOptions incremental;
+  incremental.budget_ms = budget_ms;
+  std::vector<int> moved;
+  IncrementalStats result = relayout_incremental(
+      nodes, index, edges, stats.placed, stats.moved, incremental, moved);
+  for (int i : moved) {
+    index.update(i);
+    edges.node_moved(i);
+  }
+  edges.rebuild(nodes);
+  double full_ms = full_layout(whole, edges.csr, options);
+
+  printf("%-10s %9d %9llu %6d %11.1f %9.1f %9.2f %7zu %8zu %8.0fx\n",
+         layout_engine_name(options.engine), n,
+         (unsigned long long)edges.csr.edge_count, edits, initial_ms,
+         full_ms, result.ms, result.freed, result.context,
+         result.ms > 0.0 ? full_ms / result.ms : 0.0);
+  fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+  LayoutOptions options;
+  options.engine = LAYOUT_FAST_MULTIPOLE;
+  int nodes = 0, edits = 10;
+  double budget_ms = 1000.0;
+  for (int i = 1; i < argc; ++i) {
+    int parsed = parse_layout_arg(argv[i], options);
+    if (parsed == 0 && strncmp(argv[i], "--nodes=", 8) == 0) {
+      nodes = atoi(argv[i] + 8);
+      parsed = nodes > 0 ? 1 : -1;
+    }
+    if (parsed == 0 && strncmp(argv[i], "--edits=", 8) == 0) {
+      edits = atoi(argv[i] + 8);
+      parsed = edits > 0 ? 1 : -1;
+    }
+    if (parsed == 0 && strncmp(argv[i], "--budget=", 9) == 0) {
+      budget_ms = atof(argv[i] + 9);
+      parsed = budget_ms > 0.0 ? 1 : -1;
+    }
+    if (parsed != 1) {
+      fprintf(stderr,
+              "usage: %s [--nodes=N] [--edits=N] [--budget=MS] [options]\n",
+              argv[0]);
+      print_layout_usage(stderr);
+      return 2;
+    }
+  }
+
+  printf("%-10s %9s %9s %6s %11s %9s %9s %7s %8s %9s\n", "engine", "nodes",
+         "edges", "edits", "initial_ms", "full_ms", "incr_ms", "freed",
+         "context", "speedup");
+  fflush(stdout);
+  if (nodes > 0) {
+    run_one(options, nodes, edits, budget_ms);
+    return 0;
+  }
+  for (int n : bench_sizes)
+    if (n <= size_cap(options.engine))
+      run_one(options, n, edits, budget_ms);
+  return 0;
+}
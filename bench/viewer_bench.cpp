@@ -0,0 +1,433 @@
+// Headless rendering benchmark.
+//
+//   viewer_bench [--nodes=N] [--frames=N] [--size=WxH] [--render-threads=N]
+//                [--font=PATH] [--out=FILE]
+//
+// Replays scripted camera trajectories over synthetic graphs through the
+// viewer's own draw() and widget code, into an offscreen surface under
+// SDL's dummy video driver, so it runs on machines without a display.
+// Without --nodes every size in bench_sizes is run in turn.
+//
+// Trajectories, each --frames long:
+//   pan      drags across the graph at zoom 1, scrolling the last frame and
+//            repainting the exposed strips like the viewer, with a full
+//            repaint whenever a drag is released
+//   pan_far  the same drags zoomed out to the whole graph
+//   zoom     wheel steps from the whole graph in to MAX_ZOOM and back out
+//   search   types a node's value one digit per frame, repainting only the
+//            widgets, then jumps to the node
+//
+// The result is one JSON document with the index build times per graph and,
+// per trajectory, the p50/p95/p99 and mean milliseconds of each phase plus
+// frames per second and repainted megapixels per second of scene time.
+// Phases: scene (scroll, clear and draw() over the damaged regions),
+// overlay (widgets), search (prefix narrowing and lookup) and frame (all of
+// them). Debug builds log to stdout, so use --out there.
+
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "bench_util.h"
+#include "damage.h"
+#include "scene.h"
+#include "search_index.h"
+#include "widgets.h"
+
+static const int bench_sizes[] = {10000, 100000, 1000000, 10000000};
+
+static constexpr float SPACING = 120.0f; // grid pitch of the generated nodes
+static constexpr float MAX_ZOOM = 4.0f;
+static constexpr int DRAG_FRAMES = 60;
+
+enum Phase { PHASE_SCENE, PHASE_OVERLAY, PHASE_SEARCH, PHASE_FRAME, PHASES };
+static const char *phase_names[PHASES] = {"scene", "overlay", "search",
+                                          "frame"};
+
+// Jittered grid, so every zoom level has the same density, with edges to
+// the right and lower neighbours and one long edge per hundred nodes.
+static void make_graph(int n, NodeStore &nodes, EdgeCSR &csr) {
+  rng.seed(1);
+  int cols = (int)ceilf(sqrtf((float)n));
+  nodes.resize(n);
+  for (int i = 0; i < n; ++i) {
+    nodes.data[i] = (Uint32)rng();
+    nodes.x[i] = (i % cols) * SPACING + (float)random_below(60);
+    nodes.y[i] = (i / cols) * SPACING + (float)random_below(60);
+    nodes.width[i] = 20.0f + (float)random_below(80);
+    nodes.height[i] = 20.0f + (float)random_below(80);
+    nodes.border_thickness[i] = 2.0f + (float)random_below(5);
+    nodes.color[i] = pack_rgba(128 + random_below(128),
+                               128 + random_below(128),
+                               128 + random_below(128), 255);
+  }
+
+  std::vector<Uint32> sources, targets;
+  for (int i = 0; i < n; ++i) {
+    if ((i + 1) % cols != 0 && i + 1 < n) {
+      sources.push_back(i);
+      targets.push_back(i + 1);
+    }
+    if (i + cols < n && random_below(2)) {
+      sources.push_back(i);
+      targets.push_back(i + cols);
+    }
+    if (random_below(100) == 0) {
+      sources.push_back(i);
+      targets.push_back(random_below(n));
+    }
+  }
+  csr.assign(n, sources.data(), targets.data(), sources.size());
+}
+
+// The scene as the viewer holds it, plus the camera.
+struct Bench {
+  SDL_Surface *surface = nullptr;
+  GlyphAtlas *atlas = nullptr;
+  NodeStore nodes;
+  EdgeLayer edges;
+  SpatialIndex index;
+  SearchIndex search;
+  PrefixSearch prefix;
+  DensityPyramid pyramid;
+  GraphHierarchy hierarchy;
+  LabelLayer labels;
+  SceneState scene;
+  TileRenderer *renderer = nullptr;
+
+  float pan_x = 0.0f, pan_y = 0.0f, zoom = 1.0f;
+  Damage damage;
+
+  std::vector<double> samples[PHASES];
+  double pixels = 0.0; // repainted by the scene phase
+
+  // Zoom at which the whole graph fits the surface.
+  float fit_zoom() const {
+    Rect b = index.bounds();
+    float zx = surface->w / SDL_max(b.x2 - b.x1, 1.0f);
+    float zy = surface->h / SDL_max(b.y2 - b.y1, 1.0f);
+    return SDL_min(zx, zy);
+  }
+  void center_on(float x, float y) {
+    pan_x = -x + surface->w / 2.0f / zoom;
+    pan_y = -y + surface->h / 2.0f / zoom;
+  }
+  void center_on_graph() {
+    Rect b = index.bounds();
+    center_on((b.x1 + b.x2) / 2.0f, (b.y1 + b.y2) / 2.0f);
+  }
+};
+
+// Repaints what was damaged, as the viewer's frame loop does, then draws
+// the overlay widgets. input is the search input line, NULL when not
+// searching.
+static void render_frame(Bench &b, const char *input, double search_ms) {
+  Clock::time_point frame_start = Clock::now();
+  SDL_Surface *surface = b.surface;
+  const SDL_PixelFormatDetails *format =
+      SDL_GetPixelFormatDetails(surface->format);
+  Uint32 bg_color = SDL_MapRGB(format, NULL, 50, 50, 50);
+  Uint32 fg_color = SDL_MapRGB(format, NULL, 255, 255, 255);
+  Uint32 active_bg = SDL_MapRGB(format, NULL, 80, 150, 80);
+
+  Clock::time_point start = Clock::now();
+  b.damage.resize(surface->w, surface->h);
+  if (b.damage.scrolled()) {
+    scroll_surface(surface, b.damage.scroll_x, b.damage.scroll_y);
+    b.labels.shift(b.damage.scroll_x, b.damage.scroll_y);
+  }
+  for (const SDL_Rect &region : b.damage.regions()) {
+    SDL_FillSurfaceRect(surface, &region, 0);
+    draw(surface, b.nodes, b.index, b.edges, *b.renderer, b.pyramid,
+         b.hierarchy, b.labels, b.scene, b.atlas, b.pan_x, b.pan_y, b.zoom,
+         region);
+    b.pixels += (double)region.w * region.h;
+  }
+  b.damage.clear();
+  b.samples[PHASE_SCENE].push_back(ms_since(start));
+
+  start = Clock::now();
+  draw_string_widget(surface, surface->w - 80, 10, "60", bg_color, fg_color);
+  draw_ui_widget(surface, surface->w / 2 - 40, 10, "FIND",
+                 b.atlas, input ? active_bg : bg_color, fg_color);
+  draw_ui_widget(surface, surface->w / 2 + 50, 10, "RESET", b.atlas,
+                 bg_color, fg_color);
+  char buf[64];
+  if (!b.nodes.selection.active.empty()) {
+    snprintf(buf, sizeof(buf), "%u", b.nodes.data[b.nodes.selection.active[0]]);
+    draw_ui_widget(surface, 10, 10, buf, b.atlas, bg_color, fg_color);
+  }
+  if (input) {
+    int x = surface->w / 2 - (10 * 4 * 4);
+    snprintf(buf, sizeof(buf), "INPUT: %s", input);
+    draw_ui_widget(surface, x, 60, buf, b.atlas, active_bg, fg_color);
+    snprintf(buf, sizeof(buf), "FOUND: %llu",
+             (unsigned long long)b.prefix.count());
+    draw_ui_widget(surface, x, 110, buf, b.atlas, bg_color, fg_color);
+    int candidates[5];
+    int shown = b.prefix.top(b.search, candidates, 5);
+    for (int k = 0; k < shown; ++k) {
+      snprintf(buf, sizeof(buf), "%u", b.nodes.data[candidates[k]]);
+      draw_ui_widget(surface, x, 160 + 50 * k, buf, b.atlas, bg_color,
+                     fg_color);
+    }
+  }
+  b.samples[PHASE_OVERLAY].push_back(ms_since(start));
+  b.samples[PHASE_FRAME].push_back(ms_since(frame_start) + search_ms);
+}
+
+// Drags in a new direction every DRAG_FRAMES frames; releasing one settles
+// the view with a full repaint, as in the viewer.
+static void run_pan(Bench &b, int frames, float zoom) {
+  static const int steps[4][2] = {{-7, -3}, {5, -6}, {8, 4}, {-4, 7}};
+  b.zoom = zoom;
+  b.center_on_graph();
+  b.damage.add_all();
+  for (int f = 0; f < frames; ++f) {
+    if (f % DRAG_FRAMES == 0) {
+      b.damage.add_all();
+    } else {
+      const int *step = steps[(f / DRAG_FRAMES) % 4];
+      b.pan_x += step[0] / b.zoom;
+      b.pan_y += step[1] / b.zoom;
+      b.damage.scroll(step[0], step[1]);
+    }
+    render_frame(b, NULL, 0.0);
+  }
+}
+
+static void run_zoom(Bench &b, int frames) {
+  float fit = b.fit_zoom();
+  float factor = 1.1f;
+  b.zoom = fit;
+  for (int f = 0; f < frames; ++f) {
+    b.center_on_graph();
+    b.damage.add_all();
+    render_frame(b, NULL, 0.0);
+    if (b.zoom * factor > MAX_ZOOM || b.zoom * factor < fit)
+      factor = 1.0f / factor;
+    b.zoom *= factor;
+  }
+}
+
+// One digit per frame, then a jump to the node; only the widgets are
+// damaged while typing.
+static void run_search(Bench &b, int frames) {
+  rng.seed(2);
+  b.zoom = 1.0f;
+  b.center_on_graph();
+  b.damage.add_all();
+  int f = 0;
+  while (f < frames) {
+    int target = random_below((int)b.nodes.size());
+    char text[16];
+    int len = snprintf(text, sizeof(text), "%u", b.nodes.data[target]);
+    char input[16] = {0};
+    Clock::time_point start = Clock::now();
+    b.prefix.reset(b.search);
+    double search_ms = ms_since(start);
+    for (int k = 0; k < len && f < frames; ++k, ++f) {
+      start = Clock::now();
+      b.prefix.push(b.search, text[k] - '0');
+      search_ms += ms_since(start);
+      b.samples[PHASE_SEARCH].push_back(search_ms);
+      input[k] = text[k];
+      b.damage.add({0, 0, b.surface->w, 400}); // the widget column
+      render_frame(b, input, search_ms);
+      search_ms = 0.0;
+    }
+    if (f++ >= frames)
+      break;
+    start = Clock::now();
+    int i = b.search.find((Uint32)strtoul(input, NULL, 10));
+    search_ms = ms_since(start);
+    b.samples[PHASE_SEARCH].push_back(search_ms);
+    b.nodes.selection.clear();
+    if (i >= 0) {
+      b.nodes.selection.add(i);
+      b.center_on(b.nodes.x[i], b.nodes.y[i]);
+    }
+    b.damage.add_all();
+    render_frame(b, NULL, search_ms);
+  }
+  b.nodes.selection.clear();
+}
+
+static double percentile(const std::vector<double> &sorted, double p) {
+  if (sorted.empty())
+    return 0.0;
+  size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+  return sorted[rank ? rank - 1 : 0];
+}
+
+static void print_trajectory(FILE *out, const char *name, Bench &b,
+                             bool last) {
+  fprintf(out, "        {\"name\": \"%s\", \"frames\": %zu, \"phases\": {",
+          name, b.samples[PHASE_FRAME].size());
+  bool first = true;
+  double totals[PHASES] = {0};
+  for (int p = 0; p < PHASES; ++p) {
+    std::vector<double> &s = b.samples[p];
+    for (double ms : s)
+      totals[p] += ms;
+    if (s.empty())
+      continue;
+    std::sort(s.begin(), s.end());
+    fprintf(out,
+            "%s\n          \"%s\": {\"p50\": %.3f, \"p95\": %.3f, "
+            "\"p99\": %.3f, \"mean\": %.3f}",
+            first ? "" : ",", phase_names[p], percentile(s, 50),
+            percentile(s, 95), percentile(s, 99), totals[p] / s.size());
+    first = false;
+  }
+  double fps = totals[PHASE_FRAME] > 0.0
+                   ? b.samples[PHASE_FRAME].size() * 1000.0 /
+                         totals[PHASE_FRAME]
+                   : 0.0;
+  double mpix = totals[PHASE_SCENE] > 0.0
+                    ? b.pixels / 1000.0 / totals[PHASE_SCENE]
+                    : 0.0;
+  fprintf(out,
+          "},\n          \"fps\": %.1f, \"scene_mpix_per_s\": %.1f}%s\n",
+          fps, mpix, last ? "" : ",");
+  for (std::vector<double> &s : b.samples)
+    s.clear();
+  b.pixels = 0.0;
+}
+
+static void run_graph(FILE *out, int n, int frames, SDL_Surface *surface,
+                      GlyphAtlas *atlas, TileRenderer &renderer, bool last) {
+  Bench b;
+  b.surface = surface;
+  b.atlas = atlas;
+  b.renderer = &renderer;
+  make_graph(n, b.nodes, b.edges.csr);
+
+  double setup[5];
+  Clock::time_point start = Clock::now();
+  b.index.build(b.nodes);
+  setup[0] = ms_since(start);
+  start = Clock::now();
+  b.edges.rebuild(b.nodes);
+  setup[1] = ms_since(start);
+  start = Clock::now();
+  b.pyramid.build(b.nodes);
+  setup[2] = ms_since(start);
+  start = Clock::now();
+  b.search.build(b.nodes);
+  setup[3] = ms_since(start);
+  start = Clock::now();
+  b.hierarchy.build(b.nodes, b.edges.csr);
+  setup[4] = ms_since(start);
+
+  fprintf(out,
+          "    {\"nodes\": %d, \"edges\": %llu,\n"
+          "      \"setup_ms\": {\"spatial_index\": %.1f, \"edges\": %.1f, "
+          "\"pyramid\": %.1f, \"search_index\": %.1f, "
+          "\"hierarchy\": %.1f},\n"
+          "      \"trajectories\": [\n",
+          n, (unsigned long long)b.edges.csr.edge_count, setup[0], setup[1],
+          setup[2], setup[3], setup[4]);
+  run_pan(b, frames, 1.0f);
+  print_trajectory(out, "pan", b, false);
+  run_pan(b, frames, b.fit_zoom());
+  print_trajectory(out, "pan_far", b, false);
+  run_zoom(b, frames);
+  print_trajectory(out, "zoom", b, false);
+  run_search(b, frames);
+  print_trajectory(out, "search", b, true);
+  fprintf(out, "      ]}%s\n", last ? "" : ",");
+  fflush(out);
+}
+
+int main(int argc, char **argv) {
+  int nodes = 0, frames = 300, width = 1600, height = 1000;
+  int render_threads = 0;
+  const char *font_path = "static/Consolas-Regular.ttf";
+  const char *out_path = NULL;
+  for (int i = 1; i < argc; ++i) {
+    bool ok = true;
+    if (strncmp(argv[i], "--nodes=", 8) == 0)
+      ok = (nodes = atoi(argv[i] + 8)) > 0;
+    else if (strncmp(argv[i], "--frames=", 9) == 0)
+      ok = (frames = atoi(argv[i] + 9)) > 0;
+    else if (strncmp(argv[i], "--size=", 7) == 0)
+      ok = sscanf(argv[i] + 7, "%dx%d", &width, &height) == 2 && width > 0 &&
+           height > 0;
+    else if (strncmp(argv[i], "--render-threads=", 17) == 0)
+      ok = (render_threads = atoi(argv[i] + 17)) >= 0;
+    else if (strncmp(argv[i], "--font=", 7) == 0)
+      font_path = argv[i] + 7;
+    else if (strncmp(argv[i], "--out=", 6) == 0)
+      out_path = argv[i] + 6;
+    else
+      ok = false;
+    if (!ok) {
+      fprintf(stderr,
+              "usage: %s [--nodes=N] [--frames=N] [--size=WxH] "
+              "[--render-threads=N] [--font=PATH] [--out=FILE]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+
+  SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "dummy");
+  if (!SDL_Init(SDL_INIT_VIDEO)) {
+    fprintf(stderr, "SDL_Init failed: %s\n", SDL_GetError());
+    return 1;
+  }
+  SDL_Surface *surface =
+      SDL_CreateSurface(width, height, SDL_PIXELFORMAT_XRGB8888);
+  if (!surface) {
+    fprintf(stderr, "SDL_CreateSurface failed: %s\n", SDL_GetError());
+    return 1;
+  }
+
+  // Without the font the widgets fall back to the bitmap font and no
+  // labels are drawn, as in the viewer.
+  std::vector<unsigned char> font_data;
+  GlyphAtlas font_atlas;
+  GlyphAtlas *atlas = NULL;
+  FILE *f = fopen(font_path, "rb");
+  if (f) {
+    fseek(f, 0, SEEK_END);
+    font_data.resize((size_t)ftell(f));
+    fseek(f, 0, SEEK_SET);
+    if (fread(font_data.data(), 1, font_data.size(), f) == font_data.size() &&
+        font_atlas.init(font_data.data()))
+      atlas = &font_atlas;
+    fclose(f);
+  }
+  if (!atlas)
+    fprintf(stderr, "Failed to load %s, using the bitmap font\n", font_path);
+
+  FILE *out = out_path ? fopen(out_path, "w") : stdout;
+  if (!out) {
+    fprintf(stderr, "Failed to open %s\n", out_path);
+    return 1;
+  }
+  TileRenderer renderer(render_threads);
+  fprintf(out,
+          "{\"width\": %d, \"height\": %d, \"render_threads\": %d, "
+          "\"font\": %s,\n  \"graphs\": [\n",
+          width, height, render_threads, atlas ? "true" : "false");
+  if (nodes > 0) {
+    run_graph(out, nodes, frames, surface, atlas, renderer, true);
+  } else {
+    int count = (int)(sizeof(bench_sizes) / sizeof(bench_sizes[0]));
+    for (int k = 0; k < count; ++k)
+      run_graph(out, bench_sizes[k], frames, surface, atlas, renderer,
+                k == count - 1);
+  }
+  fprintf(out, "  ]}\n");
+  if (out != stdout)
+    fclose(out);
+
+  SDL_DestroySurface(surface);
+  SDL_Quit();
+  return 0;
+}
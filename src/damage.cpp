@@ -0,0 +1,119 @@
+#include "damage.h"
+
+#include <string.h>
+
+#include "debug.h"
+
+static bool touching(const SDL_Rect &a, const SDL_Rect &b) {
+  return a.x <= b.x + b.w && b.x <= a.x + a.w && a.y <= b.y + b.h &&
+         b.y <= a.y + a.h;
+}
+
+static long long area(const SDL_Rect &r) { return (long long)r.w * r.h; }
+
+static SDL_Rect merge(const SDL_Rect &a, const SDL_Rect &b) {
+  int x1 = SDL_min(a.x, b.x), y1 = SDL_min(a.y, b.y);
+  int x2 = SDL_max(a.x + a.w, b.x + b.w), y2 = SDL_max(a.y + a.h, b.y + b.h);
+  return {x1, y1, x2 - x1, y2 - y1};
+}
+
+void Damage::resize(int width, int height) {
+  if (width != w || height != h)
+    whole = true;
+  w = width;
+  h = height;
+}
+
+void Damage::add(SDL_Rect r) {
+  if (whole)
+    return;
+  SDL_Rect screen = {0, 0, w, h};
+  if (!SDL_GetRectIntersection(&r, &screen, &r))
+    return;
+
+  // Absorb every rect the new one touches where that adds no area; the
+  // union may touch others, so repeat until it stands alone. Overlapping
+  // rects that are kept apart only get repainted twice.
+  bool merged = true;
+  while (merged) {
+    merged = false;
+    for (size_t k = 0; k < rects.size(); ++k) {
+      SDL_Rect both = merge(rects[k], r);
+      if (touching(rects[k], r) && area(both) <= area(rects[k]) + area(r)) {
+        r = both;
+        rects[k] = rects.back();
+        rects.pop_back();
+        merged = true;
+        break;
+      }
+    }
+  }
+  rects.push_back(r);
+
+  long long total = 0;
+  for (const SDL_Rect &d : rects)
+    total += area(d);
+  if ((int)rects.size() > MAX_RECTS || total * 2 > (long long)w * h)
+    whole = true;
+}
+
+void Damage::scroll(int dx, int dy) {
+  if (whole)
+    return;
+  scroll_x += dx;
+  scroll_y += dy;
+  if (SDL_abs(scroll_x) >= w || SDL_abs(scroll_y) >= h) {
+    whole = true;
+    return;
+  }
+  std::vector<SDL_Rect> moved;
+  moved.swap(rects);
+  for (SDL_Rect r : moved) {
+    r.x += dx;
+    r.y += dy;
+    add(r);
+  }
+  if (dx > 0)
+    add({0, 0, dx, h});
+  else if (dx < 0)
+    add({w + dx, 0, -dx, h});
+  if (dy > 0)
+    add({0, 0, w, dy});
+  else if (dy < 0)
+    add({0, h + dy, w, -dy});
+}
+
+void Damage::clear() {
+  whole = false;
+  rects.clear();
+  scroll_x = scroll_y = 0;
+}
+
+const std::vector<SDL_Rect> &Damage::regions() {
+  if (whole)
+    rects.assign(1, SDL_Rect{0, 0, w, h});
+  return rects;
+}
+
+void scroll_surface(SDL_Surface *surface, int dx, int dy) {
+  int bpp = SDL_BYTESPERPIXEL(surface->format);
+  int w = surface->w - SDL_abs(dx);
+  if (w <= 0 || SDL_abs(dy) >= surface->h)
+    return;
+  Uint8 *pixels = (Uint8 *)surface->pixels;
+  size_t src_x = (size_t)(dx < 0 ? -dx : 0) * bpp;
+  size_t dst_x = (size_t)(dx > 0 ? dx : 0) * bpp;
+  auto move_row = [&](int y) {
+    memmove(pixels + (size_t)y * surface->pitch + dst_x,
+            pixels + (size_t)(y - dy) * surface->pitch + src_x,
+            (size_t)w * bpp);
+  };
+  // Rows are visited so that none is overwritten before it has moved.
+  if (dy > 0) {
+    for (int y = surface->h - 1; y >= dy; --y)
+      move_row(y);
+  } else {
+    for (int y = 0; y < surface->h + dy; ++y)
+      move_row(y);
+  }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <vector>
+
+// Screen regions that changed since the last present. Rects touching each
+// other are merged as they arrive when their bounding box covers no more
+// than the two did, so an L of strips stays two rects; too many rects, or
+// rects covering most of the screen, turn into one full repaint since at
+// that point a single pass is cheaper.
+//
+// A scroll records how far the previous frame's pixels are to be moved
+// before repainting; the caller moves them with scroll_surface() and then
+// presents the whole screen.
+struct Damage {
+  static constexpr int MAX_RECTS = 16;
+
+  int w = 0, h = 0;
+  bool whole = false;
+  std::vector<SDL_Rect> rects;
+  int scroll_x = 0, scroll_y = 0; // pending pixel move
+
+  // Sets the screen size; a change damages everything.
+  void resize(int width, int height);
+  void add_all() { whole = true; }
+  void add(SDL_Rect r);
+  // The screen contents move by (dx, dy): pending rects move along and the
+  // strips scrolled in are damaged.
+  void scroll(int dx, int dy);
+  bool scrolled() const { return !whole && (scroll_x || scroll_y); }
+  bool empty() const { return !whole && rects.empty(); }
+  void clear();
+  // Regions to repaint, in screen coordinates. Unless scrolled(), these
+  // are also the regions to present.
+  const std::vector<SDL_Rect> &regions();
+};
+
+// Moves the surface contents by (dx, dy). Pixels scrolled in keep their old
+// values.
+void scroll_surface(SDL_Surface *surface, int dx, int dy);
@@ -0,0 +1,30 @@
+#pragma once
+
+// Logging and assertion helpers. `log` shadows the libm function of the same
+// name, so include this header after every other include of a translation
+// unit.
+
+#include <assert.h>
+#include <stdio.h>
+
+#ifdef DEBUG
+#define log(...) printf("[LOG] :: " __VA_ARGS__)
+#define assert_eq(x, y, ...)                                                   \
+  if ((x) != (y)) {                                                            \
+    fprintf(stderr, "!!! assertion failed %s != %s\n", #x, #y);                \
+    printf("[FAILED] :: " __VA_ARGS__);                                        \
+    assert(0);                                                                 \
+  }
+#define log_once(...)                                                          \
+  {                                                                            \
+    static bool once = false;                                                  \
+    if (!once) {                                                               \
+      log(__VA_ARGS__);                                                        \
+      once = true;                                                             \
+    }                                                                          \
+  }
+#else
+#define log(...) ((void)0)
+#define assert_eq(x, y, ...) ((void)sizeof((x) != (y)))
+#define log_once(...) ((void)0)
+#endif
@@ -0,0 +1,307 @@
+#include "density_pyramid.h"
+
+#include <math.h>
+
+#include "parallel.h"
+#include "raster.h"
+
+#include "debug.h"
+
+// Average of a cell's colors with its shade; 0 for an empty cell.
+static Uint32 cell_value(Uint32 count, Uint64 r, Uint64 g, Uint64 b,
+                         float norm) {
+  if (count == 0)
+    return 0;
+  // Log scale with a floor, so lone nodes stay visible next to clusters.
+  // Counts raised by add() past the level's maximum saturate.
+  Uint8 shade =
+      (Uint8)SDL_min(64.0f + logf(1.0f + (float)count) * norm, 255.0f);
+  return pack_rgba((Uint8)(r / count), (Uint8)(g / count), (Uint8)(b / count),
+                   shade);
+}
+
+static float shade_norm(Uint32 max_count) {
+  return 191.0f / logf(1.0f + (float)(max_count ? max_count : 1));
+}
+
+void DensityPyramid::build(const NodeStore &nodes) {
+  levels.clear();
+  size_t n = nodes.size();
+  if (n == 0)
+    return;
+  const float *xs = nodes.x.data();
+  const float *ys = nodes.y.data();
+
+  size_t chunks = (size_t)worker_count();
+  std::vector<Rect> chunk_bounds(chunks, Rect{xs[0], ys[0], xs[0], ys[0]});
+  parallel_for(chunks, 1, [&](size_t begin, size_t end) {
+    for (size_t c = begin; c < end; ++c) {
+      Rect &b = chunk_bounds[c];
+      for (size_t i = n * c / chunks; i < n * (c + 1) / chunks; ++i) {
+        b.x1 = xs[i] < b.x1 ? xs[i] : b.x1;
+        b.y1 = ys[i] < b.y1 ? ys[i] : b.y1;
+        b.x2 = xs[i] > b.x2 ? xs[i] : b.x2;
+        b.y2 = ys[i] > b.y2 ? ys[i] : b.y2;
+      }
+    }
+  });
+  Rect node_bounds = chunk_bounds[0];
+  for (const Rect &b : chunk_bounds) {
+    node_bounds.x1 = b.x1 < node_bounds.x1 ? b.x1 : node_bounds.x1;
+    node_bounds.y1 = b.y1 < node_bounds.y1 ? b.y1 : node_bounds.y1;
+    node_bounds.x2 = b.x2 > node_bounds.x2 ? b.x2 : node_bounds.x2;
+    node_bounds.y2 = b.y2 > node_bounds.y2 ? b.y2 : node_bounds.y2;
+  }
+  start(node_bounds);
+  Level &base = levels[0];
+  auto cell_x = [&](size_t i) {
+    return SDL_clamp((int)((xs[i] - bounds.x1) / base.cell), 0, base.w - 1);
+  };
+  auto cell_y = [&](size_t i) {
+    return SDL_clamp((int)((ys[i] - bounds.y1) / base.cell), 0, base.h - 1);
+  };
+
+  // Hidden nodes keep the grid where it was but are not counted.
+  bool any_hidden = !nodes.hidden.empty();
+  auto shown = [&](size_t i) {
+    return !any_hidden || !nodes.hidden.contains((int)i);
+  };
+
+  // Nodes are partitioned into row stripes first, so each thread then
+  // owns its stripe's cells and accumulates without synchronisation.
+  size_t stripes = SDL_min(chunks, (size_t)base.h);
+  std::vector<int> stripe_of_row(base.h);
+  for (size_t s = 0; s < stripes; ++s)
+    for (size_t r = base.h * s / stripes; r < base.h * (s + 1) / stripes; ++r)
+      stripe_of_row[r] = (int)s;
+  std::vector<size_t> slots(chunks * stripes, 0);
+  parallel_for(chunks, 1, [&](size_t begin, size_t end) {
+    for (size_t c = begin; c < end; ++c)
+      for (size_t i = n * c / chunks; i < n * (c + 1) / chunks; ++i)
+        if (shown(i))
+          slots[c * stripes + stripe_of_row[cell_y(i)]]++;
+  });
+  std::vector<size_t> stripe_begin(stripes + 1, 0);
+  size_t total = 0;
+  for (size_t s = 0; s < stripes; ++s) {
+    stripe_begin[s] = total;
+    for (size_t c = 0; c < chunks; ++c) {
+      size_t count = slots[c * stripes + s];
+      slots[c * stripes + s] = total;
+      total += count;
+    }
+  }
+  stripe_begin[stripes] = total;
+  std::vector<Uint32> bucket(total);
+  parallel_for(chunks, 1, [&](size_t begin, size_t end) {
+    for (size_t c = begin; c < end; ++c)
+      for (size_t i = n * c / chunks; i < n * (c + 1) / chunks; ++i)
+        if (shown(i))
+          bucket[slots[c * stripes + stripe_of_row[cell_y(i)]]++] = (Uint32)i;
+  });
+
+  std::vector<Uint32> &counts = base.counts;
+  parallel_for(stripes, 1, [&](size_t begin, size_t end) {
+    for (size_t s = begin; s < end; ++s) {
+      for (size_t k = stripe_begin[s]; k < stripe_begin[s + 1]; ++k) {
+        Uint32 i = bucket[k];
+        size_t cell = (size_t)cell_y(i) * base.w + cell_x(i);
+        Uint32 rgba = nodes.color[i];
+        counts[cell]++;
+        sums[cell * 3] += rgba_r(rgba);
+        sums[cell * 3 + 1] += rgba_g(rgba);
+        sums[cell * 3 + 2] += rgba_b(rgba);
+      }
+    }
+  });
+  std::vector<Uint32>().swap(bucket);
+  finish();
+}
+
+void DensityPyramid::start(const Rect &node_bounds) {
+  levels.clear();
+  bounds = node_bounds;
+  float span_w = bounds.x2 - bounds.x1, span_h = bounds.y2 - bounds.y1;
+  float span = span_w > span_h ? span_w : span_h;
+  Level base;
+  base.cell = span > 0.0f ? span / (float)MAX_SIDE : 1.0f;
+  base.w = SDL_min((int)(span_w / base.cell) + 1, MAX_SIDE);
+  base.h = SDL_min((int)(span_h / base.cell) + 1, MAX_SIDE);
+  base.counts.assign((size_t)base.w * base.h, 0);
+  sums.assign(base.counts.size() * 3, 0);
+  levels.push_back(std::move(base));
+}
+
+void DensityPyramid::accumulate(float x, float y, Uint32 rgba) {
+  Level &base = levels[0];
+  int cx = SDL_clamp((int)((x - bounds.x1) / base.cell), 0, base.w - 1);
+  int cy = SDL_clamp((int)((y - bounds.y1) / base.cell), 0, base.h - 1);
+  size_t cell = (size_t)cy * base.w + cx;
+  base.counts[cell]++;
+  sums[cell * 3] += rgba_r(rgba);
+  sums[cell * 3 + 1] += rgba_g(rgba);
+  sums[cell * 3 + 2] += rgba_b(rgba);
+}
+
+void DensityPyramid::finish() {
+  Level &base = levels[0];
+  const std::vector<Uint32> &counts = base.counts;
+  for (Uint32 c : counts)
+    base.max_count = c > base.max_count ? c : base.max_count;
+  float norm = shade_norm(base.max_count);
+  base.cells.resize(counts.size());
+  parallel_for(counts.size(), 65536, [&](size_t begin, size_t end) {
+    for (size_t c = begin; c < end; ++c)
+      base.cells[c] = cell_value(counts[c], sums[c * 3], sums[c * 3 + 1],
+                                 sums[c * 3 + 2], norm);
+  });
+  std::vector<Uint64>().swap(sums);
+
+  // Each coarser level sums 2x2 cells of the one below; colors are
+  // weighted by the child counts.
+  while (levels.back().w > 1 || levels.back().h > 1) {
+    const Level &below = levels.back();
+    Level level;
+    level.w = (below.w + 1) / 2;
+    level.h = (below.h + 1) / 2;
+    level.cell = below.cell * 2.0f;
+    std::vector<Uint32> level_counts((size_t)level.w * level.h);
+    std::vector<Uint64> level_sums(level_counts.size() * 3);
+    parallel_for(level.h, 16, [&](size_t begin, size_t end) {
+      for (size_t y = begin; y < end; ++y) {
+        for (int x = 0; x < level.w; ++x) {
+          size_t cell = y * level.w + x;
+          Uint32 count = 0;
+          Uint64 r = 0, g = 0, b = 0;
+          for (int dy = 0; dy < 2; ++dy) {
+            for (int dx = 0; dx < 2; ++dx) {
+              int cx = 2 * x + dx, cy = 2 * (int)y + dy;
+              if (cx >= below.w || cy >= below.h)
+                continue;
+              size_t child = (size_t)cy * below.w + cx;
+              Uint32 c = below.counts[child];
+              Uint32 rgba = below.cells[child];
+              count += c;
+              r += (Uint64)rgba_r(rgba) * c;
+              g += (Uint64)rgba_g(rgba) * c;
+              b += (Uint64)rgba_b(rgba) * c;
+            }
+          }
+          level_counts[cell] = count;
+          level_sums[cell * 3] = r;
+          level_sums[cell * 3 + 1] = g;
+          level_sums[cell * 3 + 2] = b;
+        }
+      }
+    });
+    for (Uint32 c : level_counts)
+      level.max_count = c > level.max_count ? c : level.max_count;
+    norm = shade_norm(level.max_count);
+    level.cells.resize(level_counts.size());
+    parallel_for(level.cells.size(), 65536, [&](size_t begin, size_t end) {
+      for (size_t c = begin; c < end; ++c)
+        level.cells[c] = cell_value(level_counts[c], level_sums[c * 3],
+                                    level_sums[c * 3 + 1],
+                                    level_sums[c * 3 + 2], norm);
+    });
+    level.counts.swap(level_counts);
+    levels.push_back(std::move(level));
+  }
+
+  log("Density pyramid: %zu levels, base %dx%d, %zu KiB\n", levels.size(),
+      levels[0].w, levels[0].h, memory_bytes() / 1024);
+}
+
+void DensityPyramid::add(float x, float y, Uint32 rgba, int weight) {
+  if (levels.empty() || levels[0].counts.empty())
+    return;
+  const Level &base = levels[0];
+  int cx = SDL_clamp((int)((x - bounds.x1) / base.cell), 0, base.w - 1);
+  int cy = SDL_clamp((int)((y - bounds.y1) / base.cell), 0, base.h - 1);
+  for (Level &level : levels) {
+    size_t cell = (size_t)cy * level.w + cx;
+    Sint64 count = level.counts[cell];
+    Sint64 next = SDL_max(count + weight, (Sint64)0);
+    Uint32 old = level.cells[cell];
+    Sint64 channel[3] = {rgba_r(old) * count, rgba_g(old) * count,
+                         rgba_b(old) * count};
+    channel[0] = SDL_max(channel[0] + weight * (Sint64)rgba_r(rgba), 0);
+    channel[1] = SDL_max(channel[1] + weight * (Sint64)rgba_g(rgba), 0);
+    channel[2] = SDL_max(channel[2] + weight * (Sint64)rgba_b(rgba), 0);
+    level.counts[cell] = (Uint32)next;
+    level.cells[cell] =
+        cell_value((Uint32)next, (Uint64)channel[0], (Uint64)channel[1],
+                   (Uint64)channel[2], shade_norm(level.max_count));
+    cx /= 2;
+    cy /= 2;
+  }
+}
+
+size_t DensityPyramid::memory_bytes() const {
+  size_t bytes = 0;
+  for (const Level &level : levels)
+    bytes += (level.cells.capacity() + level.counts.capacity()) *
+             sizeof(Uint32);
+  return bytes;
+}
+
+bool DensityPyramid::render(SDL_Surface *surface, const NodeStore &nodes,
+                            float pan_x, float pan_y, float zoom,
+                            const SDL_Rect &clip) const {
+  if (levels.empty() || levels[0].cell * zoom > MAX_CELL_PIXELS)
+    return false;
+  const SDL_PixelFormatDetails *format =
+      SDL_GetPixelFormatDetails(surface->format);
+  if (format->bytes_per_pixel != 4 || format->Rbits != 8 ||
+      format->Gbits != 8 || format->Bbits != 8)
+    return false;
+
+  size_t l = 0;
+  while (l + 1 < levels.size() && levels[l].cell * zoom < 1.0f)
+    ++l;
+  const Level &level = levels[l];
+
+  // Cells are sampled at pixel centers; the column lookup is shared by
+  // every row.
+  std::vector<int> columns(clip.w);
+  for (int k = 0; k < clip.w; ++k) {
+    float wx = (clip.x + k + 0.5f) / zoom - pan_x;
+    float gx = SDL_floorf((wx - bounds.x1) / level.cell);
+    columns[k] = gx >= 0.0f && gx < (float)level.w ? (int)gx : -1;
+  }
+  for (int sy = clip.y; sy < clip.y + clip.h; ++sy) {
+    float wy = (sy + 0.5f) / zoom - pan_y;
+    float gy = SDL_floorf((wy - bounds.y1) / level.cell);
+    if (!(gy >= 0.0f && gy < (float)level.h))
+      continue;
+    const Uint32 *src = level.cells.data() + (size_t)gy * level.w;
+    Uint32 *row = (Uint32 *)((Uint8 *)surface->pixels + sy * surface->pitch);
+    for (int k = 0; k < clip.w; ++k) {
+      if (columns[k] < 0)
+        continue;
+      Uint32 value = src[columns[k]];
+      Uint32 shade = rgba_a(value);
+      if (!shade)
+        continue;
+      Uint32 pixel = ((Uint32)rgba_r(value) << format->Rshift) |
+                     ((Uint32)rgba_g(value) << format->Gshift) |
+                     ((Uint32)rgba_b(value) << format->Bshift) |
+                     format->Amask;
+      row[clip.x + k] = blend_pixel(row[clip.x + k], pixel, shade);
+    }
+  }
+
+  // Selected nodes stay visible as single pixels, as in the point path.
+  Uint32 selected = SDL_MapRGB(format, NULL, 255, 255, 0);
+  for (int i : nodes.selection.active) {
+    float fx = (nodes.x[i] + pan_x) * zoom;
+    float fy = (nodes.y[i] + pan_y) * zoom;
+    if (!(fx >= clip.x && fx < clip.x + clip.w && fy >= clip.y &&
+          fy < clip.y + clip.h))
+      continue;
+    Uint32 *row =
+        (Uint32 *)((Uint8 *)surface->pixels + (int)fy * surface->pitch);
+    row[(int)fx] = selected;
+  }
+  return true;
+}
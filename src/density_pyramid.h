@@ -0,0 +1,57 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <vector>
+
+#include "node.h"
+
+// Mip pyramid of node counts and average colors over the node centers,
+// used instead of plotting every node once too many are on screen.
+//
+// levels[0] spans the node bounds with MAX_SIDE cells along the longer
+// axis; each level above halves the resolution until one cell is left.
+// Every cell stores its nodes' average color with a log-scaled density
+// shade in the alpha byte, so drawing a level costs one lookup per screen
+// pixel however many nodes it summarises.
+struct DensityPyramid {
+  static constexpr int MAX_SIDE = 2048;
+  // Beyond this many pixels per base cell the pyramid is too coarse and
+  // render() declines.
+  static constexpr float MAX_CELL_PIXELS = 2.0f;
+
+  struct Level {
+    int w = 0, h = 0;
+    float cell = 0.0f; // world units per cell
+    Uint32 max_count = 0;
+    std::vector<Uint32> cells; // pack_rgba(), alpha = shade, 0 = empty
+    std::vector<Uint32> counts; // nodes per cell, empty if loaded from disk
+  };
+
+  Rect bounds = {0, 0, 0, 0};
+  std::vector<Level> levels;
+  std::vector<Uint64> sums; // r, g, b per base cell until finish()
+
+  // Builds every level on all cores. Must be called again whenever node
+  // positions or colors change or nodes are hidden or shown, or be kept up
+  // to date with add().
+  void build(const NodeStore &nodes);
+  // The same for nodes that are not all in memory at once: start() with
+  // the bounds of their centers, accumulate() every node, then finish().
+  void start(const Rect &node_bounds);
+  void accumulate(float x, float y, Uint32 rgba);
+  void finish();
+  // Counts a node at (x, y) with color rgba in (weight 1) or out (weight -1)
+  // of every level, for live updates between builds. Averages are updated
+  // from the stored 8-bit colors and shades from the maxima of the last
+  // build, so both drift a little until the next one; nodes outside the
+  // bounds count towards the edge cells.
+  void add(float x, float y, Uint32 rgba, int weight);
+  size_t memory_bytes() const;
+
+  // Composites the finest level whose cells cover at least a pixel over
+  // the surface, then plots selected nodes on top. Only pixels inside clip
+  // are written. Returns false, drawing nothing, when even the base level
+  // is coarser than MAX_CELL_PIXELS or the surface is not 8-bit RGB.
+  bool render(SDL_Surface *surface, const NodeStore &nodes, float pan_x,
+              float pan_y, float zoom, const SDL_Rect &clip) const;
+};
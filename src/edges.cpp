@@ -0,0 +1,471 @@
+#include "edges.h"
+
+#include <math.h>
+#include <utility>
+
+#include "parallel.h"
+
+#include "debug.h"
+
+void EdgeCSR::bind(const GraphColumns &columns) {
+  node_count = (int)columns.node_count;
+  edge_count = columns.edge_count;
+  offsets = columns.edge_offsets;
+  targets = columns.edge_targets;
+  owned_offsets.clear();
+  owned_targets.clear();
+  if (!offsets) {
+    owned_offsets.assign((size_t)node_count + 1, 0);
+    offsets = owned_offsets.data();
+    edge_count = 0;
+  }
+}
+
+void EdgeCSR::assign(int nodes, const Uint32 *sources, const Uint32 *dests,
+                     Uint64 count) {
+  node_count = nodes;
+  edge_count = count;
+  owned_offsets.assign((size_t)nodes + 1, 0);
+  owned_targets.resize(count);
+  for (Uint64 e = 0; e < count; ++e)
+    owned_offsets[sources[e] + 1]++;
+  for (int i = 0; i < nodes; ++i)
+    owned_offsets[i + 1] += owned_offsets[i];
+  std::vector<Uint64> cursor(owned_offsets.begin(), owned_offsets.end() - 1);
+  for (Uint64 e = 0; e < count; ++e)
+    owned_targets[cursor[sources[e]]++] = dests[e];
+  offsets = owned_offsets.data();
+  targets = owned_targets.data();
+}
+
+void EdgeIndex::build(const EdgeCSR &csr, const NodeStore &nodes) {
+  refs.clear();
+  cell_offsets.assign(level_base(MAX_LEVEL + 1) + 1, 0);
+  if (csr.edge_count == 0 || nodes.empty())
+    return;
+
+  const float *xs = nodes.x.data();
+  const float *ys = nodes.y.data();
+  bounds = {xs[0], ys[0], xs[0], ys[0]};
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    bounds.x1 = xs[i] < bounds.x1 ? xs[i] : bounds.x1;
+    bounds.y1 = ys[i] < bounds.y1 ? ys[i] : bounds.y1;
+    bounds.x2 = xs[i] > bounds.x2 ? xs[i] : bounds.x2;
+    bounds.y2 = ys[i] > bounds.y2 ? ys[i] : bounds.y2;
+  }
+  extent = bounds.x2 - bounds.x1;
+  if (bounds.y2 - bounds.y1 > extent)
+    extent = bounds.y2 - bounds.y1;
+  if (extent < 1.0f)
+    extent = 1.0f;
+
+  // Counting sort by cell: one pass to key and count, one to scatter.
+  std::vector<Uint32> keys(csr.edge_count);
+  for (int s = 0; s < csr.node_count; ++s) {
+    float ax = xs[s], ay = ys[s];
+    for (Uint64 e = csr.offsets[s]; e < csr.offsets[s + 1]; ++e) {
+      float bx = xs[csr.targets[e]], by = ys[csr.targets[e]];
+      float min_x = ax < bx ? ax : bx;
+      float min_y = ay < by ? ay : by;
+      float size = SDL_fabsf(ax - bx);
+      if (SDL_fabsf(ay - by) > size)
+        size = SDL_fabsf(ay - by);
+
+      int level = MAX_LEVEL;
+      if (size > 0.0f) {
+        level = (int)SDL_floorf(log2f(extent / size));
+        level = level > MAX_LEVEL ? MAX_LEVEL : level;
+        level = level < 0 ? 0 : level;
+        while (level > 0 && extent / (float)(1 << level) < size)
+          level--;
+      }
+      int side = 1 << level;
+      float cell = extent / (float)side;
+      int cx = (int)((min_x - bounds.x1) / cell);
+      int cy = (int)((min_y - bounds.y1) / cell);
+      cx = cx >= side ? side - 1 : cx;
+      cy = cy >= side ? side - 1 : cy;
+      Uint32 key = level_base(level) + (Uint32)(cy * side + cx);
+      keys[e] = key;
+      cell_offsets[key + 1]++;
+    }
+  }
+  for (size_t c = 1; c < cell_offsets.size(); ++c)
+    cell_offsets[c] += cell_offsets[c - 1];
+
+  refs.resize(csr.edge_count);
+  std::vector<Uint32> cursor(cell_offsets.begin(), cell_offsets.end() - 1);
+  for (int s = 0; s < csr.node_count; ++s) {
+    for (Uint64 e = csr.offsets[s]; e < csr.offsets[s + 1]; ++e)
+      refs[cursor[keys[e]]++] = {(Uint32)s, csr.targets[e]};
+  }
+  log("Edge index: %llu edges over %d levels\n",
+      (unsigned long long)csr.edge_count, MAX_LEVEL + 1);
+}
+
+// Liang-Barsky clip of a segment to [x_min, x_max] x [y_min, y_max].
+static bool clip_segment(float &x0, float &y0, float &x1, float &y1,
+                         float x_min, float y_min, float x_max, float y_max) {
+  float t0 = 0.0f, t1 = 1.0f;
+  float dx = x1 - x0, dy = y1 - y0;
+  float p[4] = {-dx, dx, -dy, dy};
+  float q[4] = {x0 - x_min, x_max - x0, y0 - y_min, y_max - y0};
+  for (int i = 0; i < 4; ++i) {
+    if (p[i] == 0.0f) {
+      if (q[i] < 0.0f)
+        return false;
+      continue;
+    }
+    float t = q[i] / p[i];
+    if (p[i] < 0.0f) {
+      if (t > t1)
+        return false;
+      if (t > t0)
+        t0 = t;
+    } else {
+      if (t < t0)
+        return false;
+      if (t < t1)
+        t1 = t;
+    }
+  }
+  float cx0 = x0 + t0 * dx, cy0 = y0 + t0 * dy;
+  x1 = x0 + t1 * dx;
+  y1 = y0 + t1 * dy;
+  x0 = cx0;
+  y0 = cy0;
+  return true;
+}
+
+// Integer Bresenham between two already clipped endpoints.
+template <typename Plot>
+static void raster_line(int x0, int y0, int x1, int y1, Plot plot) {
+  int dx = x1 > x0 ? x1 - x0 : x0 - x1;
+  int dy = y1 > y0 ? y0 - y1 : y1 - y0;
+  int sx = x0 < x1 ? 1 : -1;
+  int sy = y0 < y1 ? 1 : -1;
+  int err = dx + dy;
+  for (;;) {
+    plot(x0, y0);
+    if (x0 == x1 && y0 == y1)
+      break;
+    int e2 = 2 * err;
+    if (e2 >= dy) {
+      err += dy;
+      x0 += sx;
+    }
+    if (e2 <= dx) {
+      err += dx;
+      y0 += sy;
+    }
+  }
+}
+
+// Plots the pixels of the line between two integer endpoints that fall in
+// the inclusive box [x_lo, x_hi] x [y_lo, y_hi], stepping only over the
+// part of the major axis inside the box. Every pixel follows from the
+// endpoints alone, so moving both by whole pixels moves the line with them
+// however the box cuts it.
+template <typename Plot>
+static void raster_line_in(int x0, int y0, int x1, int y1, int x_lo, int y_lo,
+                           int x_hi, int y_hi, Plot plot) {
+  bool steep = SDL_abs(y1 - y0) > SDL_abs(x1 - x0);
+  if (steep) {
+    std::swap(x0, y0);
+    std::swap(x1, y1);
+    std::swap(x_lo, y_lo);
+    std::swap(x_hi, y_hi);
+  }
+  if (x0 > x1) {
+    std::swap(x0, x1);
+    std::swap(y0, y1);
+  }
+  int from = SDL_max(x0, x_lo), to = SDL_min(x1, x_hi);
+  if (from > to)
+    return;
+  // y = y0 + round((x - x0) * dy / dx), tracked as quotient and remainder
+  // of 2 * (x - x0) * dy + dx over 2 * dx.
+  long long dx2 = 2 * (long long)(x1 - x0), dy2 = 2 * (long long)(y1 - y0);
+  long long q = 0, r = 0;
+  if (dx2) {
+    long long num = (long long)(from - x0) * dy2 + dx2 / 2;
+    q = num >= 0 ? num / dx2 : -((-num + dx2 - 1) / dx2);
+    r = num - q * dx2;
+  }
+  for (int x = from; x <= to; ++x) {
+    int y = y0 + (int)q;
+    if (y >= y_lo && y <= y_hi) {
+      if (steep)
+        plot(y, x);
+      else
+        plot(x, y);
+    }
+    r += dy2;
+    if (r >= dx2 && dx2) {
+      r -= dx2;
+      q++;
+    } else if (r < 0) {
+      r += dx2;
+      q--;
+    }
+  }
+}
+
+void draw_line(SDL_Surface *surface, float x0, float y0, float x1, float y1,
+               Uint32 color, const SDL_Rect *clip) {
+  // Only lines reaching further than GUARD pixels off the surface get their
+  // endpoints moved, which keeps the rounded coordinates in range.
+  const float GUARD = 1 << 20;
+  if (!clip_segment(x0, y0, x1, y1, -GUARD, -GUARD, surface->w + GUARD,
+                    surface->h + GUARD))
+    return;
+  int ix0 = (int)SDL_floorf(x0 + 0.5f), iy0 = (int)SDL_floorf(y0 + 0.5f);
+  int ix1 = (int)SDL_floorf(x1 + 0.5f), iy1 = (int)SDL_floorf(y1 + 0.5f);
+  int cx1 = 0, cy1 = 0, cx2 = surface->w - 1, cy2 = surface->h - 1;
+  if (clip) {
+    cx1 = SDL_max(cx1, clip->x);
+    cy1 = SDL_max(cy1, clip->y);
+    cx2 = SDL_min(cx2, clip->x + clip->w - 1);
+    cy2 = SDL_min(cy2, clip->y + clip->h - 1);
+  }
+  Uint8 *pixels = (Uint8 *)surface->pixels;
+  int pitch = surface->pitch;
+  raster_line_in(ix0, iy0, ix1, iy1, cx1, cy1, cx2, cy2, [&](int x, int y) {
+    ((Uint32 *)(pixels + y * pitch))[x] = color;
+  });
+}
+
+void EdgeDensity::build(const EdgeIndex &index, const NodeStore &nodes,
+                        float zoom_band) {
+  float span_w = index.bounds.x2 - index.bounds.x1;
+  float span_h = index.bounds.y2 - index.bounds.y1;
+  float span = span_w > span_h ? span_w : span_h;
+  float target_cell = 1.0f / zoom_band;
+  if (span / target_cell > (float)(MAX_SIDE - 1))
+    target_cell = span / (float)(MAX_SIDE - 1);
+
+  // Past MAX_SIDE every band maps to the same grid.
+  bool same_grid = !level.empty() && band != 0.0f && cell == target_cell;
+  band = zoom_band;
+  if (same_grid)
+    return;
+  bounds = index.bounds;
+  cell = target_cell;
+  w = (int)(span_w / cell) + 1;
+  h = (int)(span_h / cell) + 1;
+
+  std::vector<Uint32> counts((size_t)w * h, 0);
+  const EdgeRef *refs = index.refs.data();
+  size_t ref_count = index.refs.size();
+  bool any_hidden = !nodes.hidden.empty();
+
+  // Threads own disjoint row stripes and each walks every edge, so the
+  // counts need no synchronisation.
+  parallel_for((size_t)h, 1, [&](size_t first, size_t last) {
+    int row0 = (int)first, row1 = (int)last;
+    float x_max = (float)w - 0.5f;
+    float y_min = (float)row0 - 0.5f;
+    float y_max = (float)row1 - 0.5f;
+    for (size_t r = 0; r < ref_count; ++r) {
+      Uint32 a = refs[r].source, b = refs[r].target;
+      if (any_hidden &&
+          (nodes.hidden.contains(a) || nodes.hidden.contains(b)))
+        continue;
+      float x0 = (nodes.x[a] - bounds.x1) / cell;
+      float y0 = (nodes.y[a] - bounds.y1) / cell;
+      float x1 = (nodes.x[b] - bounds.x1) / cell;
+      float y1 = (nodes.y[b] - bounds.y1) / cell;
+      if (!clip_segment(x0, y0, x1, y1, -0.5f, y_min, x_max, y_max))
+        continue;
+      int ix0 = (int)SDL_floorf(x0 + 0.5f), iy0 = (int)SDL_floorf(y0 + 0.5f);
+      int ix1 = (int)SDL_floorf(x1 + 0.5f), iy1 = (int)SDL_floorf(y1 + 0.5f);
+      raster_line(ix0, iy0, ix1, iy1, [&](int x, int y) {
+        if (x >= 0 && x < w && y >= row0 && y < row1)
+          counts[(size_t)y * w + x]++;
+      });
+    }
+  });
+
+  Uint32 max_count = 0;
+  for (Uint32 c : counts)
+    max_count = c > max_count ? c : max_count;
+  level.assign(counts.size(), 0);
+  if (max_count == 0)
+    return;
+  float norm = 254.0f / logf(1.0f + (float)max_count);
+  for (size_t i = 0; i < counts.size(); ++i) {
+    if (counts[i])
+      level[i] = (Uint8)(1.0f + logf(1.0f + (float)counts[i]) * norm);
+  }
+  log("Edge density: %dx%d grid at zoom band %.3f (max %u)\n", w, h, band,
+      max_count);
+}
+
+static Uint64 edge_key(Uint32 source, Uint32 target) {
+  return ((Uint64)source << 32) | target;
+}
+
+void EdgeLayer::rebuild(const NodeStore &nodes) {
+  if (!added.empty() || !cut.empty()) {
+    std::vector<Uint32> sources, targets;
+    sources.reserve(csr.edge_count + added.size());
+    targets.reserve(csr.edge_count + added.size());
+    for (int s = 0; s < csr.node_count; ++s) {
+      for (Uint64 e = csr.offsets[s]; e < csr.offsets[s + 1]; ++e) {
+        if (!cut.empty() && cut.count(edge_key(s, csr.targets[e])))
+          continue;
+        sources.push_back(s);
+        targets.push_back(csr.targets[e]);
+      }
+    }
+    for (size_t p = 0; p < added.size(); ++p) {
+      auto it = cut.find(edge_key(added[p].source, added[p].target));
+      if (it != cut.end() && p < it->second)
+        continue;
+      sources.push_back(added[p].source);
+      targets.push_back(added[p].target);
+    }
+    int count = SDL_max(csr.node_count, (int)nodes.size());
+    csr.assign(count, sources.data(), targets.data(), sources.size());
+    version++;
+    log("Folded %zu added and %zu removed edges\n", added.size(),
+        cut.size());
+  }
+  added.clear();
+  moved.clear();
+  cut.clear();
+  touched.clear();
+  in_offsets.clear();
+  in_sources.clear();
+  index.build(csr, nodes);
+  density.band = 0.0f;
+  density.level.clear();
+}
+
+void EdgeLayer::build_reverse() {
+  if (!in_offsets.empty())
+    return;
+  in_offsets.assign((size_t)csr.node_count + 1, 0);
+  for (Uint64 e = 0; e < csr.edge_count; ++e)
+    in_offsets[csr.targets[e] + 1]++;
+  for (int v = 0; v < csr.node_count; ++v)
+    in_offsets[v + 1] += in_offsets[v];
+  in_sources.resize(csr.edge_count);
+  std::vector<Uint64> cursor(in_offsets.begin(), in_offsets.end() - 1);
+  for (int s = 0; s < csr.node_count; ++s)
+    for (Uint64 e = csr.offsets[s]; e < csr.offsets[s + 1]; ++e)
+      in_sources[cursor[csr.targets[e]]++] = s;
+}
+
+void EdgeLayer::node_moved(int i) {
+  // Edges of nodes added since the last rebuild are all in added.
+  if (i >= csr.node_count)
+    return;
+  if (touched.bits.size() * 64 <= (size_t)i)
+    touched.grow((size_t)csr.node_count);
+  if (touched.contains(i))
+    return;
+  touched.add(i);
+  build_reverse();
+  for (Uint64 e = csr.offsets[i]; e < csr.offsets[i + 1]; ++e)
+    moved.push_back({(Uint32)i, csr.targets[e]});
+  for (Uint64 e = in_offsets[i]; e < in_offsets[i + 1]; ++e)
+    moved.push_back({in_sources[e], (Uint32)i});
+}
+
+void EdgeLayer::render(SDL_Surface *surface, const NodeStore &nodes,
+                       float pan_x, float pan_y, float zoom,
+                       const SDL_Rect &clip) {
+  if (index.refs.empty() && added.empty())
+    return;
+
+  const SDL_PixelFormatDetails *format =
+      SDL_GetPixelFormatDetails(surface->format);
+  if (clip.x == 0 && clip.y == 0 && clip.w == surface->w &&
+      clip.h == surface->h) {
+    Rect view = {-pan_x, -pan_y, -pan_x + surface->w / zoom,
+                 -pan_y + surface->h / zoom};
+    Uint64 candidates = added.size() + moved.size();
+    index.visit(view, [&](const EdgeRef *begin, const EdgeRef *end) {
+      candidates += (Uint64)(end - begin);
+    });
+    detailed = candidates <= DETAIL_LIMIT;
+  }
+
+  if (detailed) {
+    Uint32 color = SDL_MapRGB(format, NULL, 90, 90, 110);
+    bool any_hidden = !nodes.hidden.empty();
+    // Lines round their endpoints, so widen the clip by a pixel in world
+    // space when picking edges.
+    Rect region = {(clip.x - 1) / zoom - pan_x, (clip.y - 1) / zoom - pan_y,
+                   (clip.x + clip.w + 1) / zoom - pan_x,
+                   (clip.y + clip.h + 1) / zoom - pan_y};
+    bool any_cut = !cut.empty();
+    auto draw_edge = [&](const EdgeRef &r) {
+      draw_line(surface, (nodes.x[r.source] + pan_x) * zoom,
+                (nodes.y[r.source] + pan_y) * zoom,
+                (nodes.x[r.target] + pan_x) * zoom,
+                (nodes.y[r.target] + pan_y) * zoom, color, &clip);
+    };
+    auto skipped = [&](const EdgeRef &r) {
+      return (any_hidden && (nodes.hidden.contains(r.source) ||
+                             nodes.hidden.contains(r.target))) ||
+             (any_cut && cut.count(edge_key(r.source, r.target)));
+    };
+    index.visit(region, [&](const EdgeRef *begin, const EdgeRef *end) {
+      for (const EdgeRef *r = begin; r != end; ++r)
+        if (!skipped(*r))
+          draw_edge(*r);
+    });
+    auto in_region = [&](const EdgeRef &r) {
+      Rect box = {SDL_min(nodes.x[r.source], nodes.x[r.target]),
+                  SDL_min(nodes.y[r.source], nodes.y[r.target]),
+                  SDL_max(nodes.x[r.source], nodes.x[r.target]),
+                  SDL_max(nodes.y[r.source], nodes.y[r.target])};
+      return box.intersects(region);
+    };
+    for (const EdgeRef &r : moved)
+      if (in_region(r) && !skipped(r))
+        draw_edge(r);
+    for (size_t p = 0; p < added.size(); ++p) {
+      const EdgeRef &r = added[p];
+      if (!in_region(r) ||
+          (any_hidden && (nodes.hidden.contains(r.source) ||
+                          nodes.hidden.contains(r.target))))
+        continue;
+      auto it = any_cut ? cut.find(edge_key(r.source, r.target)) : cut.end();
+      if (it == cut.end() || p >= it->second)
+        draw_edge(r);
+    }
+    return;
+  }
+
+  float band = powf(2.0f, SDL_floorf(log2f(zoom)));
+  if (density.band != band)
+    density.build(index, nodes, band);
+
+  Uint32 palette[256];
+  for (int i = 0; i < 256; ++i)
+    palette[i] = SDL_MapRGB(format, NULL, (Uint8)(i * 3 / 5),
+                            (Uint8)(i * 3 / 5), (Uint8)i);
+
+  // Nearest-neighbour resample of the grid; one lookup per screen pixel.
+  float step = 1.0f / (zoom * density.cell);
+  float gx0 = (-pan_x - density.bounds.x1) / density.cell;
+  for (int sy = clip.y; sy < clip.y + clip.h; ++sy) {
+    float wy = sy / zoom - pan_y;
+    int gy = (int)SDL_floorf((wy - density.bounds.y1) / density.cell + 0.5f);
+    if (gy < 0 || gy >= density.h)
+      continue;
+    const Uint8 *src = density.level.data() + (size_t)gy * density.w;
+    Uint32 *row = (Uint32 *)((Uint8 *)surface->pixels + sy * surface->pitch);
+    for (int sx = clip.x; sx < clip.x + clip.w; ++sx) {
+      int gx = (int)SDL_floorf(gx0 + sx * step + 0.5f);
+      if (gx < 0 || gx >= density.w)
+        continue;
+      Uint8 l = src[gx];
+      if (l)
+        row[sx] = palette[l];
+    }
+  }
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <unordered_map>
+#include <vector>
+
+#include "graph_file.h"
+#include "node.h"
+
+// Compressed sparse row adjacency. Outgoing edges of node i are
+// targets[offsets[i] .. offsets[i + 1]). The arrays either point into a
+// mapped GraphFile or at the owned_* vectors.
+struct EdgeCSR {
+  int node_count = 0;
+  Uint64 edge_count = 0;
+  const Uint64 *offsets = nullptr;
+  const Uint32 *targets = nullptr;
+
+  std::vector<Uint64> owned_offsets;
+  std::vector<Uint32> owned_targets;
+
+  // Zero-copy view of the file's edge block (empty if it has none).
+  void bind(const GraphColumns &columns);
+  // Builds the CSR arrays from an unsorted (source, target) list.
+  void assign(int nodes, const Uint32 *sources, const Uint32 *dests,
+              Uint64 count);
+};
+
+struct EdgeRef {
+  Uint32 source, target;
+};
+
+// Loose multi-level grid over edge bounding boxes. Each edge lives in the
+// deepest level whose cell is at least as large as its bounding box, keyed
+// by the cell holding the box's top-left corner, so a query only has to
+// widen its range by one cell per level. Edges are stored sorted by cell and
+// a row of cells maps to one contiguous run of refs.
+struct EdgeIndex {
+  static constexpr int MAX_LEVEL = 10;
+
+  Rect bounds = {0, 0, 0, 0};
+  float extent = 0.0f; // side of the square covered by level 0
+  std::vector<Uint32> cell_offsets;
+  std::vector<EdgeRef> refs;
+
+  void build(const EdgeCSR &csr, const NodeStore &nodes);
+
+  // Calls fn(begin, end) for every run of refs whose bounding boxes may
+  // intersect range.
+  template <typename Fn> void visit(const Rect &range, Fn fn) const {
+    if (refs.empty())
+      return;
+    for (int level = 0; level <= MAX_LEVEL; ++level) {
+      int side = 1 << level;
+      float cell = extent / (float)side;
+      int cx0 = (int)SDL_floorf((range.x1 - bounds.x1) / cell) - 1;
+      int cy0 = (int)SDL_floorf((range.y1 - bounds.y1) / cell) - 1;
+      int cx1 = (int)SDL_floorf((range.x2 - bounds.x1) / cell);
+      int cy1 = (int)SDL_floorf((range.y2 - bounds.y1) / cell);
+      if (cx1 < 0 || cy1 < 0 || cx0 >= side || cy0 >= side)
+        continue;
+      cx0 = cx0 < 0 ? 0 : cx0;
+      cy0 = cy0 < 0 ? 0 : cy0;
+      cx1 = cx1 >= side ? side - 1 : cx1;
+      cy1 = cy1 >= side ? side - 1 : cy1;
+      Uint32 base = level_base(level);
+      for (int cy = cy0; cy <= cy1; ++cy) {
+        Uint32 first = cell_offsets[base + cy * side + cx0];
+        Uint32 last = cell_offsets[base + cy * side + cx1 + 1];
+        if (first != last)
+          fn(refs.data() + first, refs.data() + last);
+      }
+    }
+  }
+
+  static Uint32 level_base(int level) {
+    return (Uint32)(((1ull << (2 * level)) - 1) / 3);
+  }
+};
+
+// Screen-resolution edge coverage counts in world space, rebuilt only when
+// the zoom leaves the power-of-two band it was built for. Panning just
+// resamples it.
+struct EdgeDensity {
+  static constexpr int MAX_SIDE = 2048;
+
+  int w = 0, h = 0;
+  float cell = 0.0f; // world units per density cell
+  float band = 0.0f; // zoom band this grid was built for, 0 if stale
+  Rect bounds = {0, 0, 0, 0};
+  std::vector<Uint8> level; // log-scaled coverage, 0 = empty
+
+  void build(const EdgeIndex &index, const NodeStore &nodes, float zoom_band);
+};
+
+struct EdgeLayer {
+  // Above this many candidate edges the layer draws the density grid
+  // instead of individual lines.
+  static constexpr Uint64 DETAIL_LIMIT = 200000;
+
+  // Pending live edits past which rebuild() should fold them in: a floor
+  // plus a share of the edges, so folding costs O(1) per edit on average.
+  static constexpr size_t EDIT_FLOOR = 65536;
+  static constexpr Uint64 EDIT_SHARE = 16;
+
+  EdgeCSR csr;
+  EdgeIndex index;
+  EdgeDensity density;
+  bool detailed = true; // lines or density, picked on full repaints
+  Uint64 version = 0;   // bumped whenever rebuild() changes csr
+
+  // Live edits since the last rebuild(). Added edges and the CSR edges of
+  // moved nodes are drawn from these lists, each culled on its own, on top
+  // of what the index finds; the index still files moved edges under their
+  // old boxes, which at worst draws the same pixels twice. A cut key hides
+  // its CSR edges and the added ones before position cut[key] in added,
+  // so an edge can be added back after a removal. The density grid sees
+  // none of this until the next rebuild().
+  std::vector<EdgeRef> added, moved;
+  std::unordered_map<Uint64, size_t> cut; // source << 32 | target
+  Selection touched;                      // nodes with edges in moved
+  std::vector<Uint64> in_offsets;         // reverse CSR, see build_reverse()
+  std::vector<Uint32> in_sources;
+
+  // Must be called again whenever node positions change. Folds pending
+  // edits into the CSR first.
+  void rebuild(const NodeStore &nodes);
+  void add_edge(Uint32 source, Uint32 target) {
+    added.push_back({source, target});
+  }
+  // Removes every copy of the edge.
+  void remove_edge(Uint32 source, Uint32 target) {
+    cut[((Uint64)source << 32) | target] = added.size();
+  }
+  // Node i moved since the last rebuild().
+  void node_moved(int i);
+  // Fills in_offsets and in_sources with the incoming CSR edges of every
+  // node, unless they are already; rebuild() drops them.
+  void build_reverse();
+  size_t pending_edits() const {
+    return added.size() + moved.size() + cut.size();
+  }
+  bool edits_due() const {
+    return pending_edits() > EDIT_FLOOR + csr.edge_count / EDIT_SHARE;
+  }
+  // Edges of hidden nodes are skipped; the density grid is recounted
+  // after nodes are hidden or shown.
+  void hidden_changed() {
+    density.band = 0.0f;
+    density.level.clear();
+  }
+  // Only pixels inside clip are written. The drawing mode is picked from
+  // the whole view when clip covers the surface and kept for partial
+  // repaints, so those match the pixels around them even after a scroll.
+  void render(SDL_Surface *surface, const NodeStore &nodes, float pan_x,
+              float pan_y, float zoom, const SDL_Rect &clip);
+};
+
+// Draws a 1px line, clipped to the surface and, if given, to clip. The
+// pixels inside clip do not depend on clip, and panning the endpoints by
+// whole pixels pans the pixels with them. Expects 32-bit pixels.
+void draw_line(SDL_Surface *surface, float x0, float y0, float x1, float y1,
+               Uint32 color, const SDL_Rect *clip = NULL);
@@ -0,0 +1,146 @@
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "glyph_atlas.h"
+
+#include "raster.h"
+
+#include "debug.h"
+
+static Uint64 glyph_key(int codepoint, int pixel_height) {
+  return ((Uint64)(Uint32)pixel_height << 32) | (Uint32)codepoint;
+}
+
+bool GlyphAtlas::init(const unsigned char *font_data) {
+  glyphs.clear();
+  coverage.clear();
+  glyph_slots.clear();
+  kerning.clear();
+  runs.clear();
+  return stbtt_InitFont(&font, font_data,
+                        stbtt_GetFontOffsetForIndex(font_data, 0)) != 0;
+}
+
+Uint32 GlyphAtlas::glyph(int codepoint, int pixel_height, float scale) {
+  Uint64 key = glyph_key(codepoint, pixel_height);
+  auto it = glyph_slots.find(key);
+  if (it != glyph_slots.end())
+    return it->second;
+
+  Glyph g;
+  int advance, left_bearing, x1, y1;
+  stbtt_GetCodepointHMetrics(&font, codepoint, &advance, &left_bearing);
+  stbtt_GetCodepointBitmapBox(&font, codepoint, scale, scale, &g.x0, &g.y0,
+                              &x1, &y1);
+  g.w = x1 > g.x0 ? x1 - g.x0 : 0;
+  g.h = y1 > g.y0 ? y1 - g.y0 : 0;
+  g.advance = (int)(advance * scale);
+  g.offset = coverage.size();
+  if (g.w > 0 && g.h > 0) {
+    coverage.resize(g.offset + (size_t)g.w * g.h);
+    stbtt_MakeCodepointBitmap(&font, coverage.data() + g.offset, g.w, g.h,
+                              g.w, scale, scale, codepoint);
+  }
+  Uint32 slot = (Uint32)glyphs.size();
+  glyphs.push_back(g);
+  glyph_slots.emplace(key, slot);
+  return slot;
+}
+
+int GlyphAtlas::kern(int a, int b, int pixel_height, float scale) {
+  Uint64 key = ((Uint64)(Uint32)pixel_height << 42) |
+               ((Uint64)(a & 0x1FFFFF) << 21) | (Uint64)(b & 0x1FFFFF);
+  auto it = kerning.find(key);
+  if (it != kerning.end())
+    return it->second;
+  int k = (int)(stbtt_GetCodepointKernAdvance(&font, a, b) * scale);
+  kerning.emplace(key, k);
+  return k;
+}
+
+const GlyphAtlas::TextRun &GlyphAtlas::layout(const char *text,
+                                              int pixel_height) {
+  std::string key(text);
+  key.push_back('\0');
+  key.append((const char *)&pixel_height, sizeof(pixel_height));
+  auto it = runs.find(key);
+  if (it != runs.end())
+    return it->second;
+
+  // Strings such as the FPS meter change constantly; dropping everything
+  // once in a while is cheaper than tracking use. Glyphs are kept.
+  if (runs.size() >= MAX_RUNS)
+    runs.clear();
+
+  float scale = stbtt_ScaleForPixelHeight(&font, (float)pixel_height);
+  int ascent, descent, line_gap;
+  stbtt_GetFontVMetrics(&font, &ascent, &descent, &line_gap);
+
+  TextRun run;
+  run.ascent = (int)(ascent * scale);
+  run.descent = (int)(descent * scale);
+  int pen = 0;
+  for (int i = 0; text[i]; ++i) {
+    int c = (unsigned char)text[i];
+    Uint32 g = glyph(c, pixel_height, scale);
+    if (glyphs[g].w > 0) {
+      SDL_Rect box = {pen + glyphs[g].x0, glyphs[g].y0, glyphs[g].w,
+                      glyphs[g].h};
+      if (run.glyphs.empty())
+        run.ink = box;
+      else
+        SDL_GetRectUnion(&run.ink, &box, &run.ink);
+      run.glyphs.push_back({g, pen});
+    }
+    pen += glyphs[g].advance;
+    if (text[i + 1])
+      pen += kern(c, (unsigned char)text[i + 1], pixel_height, scale);
+  }
+  run.width = pen;
+  return runs.emplace(std::move(key), std::move(run)).first->second;
+}
+
+void GlyphAtlas::draw(SDL_Surface *surface, const TextRun &run, int x,
+                      int baseline, Uint32 color, const SDL_Rect *clip) const {
+  SDL_Rect bounds = {0, 0, surface->w, surface->h};
+  if (clip && !SDL_GetRectIntersection(clip, &bounds, &bounds))
+    return;
+  int bx2 = bounds.x + bounds.w, by2 = bounds.y + bounds.h;
+  const SDL_PixelFormatDetails *format =
+      SDL_GetPixelFormatDetails(surface->format);
+  bool direct = format->bytes_per_pixel == 4;
+  Uint8 r, g, b;
+  SDL_GetRGB(color, format, NULL, &r, &g, &b);
+
+  for (const Placed &p : run.glyphs) {
+    const Glyph &glyph = glyphs[p.glyph];
+    int gx = x + p.x + glyph.x0, gy = baseline + glyph.y0;
+    int px1 = SDL_max(gx, bounds.x), px2 = SDL_min(gx + glyph.w, bx2);
+    int py1 = SDL_max(gy, bounds.y), py2 = SDL_min(gy + glyph.h, by2);
+    for (int py = py1; py < py2; ++py) {
+      const Uint8 *src =
+          coverage.data() + glyph.offset + (size_t)(py - gy) * glyph.w;
+      if (direct) {
+        Uint32 *dst = (Uint32 *)((Uint8 *)surface->pixels +
+                                 (size_t)py * surface->pitch);
+        for (int px = px1; px < px2; ++px) {
+          Uint32 alpha = src[px - gx];
+          if (alpha == 255)
+            dst[px] = color;
+          else if (alpha)
+            dst[px] = blend_pixel(dst[px], color, alpha);
+        }
+        continue;
+      }
+      for (int px = px1; px < px2; ++px) {
+        Uint32 alpha = src[px - gx];
+        if (!alpha)
+          continue;
+        Uint8 dr, dg, db, da;
+        SDL_ReadSurfacePixel(surface, px, py, &dr, &dg, &db, &da);
+        SDL_WriteSurfacePixel(
+            surface, px, py, (Uint8)((r * alpha + dr * (255 - alpha)) / 255),
+            (Uint8)((g * alpha + dg * (255 - alpha)) / 255),
+            (Uint8)((b * alpha + db * (255 - alpha)) / 255), 255);
+      }
+    }
+  }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <stb_truetype.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Rasterized glyphs and laid-out strings for one TrueType font.
+//
+// Each (codepoint, pixel height) is rasterized once into coverage, a flat
+// 8-bit buffer shared by all glyphs; blits only read from it, so glyphs are
+// packed end to end rather than into a 2D sheet. Laid-out strings keep their
+// glyph positions, so redrawing an unchanged label is a hash lookup plus
+// the blend loop.
+struct GlyphAtlas {
+  static constexpr size_t MAX_RUNS = 4096; // laid-out strings kept
+
+  struct Glyph {
+    int x0, y0; // bitmap offset from the pen position on the baseline
+    int w, h;
+    int advance; // pixels
+    size_t offset; // into coverage
+  };
+  struct Placed {
+    Uint32 glyph; // index into glyphs
+    int x;        // pen position relative to the start of the string
+  };
+  // One laid-out string. descent is negative, as stb_truetype reports it.
+  struct TextRun {
+    int width = 0;
+    int ascent = 0, descent = 0;
+    SDL_Rect ink = {0, 0, 0, 0}; // covered pixels, relative to the origin
+    std::vector<Placed> glyphs;
+  };
+
+  stbtt_fontinfo font;
+  std::vector<Glyph> glyphs;
+  std::vector<Uint8> coverage;
+  std::unordered_map<Uint64, Uint32> glyph_slots; // (height, codepoint)
+  std::unordered_map<Uint64, int> kerning;        // pixels per pair
+  std::unordered_map<std::string, TextRun> runs;
+
+  // font_data must outlive the atlas.
+  bool init(const unsigned char *font_data);
+  // Positions of text at the given pixel height, cached across calls. The
+  // reference stays valid until the next call.
+  const TextRun &layout(const char *text, int pixel_height);
+  // Blends run onto surface with its baseline starting at (x, baseline),
+  // writing only pixels inside the surface and, if given, clip.
+  void draw(SDL_Surface *surface, const TextRun &run, int x, int baseline,
+            Uint32 color, const SDL_Rect *clip = NULL) const;
+
+private:
+  Uint32 glyph(int codepoint, int pixel_height, float scale);
+  int kern(int a, int b, int pixel_height, float scale);
+};
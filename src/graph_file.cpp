@@ -0,0 +1,209 @@
+#include "graph_file.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "debug.h"
+
+static size_t section_size(const GraphFileHeader &header, int section) {
+  switch (section) {
+  case GRAPH_SECTION_X:
+  case GRAPH_SECTION_Y:
+  case GRAPH_SECTION_WIDTH:
+  case GRAPH_SECTION_HEIGHT:
+  case GRAPH_SECTION_BORDER:
+    return header.node_count * sizeof(float);
+  case GRAPH_SECTION_COLOR:
+  case GRAPH_SECTION_DATA:
+    return header.node_count * sizeof(Uint32);
+  case GRAPH_SECTION_EDGE_OFFSETS:
+    return (header.flags & GRAPH_FILE_HAS_EDGES)
+               ? (header.node_count + 1) * sizeof(Uint64)
+               : 0;
+  case GRAPH_SECTION_EDGE_TARGETS:
+    return (header.flags & GRAPH_FILE_HAS_EDGES)
+               ? header.edge_count * sizeof(Uint32)
+               : 0;
+  }
+  return 0;
+}
+
+static Uint64 align_up(Uint64 value) {
+  return (value + GRAPH_FILE_ALIGN - 1) & ~(Uint64)(GRAPH_FILE_ALIGN - 1);
+}
+
+// Offsets start at 0, never decrease and end at edge_count, and every
+// target names a node.
+static bool edges_valid(const GraphColumns &columns) {
+  const Uint64 *offsets = columns.edge_offsets;
+  Uint64 n = columns.node_count;
+  if (offsets[0] != 0 || offsets[n] != columns.edge_count)
+    return false;
+  for (Uint64 i = 0; i < n; ++i)
+    if (offsets[i + 1] < offsets[i])
+      return false;
+  for (Uint64 e = 0; e < columns.edge_count; ++e)
+    if (columns.edge_targets[e] >= n)
+      return false;
+  return true;
+}
+
+bool GraphFile::open(const char *path) {
+  columns = GraphColumns();
+  if (!file.open(path))
+    return false;
+
+  if (file.size < sizeof(GraphFileHeader)) {
+    log("%s: truncated header\n", path);
+    file.close();
+    return false;
+  }
+  const GraphFileHeader &header = *(const GraphFileHeader *)file.data;
+  if (memcmp(header.magic, GRAPH_FILE_MAGIC, sizeof(header.magic)) != 0) {
+    log("%s: not a graph file\n", path);
+    file.close();
+    return false;
+  }
+  if (header.version != GRAPH_FILE_VERSION) {
+    log("%s: unsupported version %u (expected %u)\n", path, header.version,
+        GRAPH_FILE_VERSION);
+    file.close();
+    return false;
+  }
+  // Node indices are stored as int throughout the viewer.
+  if (header.node_count > INT_MAX || header.edge_count > UINT_MAX) {
+    log("%s: graph too large (%llu nodes, %llu edges)\n", path,
+        (unsigned long long)header.node_count,
+        (unsigned long long)header.edge_count);
+    file.close();
+    return false;
+  }
+
+  const void *sections[GRAPH_SECTION_COUNT] = {};
+  for (int s = 0; s < GRAPH_SECTION_COUNT; ++s) {
+    size_t bytes = section_size(header, s);
+    if (bytes == 0)
+      continue;
+    Uint64 offset = header.section_offset[s];
+    if (offset % GRAPH_FILE_ALIGN != 0 || offset > file.size ||
+        bytes > file.size - offset) {
+      log("%s: section %d out of bounds\n", path, s);
+      file.close();
+      return false;
+    }
+    sections[s] = file.data + offset;
+  }
+
+  columns.node_count = header.node_count;
+  columns.x = (const float *)sections[GRAPH_SECTION_X];
+  columns.y = (const float *)sections[GRAPH_SECTION_Y];
+  columns.width = (const float *)sections[GRAPH_SECTION_WIDTH];
+  columns.height = (const float *)sections[GRAPH_SECTION_HEIGHT];
+  columns.border_thickness = (const float *)sections[GRAPH_SECTION_BORDER];
+  columns.color = (const Uint32 *)sections[GRAPH_SECTION_COLOR];
+  columns.data = (const Uint32 *)sections[GRAPH_SECTION_DATA];
+  if (header.flags & GRAPH_FILE_HAS_EDGES) {
+    columns.edge_count = header.edge_count;
+    columns.edge_offsets = (const Uint64 *)sections[GRAPH_SECTION_EDGE_OFFSETS];
+    columns.edge_targets = (const Uint32 *)sections[GRAPH_SECTION_EDGE_TARGETS];
+    // Every offset and target is checked: the edge block is indexed
+    // without bounds checks everywhere else. This faults in the whole
+    // block, which building the edge index does right after anyway.
+    if (!edges_valid(columns)) {
+      log("%s: corrupt edge block\n", path);
+      columns = GraphColumns();
+      file.close();
+      return false;
+    }
+  }
+  bounds = header.bounds;
+
+  log("Mapped %s: %llu nodes, %llu edges\n", path,
+      (unsigned long long)columns.node_count,
+      (unsigned long long)columns.edge_count);
+  return true;
+}
+
+bool write_graph_file(const char *path, const GraphColumns &columns) {
+  GraphFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, GRAPH_FILE_MAGIC, sizeof(header.magic));
+  header.version = GRAPH_FILE_VERSION;
+  header.node_count = columns.node_count;
+  if (columns.edge_offsets && columns.edge_targets) {
+    header.flags |= GRAPH_FILE_HAS_EDGES;
+    header.edge_count = columns.edge_count;
+  }
+
+  Rect bounds = {0, 0, 0, 0};
+  for (Uint64 i = 0; i < columns.node_count; ++i) {
+    float x = columns.x[i];
+    float y = columns.y[i];
+    if (i == 0) {
+      bounds = {x, y, x, y};
+      continue;
+    }
+    bounds.x1 = x < bounds.x1 ? x : bounds.x1;
+    bounds.y1 = y < bounds.y1 ? y : bounds.y1;
+    bounds.x2 = x > bounds.x2 ? x : bounds.x2;
+    bounds.y2 = y > bounds.y2 ? y : bounds.y2;
+  }
+  header.bounds = bounds;
+
+  const void *sections[GRAPH_SECTION_COUNT] = {
+      columns.x,
+      columns.y,
+      columns.width,
+      columns.height,
+      columns.border_thickness,
+      columns.color,
+      columns.data,
+      columns.edge_offsets,
+      columns.edge_targets,
+  };
+  Uint64 offset = align_up(sizeof(header));
+  for (int s = 0; s < GRAPH_SECTION_COUNT; ++s) {
+    size_t bytes = section_size(header, s);
+    if (bytes == 0)
+      continue;
+    header.section_offset[s] = offset;
+    offset = align_up(offset + bytes);
+  }
+
+  FILE *f = fopen(path, "wb");
+  if (!f) {
+    log("Failed to create %s\n", path);
+    return false;
+  }
+  static const Uint8 zeros[GRAPH_FILE_ALIGN] = {};
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+  Uint64 written = sizeof(header);
+  for (int s = 0; s < GRAPH_SECTION_COUNT && ok; ++s) {
+    size_t bytes = section_size(header, s);
+    if (bytes == 0)
+      continue;
+    ok = fwrite(zeros, 1, header.section_offset[s] - written, f) ==
+             header.section_offset[s] - written &&
+         fwrite(sections[s], 1, bytes, f) == bytes;
+    written = header.section_offset[s] + bytes;
+  }
+  if (fclose(f) != 0)
+    ok = false;
+  if (!ok)
+    log("Failed to write %s\n", path);
+  return ok;
+}
+
+void load_nodes(const GraphColumns &columns, NodeStore &nodes) {
+  size_t n = (size_t)columns.node_count;
+  nodes.resize(n);
+  memcpy(nodes.x.data(), columns.x, n * sizeof(float));
+  memcpy(nodes.y.data(), columns.y, n * sizeof(float));
+  memcpy(nodes.width.data(), columns.width, n * sizeof(float));
+  memcpy(nodes.height.data(), columns.height, n * sizeof(float));
+  memcpy(nodes.border_thickness.data(), columns.border_thickness,
+         n * sizeof(float));
+  memcpy(nodes.color.data(), columns.color, n * sizeof(Uint32));
+  memcpy(nodes.data.data(), columns.data, n * sizeof(Uint32));
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <SDL3/SDL_stdinc.h>
+#include <vector>
+
+#include "mapped_file.h"
+#include "node.h"
+
+// Binary graph format (.gvb)
+//
+// A fixed 128 byte header followed by one tightly packed column per node
+// attribute and an optional CSR edge block. Every section starts on a 64
+// byte boundary so the columns can be used straight out of the mapping.
+// All values are little endian.
+
+#define GRAPH_FILE_MAGIC "GVBINARY"
+#define GRAPH_FILE_VERSION 1
+#define GRAPH_FILE_ALIGN 64
+
+enum GraphFileFlags : Uint32 {
+  GRAPH_FILE_HAS_EDGES = 1u << 0,
+};
+
+enum GraphSection {
+  GRAPH_SECTION_X,             // float[node_count], node center
+  GRAPH_SECTION_Y,             // float[node_count], node center
+  GRAPH_SECTION_WIDTH,         // float[node_count]
+  GRAPH_SECTION_HEIGHT,        // float[node_count]
+  GRAPH_SECTION_BORDER,        // float[node_count]
+  GRAPH_SECTION_COLOR,         // Uint32[node_count], see pack_rgba()
+  GRAPH_SECTION_DATA,          // Uint32[node_count], NodeStore::data payload
+  GRAPH_SECTION_EDGE_OFFSETS,  // Uint64[node_count + 1]
+  GRAPH_SECTION_EDGE_TARGETS,  // Uint32[edge_count]
+  GRAPH_SECTION_COUNT
+};
+
+struct GraphFileHeader {
+  char magic[8];
+  Uint32 version;
+  Uint32 flags;
+  Uint64 node_count;
+  Uint64 edge_count;
+  Rect bounds; // of node centers
+  Uint64 section_offset[GRAPH_SECTION_COUNT];
+  Uint8 reserved[8];
+};
+static_assert(sizeof(GraphFileHeader) == 128, "GraphFileHeader layout");
+
+// Column view of a graph. Either points into a mapped GraphFile or at
+// caller-owned arrays that are about to be written out.
+struct GraphColumns {
+  Uint64 node_count = 0;
+  const float *x = nullptr;
+  const float *y = nullptr;
+  const float *width = nullptr;
+  const float *height = nullptr;
+  const float *border_thickness = nullptr;
+  const Uint32 *color = nullptr;
+  const Uint32 *data = nullptr;
+
+  // Outgoing edges of node i are edge_targets[edge_offsets[i] ..
+  // edge_offsets[i + 1]). Both are null when the graph has no edge block.
+  Uint64 edge_count = 0;
+  const Uint64 *edge_offsets = nullptr;
+  const Uint32 *edge_targets = nullptr;
+};
+
+struct GraphFile {
+  MappedFile file;
+  GraphColumns columns;
+  Rect bounds = {0, 0, 0, 0};
+
+  // Maps and validates the file. Nothing is copied; the columns stay valid
+  // until the GraphFile is destroyed.
+  bool open(const char *path);
+};
+
+bool write_graph_file(const char *path, const GraphColumns &columns);
+
+// Copies the columns into a NodeStore, one memcpy per column.
+void load_nodes(const GraphColumns &columns,
+                NodeStore &nodes);
@@ -0,0 +1,253 @@
+#include "graph_hierarchy.h"
+
+#include <SDL3/SDL_stdinc.h>
+#include <algorithm>
+#include <math.h>
+
+#include "debug.h"
+
+// Undirected adjacency of one level, both directions listed.
+struct Adjacency {
+  std::vector<Uint64> offsets;
+  std::vector<Uint32> targets;
+
+  size_t degree(size_t v) const { return offsets[v + 1] - offsets[v]; }
+
+  // From (a, b) pairs with a != b, each listed once.
+  void assign(size_t count, const std::vector<Uint64> &pairs) {
+    offsets.assign(count + 1, 0);
+    for (Uint64 p : pairs) {
+      offsets[(p >> 32) + 1]++;
+      offsets[(p & 0xFFFFFFFFu) + 1]++;
+    }
+    for (size_t v = 0; v < count; ++v)
+      offsets[v + 1] += offsets[v];
+    targets.resize(offsets[count]);
+    std::vector<Uint64> cursor(offsets.begin(), offsets.end() - 1);
+    for (Uint64 p : pairs) {
+      Uint32 a = (Uint32)(p >> 32), b = (Uint32)(p & 0xFFFFFFFFu);
+      targets[cursor[a]++] = b;
+      targets[cursor[b]++] = a;
+    }
+  }
+};
+
+static Uint64 pair_key(Uint32 a, Uint32 b) {
+  return a < b ? ((Uint64)a << 32) | b : ((Uint64)b << 32) | a;
+}
+
+// Distinct undirected edges between groups, as pair_key()s.
+static void group_edges(const Adjacency &adjacency,
+                        const std::vector<int> &group,
+                        std::vector<Uint64> &pairs) {
+  pairs.clear();
+  for (size_t v = 0; v < group.size(); ++v) {
+    if (group[v] < 0)
+      continue;
+    for (Uint64 e = adjacency.offsets[v]; e < adjacency.offsets[v + 1]; ++e) {
+      Uint32 u = adjacency.targets[e];
+      if (u > v && group[u] >= 0 && group[u] != group[v])
+        pairs.push_back(pair_key((Uint32)group[v], (Uint32)group[u]));
+    }
+  }
+  std::sort(pairs.begin(), pairs.end());
+  pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+}
+
+// Galaxy grouping of the nodes listed in spatial (Morton) order; nodes not
+// listed stay ungrouped. Returns the number of groups.
+static int group_nodes(const Adjacency &adjacency,
+                       const std::vector<Uint32> &weight,
+                       const std::vector<int> &spatial,
+                       std::vector<int> &group) {
+  size_t count = adjacency.offsets.size() - 1;
+  group.assign(count, -1);
+  std::vector<Uint8> blocked(count, 0);
+  int groups = 0;
+
+  // Suns, lightest first so systems stay even, each blocking everything
+  // within two hops.
+  std::vector<int> visit(spatial);
+  std::stable_sort(visit.begin(), visit.end(),
+                   [&](int a, int b) { return weight[a] < weight[b]; });
+  for (int v : visit) {
+    if (blocked[v] || adjacency.degree(v) == 0)
+      continue;
+    int sun = groups++;
+    group[v] = sun;
+    blocked[v] = 1;
+    for (Uint64 e = adjacency.offsets[v]; e < adjacency.offsets[v + 1]; ++e) {
+      Uint32 planet = adjacency.targets[e];
+      group[planet] = sun;
+      blocked[planet] = 1;
+      for (Uint64 f = adjacency.offsets[planet];
+           f < adjacency.offsets[planet + 1]; ++f)
+        blocked[adjacency.targets[f]] = 1;
+    }
+  }
+
+  // Moons: every other node with edges is next to a planet.
+  std::vector<int> moons;
+  for (int v : visit) {
+    if (group[v] >= 0 || adjacency.degree(v) == 0)
+      continue;
+    for (Uint64 e = adjacency.offsets[v]; e < adjacency.offsets[v + 1]; ++e) {
+      int planet_group = group[adjacency.targets[e]];
+      if (planet_group >= 0) {
+        moons.push_back(v);
+        moons.push_back(planet_group);
+        break;
+      }
+    }
+  }
+  for (size_t k = 0; k < moons.size(); k += 2)
+    group[moons[k]] = moons[k + 1];
+
+  // Nodes without edges, GROUP neighbours in space at a time.
+  int run = 0;
+  for (int v : spatial) {
+    if (adjacency.degree(v) != 0)
+      continue;
+    if (run++ % GraphHierarchy::GROUP == 0)
+      groups++;
+    group[v] = groups - 1;
+  }
+  return groups;
+}
+
+// Places each super-node at its members' weighted center with their total
+// area and average color.
+static void fit_level(const NodeStore &source,
+                      const std::vector<Uint32> *weights, CoarseLevel &level) {
+  size_t groups = level.members.size();
+  std::vector<double> sum_w(groups, 0.0), sum_x(groups, 0.0),
+      sum_y(groups, 0.0), area(groups, 0.0);
+  std::vector<double> channels(groups * 4, 0.0);
+  for (size_t v = 0; v < level.parent.size(); ++v) {
+    int g = level.parent[v];
+    if (g < 0)
+      continue;
+    double w = weights ? (double)(*weights)[v] : 1.0;
+    float t = source.border_thickness[v];
+    Uint32 rgba = source.color[v];
+    sum_w[g] += w;
+    sum_x[g] += source.x[v] * w;
+    sum_y[g] += source.y[v] * w;
+    area[g] += (double)(source.width[v] + 2.0f * t) *
+               (source.height[v] + 2.0f * t);
+    channels[g * 4 + 0] += rgba_r(rgba) * w;
+    channels[g * 4 + 1] += rgba_g(rgba) * w;
+    channels[g * 4 + 2] += rgba_b(rgba) * w;
+    channels[g * 4 + 3] += rgba_a(rgba) * w;
+  }
+
+  NodeStore &nodes = level.nodes;
+  for (size_t g = 0; g < groups; ++g) {
+    double w = sum_w[g] > 0.0 ? sum_w[g] : 1.0;
+    float side = (float)sqrt(area[g]);
+    nodes.x[g] = (float)(sum_x[g] / w);
+    nodes.y[g] = (float)(sum_y[g] / w);
+    nodes.border_thickness[g] = 1.0f;
+    nodes.width[g] = nodes.height[g] = SDL_max(side - 2.0f, 0.0f);
+    nodes.color[g] = pack_rgba((Uint8)(channels[g * 4 + 0] / w),
+                               (Uint8)(channels[g * 4 + 1] / w),
+                               (Uint8)(channels[g * 4 + 2] / w),
+                               (Uint8)(channels[g * 4 + 3] / w));
+    nodes.data[g] = level.members[g];
+  }
+}
+
+void GraphHierarchy::build(const NodeStore &nodes, const EdgeCSR &csr) {
+  levels.clear();
+  levels.reserve(MAX_LEVELS);
+  size_t n = nodes.size();
+  if (n <= MIN_NODES)
+    return;
+
+  // The real graph: visible nodes and the distinct edges between them.
+  bool any_hidden = !nodes.hidden.empty();
+  std::vector<int> alive(n);
+  for (size_t i = 0; i < n; ++i)
+    alive[i] = any_hidden && nodes.hidden.contains((int)i) ? -1 : 0;
+  std::vector<Uint64> pairs;
+  for (int i = 0; csr.offsets && i < csr.node_count; ++i) {
+    for (Uint64 e = csr.offsets[i]; e < csr.offsets[i + 1]; ++e) {
+      Uint32 t = csr.targets[e];
+      if (t != (Uint32)i && alive[i] == 0 && alive[t] == 0)
+        pairs.push_back(pair_key((Uint32)i, t));
+    }
+  }
+  std::sort(pairs.begin(), pairs.end());
+  pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+  Adjacency adjacency;
+  adjacency.assign(n, pairs);
+  std::vector<Uint32> weight(n, 1);
+  SpatialIndex base;
+  base.build(nodes);
+  std::vector<int> spatial;
+  for (int i : base.order)
+    if (alive[i] == 0)
+      spatial.push_back(i);
+
+  const NodeStore *source = &nodes;
+  const std::vector<Uint32> *source_weight = NULL;
+  while (levels.size() < (size_t)MAX_LEVELS && spatial.size() > MIN_NODES) {
+    std::vector<int> group;
+    int groups = group_nodes(adjacency, weight, spatial, group);
+    if ((float)groups > (float)spatial.size() * (1.0f - STALL))
+      break;
+
+    levels.emplace_back();
+    CoarseLevel &level = levels.back();
+    level.parent.swap(group);
+    level.members.assign(groups, 0);
+    for (size_t v = 0; v < level.parent.size(); ++v)
+      if (level.parent[v] >= 0)
+        level.members[level.parent[v]] += weight[v];
+    level.nodes.resize(groups);
+    fit_level(*source, source_weight, level);
+    level.index.build(level.nodes);
+
+    group_edges(adjacency, level.parent, pairs);
+    std::vector<Uint32> from(pairs.size()), to(pairs.size());
+    for (size_t e = 0; e < pairs.size(); ++e) {
+      from[e] = (Uint32)(pairs[e] >> 32);
+      to[e] = (Uint32)(pairs[e] & 0xFFFFFFFFu);
+    }
+    level.edges.csr.assign(groups, from.data(), to.data(), pairs.size());
+    level.edges.rebuild(level.nodes);
+    log("Coarse level %zu: %d nodes, %zu edges\n", levels.size(), groups,
+        pairs.size());
+
+    adjacency.assign(groups, pairs);
+    weight = level.members;
+    spatial = level.index.order;
+    source = &level.nodes;
+    source_weight = &level.members;
+  }
+  log("Hierarchy: %zu levels, %zu KiB\n", levels.size(),
+      memory_bytes() / 1024);
+}
+
+void GraphHierarchy::refit(const NodeStore &nodes) {
+  for (size_t l = 0; l < levels.size(); ++l) {
+    CoarseLevel &level = levels[l];
+    if (l == 0)
+      fit_level(nodes, NULL, level);
+    else
+      fit_level(levels[l - 1].nodes, &levels[l - 1].members, level);
+    level.index.refit();
+    level.edges.rebuild(level.nodes);
+  }
+}
+
+size_t GraphHierarchy::memory_bytes() const {
+  size_t bytes = 0;
+  for (const CoarseLevel &level : levels)
+    bytes += level.nodes.memory_bytes() + level.index.memory_bytes() +
+             level.members.capacity() * sizeof(Uint32) +
+             level.parent.capacity() * sizeof(int) +
+             level.edges.csr.owned_offsets.capacity() * sizeof(Uint64) +
+             level.edges.csr.owned_targets.capacity() * sizeof(Uint32);
+  return bytes;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <SDL3/SDL_stdinc.h>
+#include <vector>
+
+#include "edges.h"
+#include "node.h"
+#include "spatial_index.h"
+
+// Multilevel coarsening of the graph for semantic zoom.
+//
+// Each level merges the nodes of the one below into super-nodes the way
+// OGDF's GalaxyMultilevel does: suns are picked at least three hops apart,
+// lightest first, their neighbours become planets and every other node
+// joins a neighbouring planet's sun. Nodes without edges are grouped four
+// at a time in Morton order instead, so edgeless graphs coarsen too.
+//
+// A super-node sits at the weighted center of its members with an area
+// proportional to their count, the count as its data and their average
+// color. Edges between members of different super-nodes become one
+// aggregated edge. Every level has its own spatial index and edge layer,
+// so drawing one costs what is visible at that level.
+struct CoarseLevel {
+  NodeStore nodes;
+  SpatialIndex index;
+  EdgeLayer edges;
+  std::vector<Uint32> members; // real nodes per super-node
+  // Super-node of each node of the level below, -1 for hidden real nodes.
+  std::vector<int> parent;
+};
+
+struct GraphHierarchy {
+  static constexpr int MAX_LEVELS = 24;
+  // Coarsening stops once a level has this few super-nodes, or when a
+  // level merges less than STALL of the nodes away.
+  static constexpr size_t MIN_NODES = 64;
+  static constexpr float STALL = 0.1f;
+  static constexpr int GROUP = 4; // edgeless nodes merged per super-node
+
+  // levels[0] is the first coarsening of the real nodes. Reserved to
+  // MAX_LEVELS so the indexes' node pointers stay valid.
+  std::vector<CoarseLevel> levels;
+
+  GraphHierarchy() = default;
+  GraphHierarchy(const GraphHierarchy &) = delete;
+  GraphHierarchy &operator=(const GraphHierarchy &) = delete;
+
+  // Coarsens the visible nodes. Must be called again when nodes are hidden
+  // or shown or the edges change.
+  void build(const NodeStore &nodes, const EdgeCSR &csr);
+  // Recomputes super-node positions and colors after the real nodes moved
+  // or were recolored, keeping the grouping.
+  void refit(const NodeStore &nodes);
+  void clear() { levels.clear(); }
+  bool empty() const { return levels.empty(); }
+  size_t memory_bytes() const;
+};
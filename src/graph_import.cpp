@@ -0,0 +1,1023 @@
+#include "graph_import.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "parallel.h"
+
+#include "debug.h"
+
+// Target chunk size. A chunk ends at the first record boundary after it.
+static constexpr size_t IMPORT_CHUNK_BYTES = 8 << 20;
+// Ids are resolved in 2^IMPORT_PARTITION_BITS independent hash partitions,
+// picked by the top bits of the id's hash.
+static constexpr int IMPORT_PARTITION_BITS = 6;
+static constexpr int IMPORT_PARTITIONS = 1 << IMPORT_PARTITION_BITS;
+
+// Node size when the file gives none, border included, as OGDF defaults.
+static constexpr float DEFAULT_NODE_SIZE = 20.0f;
+static constexpr float DEFAULT_BORDER = 1.0f;
+// DOT sizes are in inches, positions in points.
+static constexpr float POINTS_PER_INCH = 72.0f;
+
+enum NodeFields : Uint32 {
+  NODE_X = 1u << 0,
+  NODE_Y = 1u << 1,
+  NODE_WIDTH = 1u << 2,
+  NODE_HEIGHT = 1u << 3,
+  NODE_LABEL = 1u << 4,
+};
+
+// One occurrence of a node id in a chunk.
+struct IdRef {
+  Uint32 offset; // from the chunk start; chunks are kept under 4 GiB
+  Uint32 len;
+  Uint32 hash;
+  Uint32 slot; // index into Chunk::ids
+};
+
+// Attributes given with a node declaration. Sizes include the border.
+struct NodeRecord {
+  Uint32 slot;
+  Uint32 fields; // NodeFields
+  float x, y, width, height;
+  Uint32 label;
+};
+
+struct Chunk {
+  const char *begin = nullptr, *end = nullptr;
+  std::vector<IdRef> refs[IMPORT_PARTITIONS];
+  std::vector<Uint32> ids;   // node index per slot once resolved
+  std::vector<Uint32> edges; // source and target slot of each edge
+  std::vector<NodeRecord> nodes;
+  const char *error = nullptr; // where parsing stopped, if it failed
+
+  // Records one occurrence of the id [p, p + len) and returns its slot.
+  Uint32 id(const char *p, size_t len);
+};
+
+static Uint32 hash_id(const char *p, size_t len) {
+  Uint32 h = 2166136261u;
+  for (size_t k = 0; k < len; ++k)
+    h = (h ^ (Uint8)p[k]) * 16777619u;
+  // FNV-1a leaves the high bits, which pick the partition, poorly mixed.
+  h ^= h >> 16;
+  h *= 0x85EBCA6Bu;
+  h ^= h >> 13;
+  h *= 0xC2B2AE35u;
+  h ^= h >> 16;
+  return h;
+}
+
+Uint32 Chunk::id(const char *p, size_t len) {
+  Uint32 hash = hash_id(p, len);
+  Uint32 slot = (Uint32)ids.size();
+  ids.push_back(0);
+  refs[hash >> (32 - IMPORT_PARTITION_BITS)].push_back(
+      {(Uint32)(p - begin), (Uint32)len, hash, slot});
+  return slot;
+}
+
+static bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool token_is(const char *p, size_t len, const char *word) {
+  return strlen(word) == len && memcmp(p, word, len) == 0;
+}
+
+static void trim(const char *&p, size_t &len) {
+  while (len > 0 && is_space(*p))
+    ++p, --len;
+  while (len > 0 && is_space(p[len - 1]))
+    --len;
+}
+
+static bool parse_uint(const char *p, size_t len, Uint32 &value) {
+  if (len == 0 || len > 10)
+    return false;
+  Uint64 v = 0;
+  for (size_t k = 0; k < len; ++k) {
+    if (p[k] < '0' || p[k] > '9')
+      return false;
+    v = v * 10 + (Uint64)(p[k] - '0');
+  }
+  if (v > 0xFFFFFFFFull)
+    return false;
+  value = (Uint32)v;
+  return true;
+}
+
+// strtof() on an unterminated field.
+static bool parse_float(const char *p, size_t len, float &value) {
+  char buf[64];
+  trim(p, len);
+  if (len == 0 || len >= sizeof(buf))
+    return false;
+  memcpy(buf, p, len);
+  buf[len] = '\0';
+  char *end = NULL;
+  value = strtof(buf, &end);
+  return end != buf;
+}
+
+// Edge lists
+
+static bool is_separator(char c) {
+  return c == ' ' || c == '\t' || c == ',' || c == ';' || c == '\r';
+}
+
+// One record per line: two fields are an edge, one is a node, further
+// fields such as weights are ignored. Lines starting with # or % are
+// comments. skip_header drops the first line if its first field is not a
+// number.
+static void parse_edge_list(Chunk &chunk, bool skip_header) {
+  const char *p = chunk.begin, *end = chunk.end;
+  for (; p < end; ++p) {
+    const char *line_end = (const char *)memchr(p, '\n', end - p);
+    if (!line_end)
+      line_end = end;
+    const char *fields[2];
+    size_t lens[2];
+    int count = 0;
+    const char *q = p;
+    while (q < line_end && is_separator(*q))
+      ++q;
+    if (q < line_end && (*q == '#' || *q == '%'))
+      q = line_end;
+    while (count < 2) {
+      while (q < line_end && is_separator(*q))
+        ++q;
+      if (q == line_end)
+        break;
+      if (*q == '"') {
+        const char *close =
+            (const char *)memchr(q + 1, '"', line_end - (q + 1));
+        if (!close) {
+          chunk.error = q;
+          return;
+        }
+        fields[count] = q + 1;
+        lens[count++] = close - (q + 1);
+        q = close + 1;
+      } else {
+        fields[count] = q;
+        while (q < line_end && !is_separator(*q))
+          ++q;
+        lens[count] = q - fields[count];
+        count++;
+      }
+    }
+    p = line_end;
+    if (count == 0)
+      continue;
+    if (skip_header) {
+      skip_header = false;
+      Uint32 value;
+      if (!parse_uint(fields[0], lens[0], value))
+        continue;
+    }
+    if (count == 2) {
+      chunk.edges.push_back(chunk.id(fields[0], lens[0]));
+      chunk.edges.push_back(chunk.id(fields[1], lens[1]));
+    } else {
+      chunk.id(fields[0], lens[0]);
+    }
+  }
+}
+
+// DOT
+
+enum DotTokenType { DOT_END, DOT_ID, DOT_EDGE_OP, DOT_PUNCT, DOT_ERROR };
+
+static bool is_dot_id_char(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_' || c == '.' || (Uint8)c >= 0x80;
+}
+
+// Tokens of the DOT language. Quoted and HTML ids are returned without
+// their delimiters and with escapes left in place.
+struct DotLexer {
+  const char *file_begin, *p, *end;
+  DotTokenType type = DOT_END;
+  const char *text = nullptr;
+  size_t len = 0;
+
+  bool is(char c) const { return type == DOT_PUNCT && *text == c; }
+  bool keyword(const char *word) const {
+    return type == DOT_ID && strlen(word) == len &&
+           SDL_strncasecmp(text, word, len) == 0;
+  }
+
+  void next() {
+    for (;;) {
+      while (p < end && is_space(*p))
+        ++p;
+      if (p >= end) {
+        type = DOT_END;
+        return;
+      }
+      // A # line is preprocessor output, ignored like a comment.
+      const char *line = p;
+      while (line > file_begin && (line[-1] == ' ' || line[-1] == '\t'))
+        --line;
+      bool line_comment =
+          *p == '#' && (line == file_begin || line[-1] == '\n');
+      if (*p == '/' && p + 1 < end && p[1] == '/')
+        line_comment = true;
+      if (line_comment) {
+        const char *eol = (const char *)memchr(p, '\n', end - p);
+        p = eol ? eol : end;
+        continue;
+      }
+      if (*p == '/' && p + 1 < end && p[1] == '*') {
+        const char *q = p + 2;
+        while (q + 1 < end && !(q[0] == '*' && q[1] == '/'))
+          ++q;
+        p = q + 2 <= end ? q + 2 : end;
+        continue;
+      }
+      break;
+    }
+    text = p;
+    char c = *p;
+    if (c == '"') {
+      const char *q = p + 1;
+      while (q < end && *q != '"')
+        q += (*q == '\\' && q + 1 < end) ? 2 : 1;
+      if (q >= end) {
+        type = DOT_ERROR;
+        return;
+      }
+      type = DOT_ID;
+      text = p + 1;
+      len = q - text;
+      p = q + 1;
+    } else if (c == '<') {
+      int depth = 0;
+      const char *q = p;
+      do {
+        depth += *q == '<' ? 1 : (*q == '>' ? -1 : 0);
+        ++q;
+      } while (q < end && depth > 0);
+      if (depth > 0) {
+        type = DOT_ERROR;
+        return;
+      }
+      type = DOT_ID;
+      text = p + 1;
+      len = q - 1 - text;
+      p = q;
+    } else if (c == '-' && p + 1 < end && (p[1] == '>' || p[1] == '-')) {
+      type = DOT_EDGE_OP;
+      len = 2;
+      p += 2;
+    } else if (is_dot_id_char(c) || c == '-') {
+      const char *q = p + 1;
+      while (q < end && is_dot_id_char(*q))
+        ++q;
+      type = DOT_ID;
+      len = q - p;
+      p = q;
+    } else {
+      type = DOT_PUNCT;
+      len = 1;
+      ++p;
+    }
+  }
+};
+
+static void apply_dot_attribute(NodeRecord &record, const char *name,
+                                size_t name_len, const char *value,
+                                size_t len) {
+  if (token_is(name, name_len, "pos")) {
+    // "x,y" with an optional trailing "!".
+    const char *comma = (const char *)memchr(value, ',', len);
+    if (comma && parse_float(value, comma - value, record.x) &&
+        parse_float(comma + 1, value + len - (comma + 1), record.y))
+      record.fields |= NODE_X | NODE_Y;
+  } else if (token_is(name, name_len, "width")) {
+    if (parse_float(value, len, record.width)) {
+      record.width *= POINTS_PER_INCH;
+      record.fields |= NODE_WIDTH;
+    }
+  } else if (token_is(name, name_len, "height")) {
+    if (parse_float(value, len, record.height)) {
+      record.height *= POINTS_PER_INCH;
+      record.fields |= NODE_HEIGHT;
+    }
+  } else if (token_is(name, name_len, "label")) {
+    trim(value, len);
+    if (parse_uint(value, len, record.label))
+      record.fields |= NODE_LABEL;
+  }
+}
+
+// Reads one [name=value, ...] list, applying it to record if given.
+static void parse_dot_attributes(DotLexer &lex, NodeRecord *record) {
+  lex.next();
+  while (lex.type == DOT_ID) {
+    const char *name = lex.text;
+    size_t name_len = lex.len;
+    lex.next();
+    if (!lex.is('='))
+      continue;
+    lex.next();
+    if (lex.type != DOT_ID)
+      break;
+    if (record)
+      apply_dot_attribute(*record, name, name_len, lex.text, lex.len);
+    lex.next();
+    while (lex.is(',') || lex.is(';'))
+      lex.next();
+  }
+  if (lex.is(']'))
+    lex.next();
+}
+
+static void skip_dot_port(DotLexer &lex) {
+  while (lex.is(':')) {
+    lex.next();
+    if (lex.type == DOT_ID)
+      lex.next();
+  }
+}
+
+// Node and edge statements. Subgraph braces are flattened; an edge to a
+// subgraph, as in a -> {b c}, connects to its first node only. Default
+// attribute statements and edge attributes are skipped.
+static void parse_dot(Chunk &chunk, const char *file_begin) {
+  DotLexer lex;
+  lex.file_begin = file_begin;
+  lex.p = chunk.begin;
+  lex.end = chunk.end;
+  lex.next();
+  while (lex.type != DOT_END) {
+    if (lex.type == DOT_ERROR) {
+      chunk.error = lex.text;
+      return;
+    }
+    if (lex.type != DOT_ID) {
+      lex.next();
+      continue;
+    }
+    if (lex.keyword("node") || lex.keyword("edge")) {
+      lex.next();
+      if (lex.is('['))
+        parse_dot_attributes(lex, NULL);
+      continue;
+    }
+    if (lex.keyword("strict") || lex.keyword("graph") ||
+        lex.keyword("digraph") || lex.keyword("subgraph")) {
+      lex.next();
+      if (lex.is('['))
+        parse_dot_attributes(lex, NULL);
+      else if (lex.type == DOT_ID && !lex.keyword("graph") &&
+               !lex.keyword("digraph"))
+        lex.next(); // the graph's name
+      continue;
+    }
+
+    const char *id = lex.text;
+    size_t id_len = lex.len;
+    lex.next();
+    if (lex.is('=')) {
+      // A graph attribute.
+      lex.next();
+      if (lex.type == DOT_ID)
+        lex.next();
+      continue;
+    }
+    skip_dot_port(lex);
+    NodeRecord record = {chunk.id(id, id_len), 0, 0, 0, 0, 0, 0};
+    Uint32 prev = record.slot;
+    bool is_edge = false;
+    while (lex.type == DOT_EDGE_OP) {
+      lex.next();
+      while (lex.is('{'))
+        lex.next();
+      if (lex.type != DOT_ID)
+        break;
+      Uint32 slot = chunk.id(lex.text, lex.len);
+      lex.next();
+      skip_dot_port(lex);
+      chunk.edges.push_back(prev);
+      chunk.edges.push_back(slot);
+      prev = slot;
+      is_edge = true;
+    }
+    while (lex.is('['))
+      parse_dot_attributes(lex, is_edge ? NULL : &record);
+    if (record.fields)
+      chunk.nodes.push_back(record);
+  }
+}
+
+// GraphML
+
+enum GraphmlField {
+  GRAPHML_X,
+  GRAPHML_Y,
+  GRAPHML_WIDTH,
+  GRAPHML_HEIGHT,
+  GRAPHML_LABEL
+};
+
+struct GraphmlKey {
+  std::string id;
+  GraphmlField field;
+};
+
+// Calls fn(name, name_len, value, value_len) for each attribute of the tag
+// whose name ends at p. Returns the position after the tag, or null if it
+// is malformed; closed tells whether it ended with "/>".
+template <typename Fn>
+static const char *xml_attributes(const char *p, const char *end,
+                                  bool &closed, Fn fn) {
+  for (;;) {
+    while (p < end && is_space(*p))
+      ++p;
+    if (p >= end)
+      return nullptr;
+    if (*p == '>' || *p == '/' || *p == '?') {
+      closed = *p != '>';
+      p += closed ? 1 : 0;
+      return p < end && *p == '>' ? p + 1 : nullptr;
+    }
+    const char *name = p;
+    while (p < end && *p != '=' && *p != '>' && *p != '/' && !is_space(*p))
+      ++p;
+    size_t name_len = p - name;
+    while (p < end && is_space(*p))
+      ++p;
+    if (name_len == 0 || p >= end)
+      return nullptr;
+    if (*p != '=')
+      continue;
+    ++p;
+    while (p < end && is_space(*p))
+      ++p;
+    if (p >= end || (*p != '"' && *p != '\''))
+      return nullptr;
+    const char *value = p + 1;
+    const char *close = (const char *)memchr(value, *p, end - value);
+    if (!close)
+      return nullptr;
+    fn(name, name_len, value, (size_t)(close - value));
+    p = close + 1;
+  }
+}
+
+static bool starts_tag(const char *p, const char *end, const char *name) {
+  size_t len = strlen(name);
+  return (size_t)(end - p) > len + 1 && p[0] == '<' &&
+         memcmp(p + 1, name, len) == 0 &&
+         (is_space(p[len + 1]) || p[len + 1] == '>' || p[len + 1] == '/');
+}
+
+static bool ends_with(const char *p, size_t len, const char *suffix) {
+  size_t suffix_len = strlen(suffix);
+  return len >= suffix_len &&
+         memcmp(p + len - suffix_len, suffix, suffix_len) == 0;
+}
+
+// Node attributes are declared by <key> elements ahead of the graph.
+static void parse_graphml_keys(const char *p, const char *end,
+                               std::vector<GraphmlKey> &keys) {
+  while (p < end && (p = (const char *)memchr(p, '<', end - p)) != NULL) {
+    if (!starts_tag(p, end, "key")) {
+      ++p;
+      continue;
+    }
+    std::string id, domain = "node";
+    int field = -1;
+    bool closed;
+    p = xml_attributes(p + 4, end, closed, [&](const char *name,
+                                               size_t name_len,
+                                               const char *value,
+                                               size_t len) {
+      static const char *names[] = {"x", "y", "width", "height", "label"};
+      if (token_is(name, name_len, "id"))
+        id.assign(value, len);
+      else if (token_is(name, name_len, "for"))
+        domain.assign(value, len);
+      else if (token_is(name, name_len, "attr.name"))
+        for (int f = 0; f < (int)SDL_arraysize(names); ++f)
+          if (strlen(names[f]) == len &&
+              SDL_strncasecmp(value, names[f], len) == 0)
+            field = f;
+    });
+    if (!p)
+      return;
+    if (field >= 0 && (domain == "node" || domain == "all"))
+      keys.push_back({id, (GraphmlField)field});
+  }
+}
+
+static void apply_graphml_field(NodeRecord &record, GraphmlField field,
+                                const char *value, size_t len) {
+  switch (field) {
+  case GRAPHML_X:
+    if (parse_float(value, len, record.x))
+      record.fields |= NODE_X;
+    break;
+  case GRAPHML_Y:
+    if (parse_float(value, len, record.y))
+      record.fields |= NODE_Y;
+    break;
+  case GRAPHML_WIDTH:
+    if (parse_float(value, len, record.width))
+      record.fields |= NODE_WIDTH;
+    break;
+  case GRAPHML_HEIGHT:
+    if (parse_float(value, len, record.height))
+      record.fields |= NODE_HEIGHT;
+    break;
+  case GRAPHML_LABEL:
+    trim(value, len);
+    if (parse_uint(value, len, record.label))
+      record.fields |= NODE_LABEL;
+    break;
+  }
+}
+
+// <node> and <edge> elements, with the node's <data> children and yEd's
+// <y:Geometry> and <y:NodeLabel>. Nested graphs are flattened.
+static void parse_graphml(Chunk &chunk, const std::vector<GraphmlKey> &keys) {
+  const char *p = chunk.begin, *end = chunk.end;
+  NodeRecord node = {};
+  bool in_node = false;
+  auto finish_node = [&]() {
+    if (in_node && node.fields)
+      chunk.nodes.push_back(node);
+    in_node = false;
+  };
+  while (p < end && (p = (const char *)memchr(p, '<', end - p)) != NULL) {
+    const char *tag = p++;
+    if (p < end && *p == '!') {
+      // Comments may contain '>'; other declarations may not.
+      bool comment = end - p >= 3 && memcmp(p, "!--", 3) == 0;
+      while (p < end && !(*p == '>' && (!comment || (p[-1] == '-' &&
+                                                      p[-2] == '-'))))
+        ++p;
+      p = p < end ? p + 1 : end;
+      continue;
+    }
+    bool closing = p < end && *p == '/';
+    p += closing ? 1 : 0;
+    const char *name = p;
+    while (p < end && !is_space(*p) && *p != '>' && *p != '/')
+      ++p;
+    size_t name_len = p - name;
+    if (closing) {
+      if (token_is(name, name_len, "node"))
+        finish_node();
+      continue;
+    }
+
+    bool closed = false;
+    if (token_is(name, name_len, "node")) {
+      finish_node();
+      node = {};
+      const char *id = NULL;
+      size_t id_len = 0;
+      p = xml_attributes(p, end, closed,
+                         [&](const char *attr, size_t attr_len,
+                             const char *value, size_t len) {
+                           if (token_is(attr, attr_len, "id")) {
+                             id = value;
+                             id_len = len;
+                           }
+                         });
+      if (p && id) {
+        node.slot = chunk.id(id, id_len);
+        in_node = !closed;
+      }
+    } else if (token_is(name, name_len, "edge")) {
+      const char *ends[2] = {NULL, NULL};
+      size_t lens[2] = {0, 0};
+      p = xml_attributes(p, end, closed,
+                         [&](const char *attr, size_t attr_len,
+                             const char *value, size_t len) {
+                           int k = token_is(attr, attr_len, "source") ? 0
+                                   : token_is(attr, attr_len, "target")
+                                       ? 1
+                                       : -1;
+                           if (k >= 0) {
+                             ends[k] = value;
+                             lens[k] = len;
+                           }
+                         });
+      if (p && ends[0] && ends[1]) {
+        chunk.edges.push_back(chunk.id(ends[0], lens[0]));
+        chunk.edges.push_back(chunk.id(ends[1], lens[1]));
+      } else {
+        p = NULL;
+      }
+    } else if (in_node && (token_is(name, name_len, "data") ||
+                           ends_with(name, name_len, "NodeLabel"))) {
+      int field = token_is(name, name_len, "data") ? -1 : GRAPHML_LABEL;
+      p = xml_attributes(p, end, closed,
+                         [&](const char *attr, size_t attr_len,
+                             const char *value, size_t len) {
+                           if (!token_is(attr, attr_len, "key"))
+                             return;
+                           for (const GraphmlKey &key : keys)
+                             if (token_is(value, len, key.id.c_str()))
+                               field = key.field;
+                         });
+      if (p && !closed && field >= 0) {
+        const char *text_end = (const char *)memchr(p, '<', end - p);
+        if (text_end)
+          apply_graphml_field(node, (GraphmlField)field, p, text_end - p);
+      }
+    } else if (in_node && ends_with(name, name_len, "Geometry")) {
+      // Geometry gives the top-left corner.
+      NodeRecord geometry = {};
+      p = xml_attributes(p, end, closed,
+                         [&](const char *attr, size_t attr_len,
+                             const char *value, size_t len) {
+                           static const char *names[] = {"x", "y", "width",
+                                                         "height"};
+                           for (int f = 0; f < 4; ++f)
+                             if (token_is(attr, attr_len, names[f]))
+                               apply_graphml_field(geometry, (GraphmlField)f,
+                                                   value, len);
+                         });
+      Uint32 all = NODE_X | NODE_Y | NODE_WIDTH | NODE_HEIGHT;
+      if (p && (geometry.fields & all) == all) {
+        node.x = geometry.x + geometry.width / 2.0f;
+        node.y = geometry.y + geometry.height / 2.0f;
+        node.width = geometry.width;
+        node.height = geometry.height;
+        node.fields |= all;
+      }
+    } else {
+      p = xml_attributes(p, end, closed,
+                         [](const char *, size_t, const char *, size_t) {});
+    }
+    if (!p) {
+      chunk.error = tag;
+      return;
+    }
+  }
+  finish_node();
+}
+
+// Chunking
+
+// First record boundary at or after p in an edge list or GraphML file.
+static const char *next_boundary(const char *p, const char *end,
+                                 ImportFormat format) {
+  if (format == IMPORT_GRAPHML) {
+    while (p < end && (p = (const char *)memchr(p, '<', end - p)) != NULL) {
+      if (starts_tag(p, end, "node") || starts_tag(p, end, "edge"))
+        return p;
+      ++p;
+    }
+    return end;
+  }
+  p = (const char *)memchr(p, '\n', end - p);
+  return p ? p + 1 : end;
+}
+
+enum DotScanState {
+  DOT_SCAN_CODE,
+  DOT_SCAN_STRING,
+  DOT_SCAN_LINE_COMMENT,
+  DOT_SCAN_BLOCK_COMMENT,
+  DOT_SCAN_HTML,
+};
+
+// Finds DOT chunk boundaries. Semicolons are optional, so any newline may
+// end a statement unless it is inside a string, comment, HTML id or
+// attribute list, or the statement goes on past it, as after "a ->" or
+// before "[color=red]". Whether a newline is inside a string depends on
+// everything before it, so the scanner walks the file once, in order,
+// carrying its state from one boundary to the next.
+struct DotScanner {
+  const char *p;
+  DotScanState state = DOT_SCAN_CODE;
+  int html_depth = 0, bracket_depth = 0;
+  bool line_start = true;
+  char last = 0; // last character of code, a quoted id being '"'
+  const char *word = nullptr, *word_end = nullptr; // last unquoted id
+
+  // First newline at or after at that may end a statement, plus one.
+  const char *next_boundary(const char *at, const char *end);
+
+private:
+  bool may_end_statement(const char *end) const;
+};
+
+// With p at a newline in code, whether the statement may end there.
+bool DotScanner::may_end_statement(const char *end) const {
+  if (bracket_depth > 0 || (last && strchr("-=,+:>{", last)))
+    return false;
+  // A graph's name or opening brace may follow on the next line.
+  if (is_dot_id_char(last)) {
+    for (const char *keyword : {"graph", "digraph", "subgraph"}) {
+      size_t len = word_end - word;
+      if (strlen(keyword) == len && SDL_strncasecmp(word, keyword, len) == 0)
+        return false;
+    }
+  }
+  const char *q = p + 1;
+  while (q < end && is_space(*q))
+    ++q;
+  if (q == end)
+    return true;
+  if (*q == '-' && q + 1 < end && (q[1] == '>' || q[1] == '-'))
+    return false;
+  // A comment could hide a continuation; the next newline will do.
+  return !strchr("[=,+:/#", *q);
+}
+
+const char *DotScanner::next_boundary(const char *at, const char *end) {
+  for (; p < end; ++p) {
+    char c = *p;
+    switch (state) {
+    case DOT_SCAN_STRING:
+      if (c == '\\' && p + 1 < end)
+        ++p;
+      else if (c == '"')
+        state = DOT_SCAN_CODE, last = '"';
+      continue;
+    case DOT_SCAN_LINE_COMMENT:
+      if (c != '\n')
+        continue;
+      state = DOT_SCAN_CODE;
+      break;
+    case DOT_SCAN_BLOCK_COMMENT:
+      if (c == '*' && p + 1 < end && p[1] == '/')
+        ++p, state = DOT_SCAN_CODE;
+      continue;
+    case DOT_SCAN_HTML:
+      html_depth += c == '<' ? 1 : (c == '>' ? -1 : 0);
+      if (html_depth == 0)
+        state = DOT_SCAN_CODE, last = '"';
+      continue;
+    case DOT_SCAN_CODE:
+      break;
+    }
+    if (c == '\n') {
+      line_start = true;
+      if (p >= at && may_end_statement(end))
+        return ++p;
+      continue;
+    }
+    if (c == ' ' || c == '\t' || c == '\r')
+      continue;
+    if ((c == '#' && line_start) ||
+        (c == '/' && p + 1 < end && p[1] == '/')) {
+      state = DOT_SCAN_LINE_COMMENT;
+    } else if (c == '/' && p + 1 < end && p[1] == '*') {
+      ++p;
+      state = DOT_SCAN_BLOCK_COMMENT;
+    } else if (c == '"') {
+      state = DOT_SCAN_STRING;
+    } else if (c == '<') {
+      state = DOT_SCAN_HTML;
+      html_depth = 1;
+    } else {
+      if (c == '[')
+        ++bracket_depth;
+      else if (c == ']' && bracket_depth > 0)
+        --bracket_depth;
+      if (is_dot_id_char(c)) {
+        if (word_end != p)
+          word = p;
+        word_end = p + 1;
+      }
+      last = c;
+    }
+    line_start = false;
+  }
+  return end;
+}
+
+// Id resolution
+
+// Open addressing table of one partition's distinct ids.
+struct IdTable {
+  std::vector<Uint64> slots; // (hash << 32) | (local + 1), 0 when empty
+  std::vector<const char *> text; // by local index
+  std::vector<Uint32> len, hash;
+
+  Uint32 find_or_add(const char *p, Uint32 p_len, Uint32 p_hash) {
+    if ((text.size() + 1) * 2 > slots.size())
+      grow();
+    size_t mask = slots.size() - 1;
+    for (size_t i = p_hash & mask;; i = (i + 1) & mask) {
+      Uint64 s = slots[i];
+      if (s == 0) {
+        Uint32 local = (Uint32)text.size();
+        slots[i] = ((Uint64)p_hash << 32) | (local + 1);
+        text.push_back(p);
+        len.push_back(p_len);
+        hash.push_back(p_hash);
+        return local;
+      }
+      Uint32 local = (Uint32)s - 1;
+      if ((Uint32)(s >> 32) == p_hash && len[local] == p_len &&
+          memcmp(text[local], p, p_len) == 0)
+        return local;
+    }
+  }
+
+  void grow() {
+    slots.assign(slots.empty() ? 1024 : slots.size() * 2, 0);
+    size_t mask = slots.size() - 1;
+    for (Uint32 local = 0; local < text.size(); ++local) {
+      size_t i = hash[local] & mask;
+      while (slots[i] != 0)
+        i = (i + 1) & mask;
+      slots[i] = ((Uint64)hash[local] << 32) | (local + 1);
+    }
+  }
+};
+
+ImportFormat import_format(const char *path) {
+  static const struct {
+    const char *ext;
+    ImportFormat format;
+  } formats[] = {{".txt", IMPORT_EDGE_LIST},   {".edges", IMPORT_EDGE_LIST},
+                 {".el", IMPORT_EDGE_LIST},    {".edgelist", IMPORT_EDGE_LIST},
+                 {".csv", IMPORT_CSV},         {".tsv", IMPORT_CSV},
+                 {".dot", IMPORT_DOT},         {".gv", IMPORT_DOT},
+                 {".graphml", IMPORT_GRAPHML}};
+  size_t len = strlen(path);
+  for (const auto &f : formats) {
+    size_t ext_len = strlen(f.ext);
+    if (len >= ext_len && SDL_strcasecmp(path + len - ext_len, f.ext) == 0)
+      return f.format;
+  }
+  return IMPORT_UNKNOWN;
+}
+
+const char *import_stage_name(int stage) {
+  static const char *names[] = {"parse", "resolve", "edges", "done"};
+  return stage >= 0 && stage <= IMPORT_STAGE_DONE ? names[stage] : "?";
+}
+
+bool import_graph(const char *path, ImportFormat format, ImportedGraph &out,
+                  ImportProgress &progress) {
+  MappedFile file;
+  if (format == IMPORT_UNKNOWN || !file.open(path))
+    return false;
+  const char *data = (const char *)file.data;
+  const char *end = data + file.size;
+  progress.bytes_total = file.size;
+  progress.bytes_parsed.store(0);
+  progress.stage.store(IMPORT_STAGE_PARSE);
+
+  std::vector<GraphmlKey> keys;
+  if (format == IMPORT_GRAPHML)
+    parse_graphml_keys(data, next_boundary(data, end, format), keys);
+
+  DotScanner dot;
+  dot.p = data;
+  std::vector<const char *> bounds(1, data);
+  while (bounds.back() < end) {
+    const char *at = bounds.back(), *next = end;
+    if ((size_t)(end - at) > IMPORT_CHUNK_BYTES) {
+      next = format == IMPORT_DOT
+                 ? dot.next_boundary(at + IMPORT_CHUNK_BYTES, end)
+                 : next_boundary(at + IMPORT_CHUNK_BYTES, end, format);
+    }
+    // IdRef offsets are 32-bit.
+    if ((Uint64)(next - at) > 0xFFFFFFFFull) {
+      fprintf(stderr, "%s: no record boundary in the 4 GiB after byte %llu\n",
+              path, (unsigned long long)(at - data));
+      return false;
+    }
+    bounds.push_back(next);
+  }
+  std::vector<Chunk> chunks(bounds.size() - 1);
+  for (size_t c = 0; c < chunks.size(); ++c) {
+    chunks[c].begin = bounds[c];
+    chunks[c].end = bounds[c + 1];
+  }
+
+  // Chunks are handed out one at a time, so a slow one does not hold up
+  // the threads that finished theirs.
+  std::atomic<size_t> next_chunk{0};
+  parallel_for((size_t)worker_count(), 1, [&](size_t, size_t) {
+    for (size_t c; (c = next_chunk.fetch_add(1)) < chunks.size();) {
+      Chunk &chunk = chunks[c];
+      if (format == IMPORT_DOT)
+        parse_dot(chunk, data);
+      else if (format == IMPORT_GRAPHML)
+        parse_graphml(chunk, keys);
+      else
+        parse_edge_list(chunk, format == IMPORT_CSV && c == 0);
+      progress.bytes_parsed.fetch_add(chunk.end - chunk.begin);
+    }
+  });
+  for (const Chunk &chunk : chunks) {
+    if (chunk.error) {
+      log("Parse error in %s at byte %llu\n", path,
+          (unsigned long long)(chunk.error - data));
+      return false;
+    }
+  }
+
+  // Each partition numbers its ids in order of first appearance.
+  progress.stage.store(IMPORT_STAGE_RESOLVE);
+  std::vector<IdTable> tables(IMPORT_PARTITIONS);
+  parallel_for(IMPORT_PARTITIONS, 1, [&](size_t begin, size_t stop) {
+    for (size_t part = begin; part < stop; ++part) {
+      IdTable &table = tables[part];
+      for (Chunk &chunk : chunks)
+        for (const IdRef &ref : chunk.refs[part])
+          chunk.ids[ref.slot] = table.find_or_add(chunk.begin + ref.offset,
+                                                  ref.len, ref.hash);
+    }
+  });
+  std::vector<size_t> base(IMPORT_PARTITIONS + 1, 0);
+  for (int part = 0; part < IMPORT_PARTITIONS; ++part)
+    base[part + 1] = base[part] + tables[part].text.size();
+  size_t n = base[IMPORT_PARTITIONS];
+  if (n > (size_t)INT_MAX) {
+    log("%s has %zu nodes, more than supported\n", path, n);
+    return false;
+  }
+  parallel_for(chunks.size(), 1, [&](size_t begin, size_t stop) {
+    for (size_t c = begin; c < stop; ++c) {
+      for (int part = 0; part < IMPORT_PARTITIONS; ++part) {
+        for (const IdRef &ref : chunks[c].refs[part])
+          chunks[c].ids[ref.slot] += (Uint32)base[part];
+        std::vector<IdRef>().swap(chunks[c].refs[part]);
+      }
+    }
+  });
+
+  NodeStore &nodes = out.nodes;
+  nodes.resize(n);
+  parallel_for(IMPORT_PARTITIONS, 1, [&](size_t begin, size_t stop) {
+    for (size_t part = begin; part < stop; ++part) {
+      const IdTable &table = tables[part];
+      for (size_t local = 0; local < table.text.size(); ++local) {
+        size_t i = base[part] + local;
+        Uint32 value;
+        nodes.data[i] = parse_uint(table.text[local], table.len[local], value)
+                            ? value
+                            : (Uint32)i;
+        nodes.x[i] = nodes.y[i] = 0.0f;
+        nodes.width[i] = nodes.height[i] =
+            DEFAULT_NODE_SIZE - 2.0f * DEFAULT_BORDER;
+        nodes.border_thickness[i] = DEFAULT_BORDER;
+        nodes.color[i] = pack_rgba(255, 255, 255, 255);
+      }
+    }
+  });
+  tables.clear();
+
+  // Declarations apply in file order, so a later one wins.
+  out.has_coordinates = false;
+  for (const Chunk &chunk : chunks) {
+    for (const NodeRecord &record : chunk.nodes) {
+      Uint32 i = chunk.ids[record.slot];
+      if ((record.fields & (NODE_X | NODE_Y)) == (NODE_X | NODE_Y)) {
+        nodes.x[i] = record.x;
+        nodes.y[i] = record.y;
+        out.has_coordinates = true;
+      }
+      if (record.fields & NODE_WIDTH)
+        nodes.width[i] = record.width - 2.0f * DEFAULT_BORDER;
+      if (record.fields & NODE_HEIGHT)
+        nodes.height[i] = record.height - 2.0f * DEFAULT_BORDER;
+      if (record.fields & NODE_LABEL)
+        nodes.data[i] = record.label;
+    }
+  }
+
+  progress.stage.store(IMPORT_STAGE_EDGES);
+  std::vector<Uint64> first_edge(chunks.size() + 1, 0);
+  for (size_t c = 0; c < chunks.size(); ++c)
+    first_edge[c + 1] = first_edge[c] + chunks[c].edges.size() / 2;
+  Uint64 edge_count = first_edge[chunks.size()];
+  std::vector<Uint32> sources(edge_count), targets(edge_count);
+  parallel_for(chunks.size(), 1, [&](size_t begin, size_t stop) {
+    for (size_t c = begin; c < stop; ++c) {
+      const Chunk &chunk = chunks[c];
+      Uint64 e = first_edge[c];
+      for (size_t k = 0; k < chunk.edges.size(); k += 2, ++e) {
+        sources[e] = chunk.ids[chunk.edges[k]];
+        targets[e] = chunk.ids[chunk.edges[k + 1]];
+      }
+    }
+  });
+  chunks.clear();
+  out.csr.assign((int)n, sources.data(), targets.data(), edge_count);
+
+  progress.stage.store(IMPORT_STAGE_DONE);
+  log("Imported %s: %zu nodes, %llu edges\n", path, n,
+      (unsigned long long)edge_count);
+  return true;
+}
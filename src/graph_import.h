@@ -0,0 +1,56 @@
+#pragma once
+
+#include <SDL3/SDL_stdinc.h>
+#include <atomic>
+
+#include "edges.h"
+#include "node.h"
+
+// Parallel readers for the text formats large graphs are usually exported
+// in: edge lists (and CSV), DOT and GraphML.
+//
+// The file is mapped and split into chunks at record boundaries: lines for
+// edge lists, newlines between statements for DOT, <node> and <edge>
+// elements for GraphML. Chunks are parsed on all cores into chunk-local
+// lists of node ids, edges and node attributes. Ids are then resolved to
+// node indices by hash, one partition of the hash space per thread, and the
+// edges are merged into a CSR adjacency. Nodes are numbered by hash
+// partition, in order of first appearance within one.
+//
+// A node's data value is its label if that is a number, else its id if that
+// is one, else its index.
+
+enum ImportFormat {
+  IMPORT_UNKNOWN,
+  IMPORT_EDGE_LIST, // .txt .edges .el: "source target [...]" per line
+  IMPORT_CSV,       // .csv .tsv: the same with an optional header line
+  IMPORT_DOT,       // .dot .gv
+  IMPORT_GRAPHML,   // .graphml
+};
+
+enum ImportStage {
+  IMPORT_STAGE_PARSE,
+  IMPORT_STAGE_RESOLVE,
+  IMPORT_STAGE_EDGES,
+  IMPORT_STAGE_DONE,
+};
+
+// Written by the import, read by whoever reports on it.
+struct ImportProgress {
+  Uint64 bytes_total = 0;
+  std::atomic<Uint64> bytes_parsed{0};
+  std::atomic<int> stage{IMPORT_STAGE_PARSE};
+};
+
+struct ImportedGraph {
+  NodeStore nodes;
+  EdgeCSR csr;
+  bool has_coordinates = false; // any node had a position
+};
+
+// Format by file extension; IMPORT_UNKNOWN if none of the above.
+ImportFormat import_format(const char *path);
+const char *import_stage_name(int stage);
+
+bool import_graph(const char *path, ImportFormat format, ImportedGraph &out,
+                  ImportProgress &progress);
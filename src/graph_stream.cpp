@@ -0,0 +1,265 @@
+#include "graph_stream.h"
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "debug.h"
+
+// Added nodes look like the smallest generated ones.
+static constexpr float NODE_SIZE = 20.0f;
+static constexpr float NODE_BORDER = 2.0f;
+
+size_t UpdateRing::push(const GraphUpdate *updates, size_t count) {
+  size_t t = tail.load(std::memory_order_relaxed);
+  size_t room = CAPACITY - (t - head.load(std::memory_order_acquire));
+  size_t n = count < room ? count : room;
+  for (size_t k = 0; k < n; ++k)
+    slots[(t + k) & (CAPACITY - 1)] = updates[k];
+  tail.store(t + n, std::memory_order_release);
+  return n;
+}
+
+size_t UpdateRing::pop(GraphUpdate *out, size_t max) {
+  size_t h = head.load(std::memory_order_relaxed);
+  size_t ready = tail.load(std::memory_order_acquire) - h;
+  size_t n = ready < max ? ready : max;
+  for (size_t k = 0; k < n; ++k)
+    out[k] = slots[(h + k) & (CAPACITY - 1)];
+  head.store(h + n, std::memory_order_release);
+  return n;
+}
+
+static bool parse_index(const char *&p, Uint32 &value) {
+  char *end;
+  unsigned long v = strtoul(p, &end, 10);
+  if (end == p || v > 0xFFFFFFFFul)
+    return false;
+  value = (Uint32)v;
+  p = end;
+  return true;
+}
+
+// strtof() also reads nan and inf, which no node can be placed at.
+static bool parse_float(const char *&p, float &value) {
+  char *end;
+  value = strtof(p, &end);
+  if (end == p || !isfinite(value))
+    return false;
+  p = end;
+  return true;
+}
+
+// RRGGBB or RRGGBBAA.
+static bool parse_color(const char *&p, Uint32 &rgba) {
+  while (*p == ' ' || *p == '\t')
+    p++;
+  char *end;
+  unsigned long v = strtoul(p, &end, 16);
+  int digits = (int)(end - p);
+  if (digits != 6 && digits != 8)
+    return false;
+  if (digits == 6)
+    v = (v << 8) | 0xFF;
+  rgba = pack_rgba((Uint8)(v >> 24), (Uint8)(v >> 16), (Uint8)(v >> 8),
+                   (Uint8)v);
+  p = end;
+  return true;
+}
+
+static bool at_end(const char *p) {
+  while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+    p++;
+  return *p == '\0';
+}
+
+static bool parse_update(const char *line, GraphUpdate &u) {
+  const char *p = line + 1;
+  u = {};
+  switch (line[0]) {
+  case 'n':
+    u.kind = UPDATE_ADD_NODE;
+    u.color = pack_rgba(255, 255, 255, 255);
+    if (!parse_float(p, u.x) || !parse_float(p, u.y))
+      return false;
+    if (!at_end(p) && !parse_color(p, u.color))
+      return false;
+    if (!at_end(p)) {
+      if (!parse_index(p, u.data))
+        return false;
+      u.has_data = true;
+    }
+    break;
+  case 'd':
+    u.kind = UPDATE_REMOVE_NODE;
+    if (!parse_index(p, u.node))
+      return false;
+    break;
+  case 'm':
+    u.kind = UPDATE_MOVE_NODE;
+    if (!parse_index(p, u.node) || !parse_float(p, u.x) ||
+        !parse_float(p, u.y))
+      return false;
+    break;
+  case 'c':
+    u.kind = UPDATE_COLOR_NODE;
+    if (!parse_index(p, u.node) || !parse_color(p, u.color))
+      return false;
+    break;
+  case 'e':
+  case 'x':
+    u.kind = line[0] == 'e' ? UPDATE_ADD_EDGE : UPDATE_REMOVE_EDGE;
+    if (!parse_index(p, u.node) || !parse_index(p, u.other))
+      return false;
+    break;
+  default:
+    return false;
+  }
+  return at_end(p);
+}
+
+// Hands u to the ring, waiting while it is full. Returns false if the
+// stream was closed meanwhile.
+static bool hand_over(GraphStream::Feed &feed, const GraphUpdate &u) {
+  while (feed.ring.push(&u, 1) == 0) {
+    if (feed.stop_requested.load())
+      return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+static void read_updates(std::shared_ptr<GraphStream::Feed> feed,
+                         std::string path) {
+  bool is_stdin = path == "-";
+  FILE *f = is_stdin ? stdin : fopen(path.c_str(), "r");
+  if (!f) {
+    fprintf(stderr, "Failed to open update stream %s\n", path.c_str());
+    feed->finished.store(true);
+    return;
+  }
+  log("Reading updates from %s\n", is_stdin ? "stdin" : path.c_str());
+
+  // Each update is passed on as soon as it is parsed, so updates
+  // trickling in are not held back; a push is two atomic operations.
+  char line[256];
+  while (!feed->stop_requested.load() && fgets(line, sizeof(line), f)) {
+    size_t len = strlen(line);
+    bool whole = len > 0 && line[len - 1] == '\n';
+    if (!whole && !feof(f)) {
+      // Too long to be an update; skip the rest of it.
+      int c;
+      while ((c = fgetc(f)) != EOF && c != '\n') {
+      }
+      feed->lines++;
+      feed->rejected++;
+      continue;
+    }
+    feed->lines++;
+    if (line[0] == '#' || at_end(line))
+      continue;
+    GraphUpdate u;
+    if (!parse_update(line, u))
+      feed->rejected++;
+    else if (!hand_over(*feed, u))
+      break;
+  }
+  if (!is_stdin)
+    fclose(f);
+  log("Update stream ended: %llu lines, %llu rejected\n",
+      (unsigned long long)feed->lines.load(),
+      (unsigned long long)feed->rejected.load());
+  feed->finished.store(true);
+}
+
+void GraphStream::open(const char *path) {
+  close();
+  feed = std::make_shared<Feed>();
+  thread = std::thread(read_updates, feed, std::string(path));
+}
+
+void GraphStream::close() {
+  if (!feed)
+    return;
+  feed->stop_requested.store(true);
+  if (feed->finished.load())
+    thread.join();
+  else
+    thread.detach();
+  feed.reset();
+}
+
+void apply_updates(const GraphUpdate *updates, size_t count,
+                   NodeStore &nodes, SpatialIndex &index, EdgeLayer &edges,
+                   UpdateStats &stats, DensityPyramid *pyramid) {
+  // Hidden nodes are not in the pyramid's counts.
+  auto count_node = [&](int i, int weight) {
+    if (pyramid && !nodes.hidden.contains(i))
+      pyramid->add(nodes.x[i], nodes.y[i], nodes.color[i], weight);
+  };
+  for (size_t k = 0; k < count; ++k) {
+    const GraphUpdate &u = updates[k];
+    if (u.kind == UPDATE_ADD_NODE) {
+      size_t i = nodes.size();
+      nodes.append(u.x, u.y, NODE_SIZE, NODE_SIZE, NODE_BORDER, u.color,
+                   u.has_data ? u.data : (Uint32)i);
+      index.insert((int)i);
+      count_node((int)i, 1);
+      if (stats.track_changes)
+        stats.placed.push_back((int)i);
+      stats.nodes_added++;
+      stats.applied++;
+      continue;
+    }
+    int i = (int)u.node;
+    bool known = u.node < nodes.size() && !nodes.removed.contains(i);
+    if (u.kind == UPDATE_ADD_EDGE || u.kind == UPDATE_REMOVE_EDGE)
+      known = known && u.other < nodes.size() &&
+              !nodes.removed.contains((int)u.other);
+    if (!known) {
+      log_once("Dropping updates that name unknown or removed nodes\n");
+      stats.dropped++;
+      continue;
+    }
+    switch (u.kind) {
+    case UPDATE_REMOVE_NODE:
+      count_node(i, -1);
+      nodes.selection.remove(i);
+      nodes.hidden.add(i);
+      nodes.removed.add(i);
+      stats.nodes_removed++;
+      break;
+    case UPDATE_MOVE_NODE:
+      count_node(i, -1);
+      nodes.x[i] = u.x;
+      nodes.y[i] = u.y;
+      count_node(i, 1);
+      index.update(i);
+      edges.node_moved(i);
+      if (stats.track_changes)
+        stats.moved.push_back(i);
+      break;
+    case UPDATE_COLOR_NODE:
+      count_node(i, -1);
+      nodes.color[i] = u.color;
+      count_node(i, 1);
+      break;
+    case UPDATE_ADD_EDGE:
+      edges.add_edge(u.node, u.other);
+      if (stats.track_changes) {
+        stats.placed.push_back(i);
+        stats.placed.push_back((int)u.other);
+      }
+      break;
+    case UPDATE_REMOVE_EDGE:
+      edges.remove_edge(u.node, u.other);
+      break;
+    default:
+      break;
+    }
+    stats.applied++;
+  }
+}
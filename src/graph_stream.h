@@ -0,0 +1,120 @@
+#pragma once
+
+#include <SDL3/SDL_stdinc.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "density_pyramid.h"
+#include "edges.h"
+#include "node.h"
+#include "spatial_index.h"
+
+// Live graph updates read from a file or pipe ("-" for stdin), one per
+// line:
+//
+//   n X Y [RRGGBB[AA] [DATA]]  adds a node, which gets the next index
+//   d NODE                     removes a node
+//   m NODE X Y                 moves a node
+//   c NODE RRGGBB[AA]          recolors a node
+//   e SOURCE TARGET            adds an edge
+//   x SOURCE TARGET            removes an edge, every copy of it
+//
+// Nodes are addressed by index, and a removed node keeps its index. Blank
+// lines and lines starting with '#' are skipped; malformed ones are
+// counted and dropped.
+//
+// A reader thread parses lines into GraphUpdates and hands them to the
+// main thread through a single-producer single-consumer ring, so neither
+// side ever takes a lock; a full ring makes the reader wait. The main
+// thread drains the ring in batches between frames.
+
+enum UpdateKind : Uint8 {
+  UPDATE_ADD_NODE,
+  UPDATE_REMOVE_NODE,
+  UPDATE_MOVE_NODE,
+  UPDATE_COLOR_NODE,
+  UPDATE_ADD_EDGE,
+  UPDATE_REMOVE_EDGE,
+};
+
+struct GraphUpdate {
+  UpdateKind kind;
+  bool has_data; // UPDATE_ADD_NODE: data is given, else it is the index
+  Uint32 node;   // or an edge's source
+  Uint32 other;  // an edge's target
+  float x, y;
+  Uint32 color; // pack_rgba()
+  Uint32 data;
+};
+
+// Lock-free ring between one producer and one consumer. Each side owns one
+// counter and only reads the other's, on its own cache line.
+struct UpdateRing {
+  static constexpr size_t CAPACITY = 1 << 18; // a power of two
+
+  std::vector<GraphUpdate> slots = std::vector<GraphUpdate>(CAPACITY);
+  alignas(64) std::atomic<size_t> head{0}; // next to read
+  alignas(64) std::atomic<size_t> tail{0}; // next to write
+
+  // Producer side; returns how many of the count updates fit.
+  size_t push(const GraphUpdate *updates, size_t count);
+  // Consumer side; returns how many updates were copied to out.
+  size_t pop(GraphUpdate *out, size_t max);
+};
+
+struct GraphStream {
+  // Shared with the reader thread, which may outlive the stream while it
+  // is blocked on input nobody writes to any more.
+  struct Feed {
+    UpdateRing ring;
+    std::atomic<bool> stop_requested{false};
+    std::atomic<bool> finished{false};
+    std::atomic<Uint64> lines{0};
+    std::atomic<Uint64> rejected{0};
+  };
+
+  std::shared_ptr<Feed> feed;
+  std::thread thread;
+
+  GraphStream() = default;
+  GraphStream(const GraphStream &) = delete;
+  GraphStream &operator=(const GraphStream &) = delete;
+  ~GraphStream() { close(); }
+
+  // Starts reading path on a background thread. The file is opened there,
+  // so a FIFO without a writer yet does not hold up the caller.
+  void open(const char *path);
+  // Stops the reader. One still blocked on input is left to exit at its
+  // next line.
+  void close();
+  bool active() const { return feed != nullptr; }
+  // The input has ended and every update in it was polled.
+  bool drained() const {
+    return feed && feed->finished.load() &&
+           feed->ring.head.load() == feed->ring.tail.load();
+  }
+  size_t poll(GraphUpdate *out, size_t max) {
+    return feed ? feed->ring.pop(out, max) : 0;
+  }
+};
+
+struct UpdateStats {
+  Uint64 applied = 0;
+  Uint64 dropped = 0; // naming unknown or removed nodes
+  Uint64 nodes_added = 0;
+  Uint64 nodes_removed = 0;
+  // With track_changes set, added nodes and the ends of added edges are
+  // appended to placed, moved nodes to moved, for relayout_incremental().
+  bool track_changes = false;
+  std::vector<int> placed, moved;
+};
+
+// Applies updates in order. The spatial index is updated along one leaf to
+// root path per node moved or added, and the edge layer keeps edits as
+// pending lists until its next rebuild(). A pyramid, if given, has each
+// changed node counted out and back in with DensityPyramid::add().
+void apply_updates(const GraphUpdate *updates, size_t count,
+                   NodeStore &nodes, SpatialIndex &index, EdgeLayer &edges,
+                   UpdateStats &stats, DensityPyramid *pyramid = NULL);
@@ -0,0 +1,262 @@
+#include "incremental_layout.h"
+
+#include <SDL3/SDL_timer.h>
+#include <algorithm>
+#include <math.h>
+#include <unordered_map>
+#include <utility>
+
+#include "debug.h"
+
+// Marks anchors in the slot map; they are pinned but not context yet.
+static constexpr int ANCHOR = -1;
+
+// Nodes by the grid cell holding their center, sorted so the three cells
+// of one row around a point are one contiguous run.
+struct CellGrid {
+  float cell = 1.0f;
+  std::vector<std::pair<Uint64, int>> entries;
+
+  static Uint64 key(int cx, int cy) {
+    return ((Uint64)(Uint32)(cy + 0x40000000) << 32) |
+           (Uint32)(cx + 0x40000000);
+  }
+  int cell_of(float v) const { return (int)floorf(v / cell); }
+
+  void build(const float *xs, const float *ys, int first, int last) {
+    entries.clear();
+    for (int k = first; k < last; ++k)
+      entries.push_back({key(cell_of(xs[k]), cell_of(ys[k])), k});
+    std::sort(entries.begin(), entries.end());
+  }
+  // Calls fn(k) for every entry in the 3x3 cells around (x, y).
+  template <typename Fn> void around(float x, float y, Fn fn) const {
+    int cx = cell_of(x), cy = cell_of(y);
+    for (int dy = -1; dy <= 1; ++dy) {
+      auto it = std::lower_bound(entries.begin(), entries.end(),
+                                 std::make_pair(key(cx - 1, cy + dy), -1));
+      Uint64 last = key(cx + 1, cy + dy);
+      for (; it != entries.end() && it->first <= last; ++it)
+        fn(it->second);
+    }
+  }
+};
+
+IncrementalStats relayout_incremental(NodeStore &nodes,
+                                      const SpatialIndex &index,
+                                      EdgeLayer &edges,
+                                      const std::vector<int> &seeds,
+                                      const std::vector<int> &anchors,
+                                      const IncrementalOptions &options,
+                                      std::vector<int> &moved,
+                                      DensityPyramid *pyramid) {
+  Uint64 start = SDL_GetTicksNS();
+  IncrementalStats stats;
+  bool any_hidden = !nodes.hidden.empty();
+  auto usable = [&](int v) {
+    return v >= 0 && (size_t)v < nodes.size() &&
+           !(any_hidden && nodes.hidden.contains(v));
+  };
+
+  // Neighbours through the CSR both ways and through pending live edits.
+  edges.build_reverse();
+  const EdgeCSR &csr = edges.csr;
+  auto is_cut = [&](Uint32 s, Uint32 t) {
+    return !edges.cut.empty() && edges.cut.count(((Uint64)s << 32) | t);
+  };
+  std::vector<std::pair<Uint32, Uint32>> extra;
+  for (size_t p = 0; p < edges.added.size(); ++p) {
+    const EdgeRef &r = edges.added[p];
+    auto it = edges.cut.find(((Uint64)r.source << 32) | r.target);
+    if (it != edges.cut.end() && p < it->second)
+      continue;
+    extra.push_back({r.source, r.target});
+    extra.push_back({r.target, r.source});
+  }
+  std::sort(extra.begin(), extra.end());
+  auto for_neighbours = [&](int v, auto fn) {
+    if (v < csr.node_count) {
+      for (Uint64 e = csr.offsets[v]; e < csr.offsets[v + 1]; ++e)
+        if (!is_cut(v, csr.targets[e]))
+          fn((int)csr.targets[e]);
+      for (Uint64 e = edges.in_offsets[v]; e < edges.in_offsets[v + 1]; ++e)
+        if (!is_cut(edges.in_sources[e], v))
+          fn((int)edges.in_sources[e]);
+    }
+    auto it = std::lower_bound(extra.begin(), extra.end(),
+                               std::make_pair((Uint32)v, (Uint32)0));
+    for (; it != extra.end() && it->first == (Uint32)v; ++it)
+      fn((int)it->second);
+  };
+
+  // Breadth-first from the seeds and anchors, nearest hops first.
+  std::unordered_map<int, int> slot;
+  std::vector<int> freed, frontier, next;
+  auto try_free = [&](int v) {
+    if (!usable(v) || freed.size() >= options.max_free ||
+        !slot.emplace(v, (int)freed.size()).second)
+      return false;
+    freed.push_back(v);
+    return true;
+  };
+  for (int a : anchors)
+    if (usable(a) && slot.emplace(a, ANCHOR).second)
+      frontier.push_back(a);
+  for (int s : seeds)
+    if (try_free(s))
+      frontier.push_back(s);
+  for (int hop = 0; hop < options.hops && !frontier.empty(); ++hop) {
+    next.clear();
+    for (int v : frontier)
+      for_neighbours(v, [&](int u) {
+        if (try_free(u))
+          next.push_back(u);
+      });
+    frontier.swap(next);
+  }
+  int free_count = (int)freed.size();
+  if (free_count == 0)
+    return stats;
+
+  // Springs are as long as layout.cpp makes them for the engines that
+  // ignore node sizes: twice the average node.
+  auto radius = [&](int v) {
+    return SDL_max(nodes.width[v], nodes.height[v]) / 2.0f +
+           nodes.border_thickness[v];
+  };
+  float length = 0.0f;
+  for (int v : freed)
+    length += 4.0f * radius(v);
+  length /= (float)free_count;
+  float range = 2.0f * length;
+
+  // Local arrays: the freed nodes first, then the pinned ones near them.
+  // Edits may be spread over the whole graph, so each freed node looks
+  // around itself rather than all of them over their common bounds.
+  std::vector<int> local(freed);
+  std::vector<int> found;
+  for (int k = 0; k < free_count; ++k) {
+    Rect r = nodes.box(local[k]);
+    found.clear();
+    index.query({r.x1 - range, r.y1 - range, r.x2 + range, r.y2 + range},
+                found);
+    for (int v : found) {
+      auto it = slot.find(v);
+      if (it == slot.end() || it->second == ANCHOR) {
+        slot[v] = (int)local.size();
+        local.push_back(v);
+      }
+    }
+  }
+  size_t count = local.size();
+  std::vector<float> px(count), py(count), pr(count);
+  for (size_t k = 0; k < count; ++k) {
+    px[k] = nodes.x[local[k]];
+    py[k] = nodes.y[local[k]];
+    pr[k] = radius(local[k]);
+  }
+
+  // Springs of each freed node: to a freed slot, or to a fixed position.
+  struct Spring {
+    int other; // freed slot, or -1
+    float x, y, r;
+  };
+  std::vector<int> spring_begin(free_count + 1, 0);
+  std::vector<Spring> springs;
+  for (int k = 0; k < free_count; ++k) {
+    for_neighbours(local[k], [&](int u) {
+      if (!usable(u) || u == local[k])
+        return;
+      auto it = slot.find(u);
+      int other = it != slot.end() && it->second >= 0 &&
+                          it->second < free_count
+                      ? it->second
+                      : -1;
+      springs.push_back({other, nodes.x[u], nodes.y[u], radius(u)});
+    });
+    spring_begin[k + 1] = (int)springs.size();
+  }
+
+  CellGrid pinned, moving;
+  pinned.cell = moving.cell = range;
+  pinned.build(px.data(), py.data(), free_count, (int)count);
+  std::vector<float> fx(free_count), fy(free_count);
+  double budget_ns = options.budget_ms * 1e6;
+  int iteration = 0;
+  for (; iteration < options.iterations; ++iteration) {
+    if (iteration > 0 && (double)(SDL_GetTicksNS() - start) > budget_ns)
+      break;
+    float t = (float)iteration / (float)options.iterations;
+    float temperature = length * (0.5f - 0.48f * t);
+    moving.build(px.data(), py.data(), 0, free_count);
+    for (int k = 0; k < free_count; ++k) {
+      float ax = 0.0f, ay = 0.0f;
+      // Repulsion falls off with the gap between the node borders, so
+      // large nodes keep their distance.
+      auto repel = [&](int j) {
+        if (j == k)
+          return;
+        float dx = px[k] - px[j], dy = py[k] - py[j];
+        float d = sqrtf(dx * dx + dy * dy);
+        if (d < 1e-3f) {
+          // Coincident nodes split along a direction fixed by their slots.
+          float angle = (float)((k * 7919 + j * 104729) % 6283) / 1000.0f;
+          dx = cosf(angle);
+          dy = sinf(angle);
+          d = 1.0f;
+        }
+        if (d > range + pr[k] + pr[j])
+          return;
+        float gap = SDL_max(d - pr[k] - pr[j], 0.01f * length);
+        float f = length * length / gap / d;
+        ax += dx * f;
+        ay += dy * f;
+      };
+      moving.around(px[k], py[k], repel);
+      pinned.around(px[k], py[k], repel);
+      for (int s = spring_begin[k]; s < spring_begin[k + 1]; ++s) {
+        const Spring &spring = springs[s];
+        float ox = spring.other >= 0 ? px[spring.other] : spring.x;
+        float oy = spring.other >= 0 ? py[spring.other] : spring.y;
+        float dx = ox - px[k], dy = oy - py[k];
+        float d = sqrtf(dx * dx + dy * dy);
+        float gap = d - pr[k] - spring.r;
+        if (d < 1e-3f || gap <= 0.0f)
+          continue;
+        float f = gap * gap / length / d;
+        ax += dx * f;
+        ay += dy * f;
+      }
+      fx[k] = ax;
+      fy[k] = ay;
+    }
+    for (int k = 0; k < free_count; ++k) {
+      float f = sqrtf(fx[k] * fx[k] + fy[k] * fy[k]);
+      if (f > temperature) {
+        fx[k] *= temperature / f;
+        fy[k] *= temperature / f;
+      }
+      px[k] += fx[k];
+      py[k] += fy[k];
+    }
+  }
+
+  for (int k = 0; k < free_count; ++k) {
+    int v = local[k];
+    if (pyramid)
+      pyramid->add(nodes.x[v], nodes.y[v], nodes.color[v], -1);
+    nodes.x[v] = px[k];
+    nodes.y[v] = py[k];
+    if (pyramid)
+      pyramid->add(px[k], py[k], nodes.color[v], 1);
+    moved.push_back(v);
+  }
+  stats.freed = (size_t)free_count;
+  stats.context = count - free_count;
+  stats.iterations = iteration;
+  stats.ms = (double)(SDL_GetTicksNS() - start) / 1e6;
+  log("Incremental layout: %zu nodes freed, %zu pinned nearby, %d "
+      "iterations in %.1f ms\n",
+      stats.freed, stats.context, stats.iterations, stats.ms);
+  return stats;
+}
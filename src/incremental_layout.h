@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+
+#include "density_pyramid.h"
+#include "edges.h"
+#include "node.h"
+#include "spatial_index.h"
+
+// Warm-started relayout of the neighbourhood of a few changed nodes.
+//
+// A full layout runs an OGDF engine over every node, and after a small
+// edit most of that work re-derives positions that were already right.
+// This pass frees only the nodes within hops of the changed ones and keeps
+// every other node pinned. The freed nodes run a cooling force-directed
+// schedule from their current positions: springs along their edges,
+// pinned neighbours included, and repulsion between node borders from
+// every node nearby, freed or pinned, found through a grid of cells as
+// wide as the interaction range. OGDF's engines cannot pin nodes, so the
+// pass does not go through them.
+//
+// A run stops when the schedule ends or its time budget is spent,
+// whichever comes first. Positions are consistent after every iteration,
+// so a cut-short run is a less settled result, not a broken one.
+struct IncrementalOptions {
+  int hops = 2;
+  size_t max_free = 20000; // nodes freed at most, nearest hops first
+  int iterations = 100;    // length of the cooling schedule
+  double budget_ms = 8.0;
+};
+
+struct IncrementalStats {
+  size_t freed = 0;
+  size_t context = 0; // pinned nodes the freed ones were pushed against
+  int iterations = 0;
+  double ms = 0.0;
+};
+
+// Frees seeds and their neighbourhood. anchors free their neighbourhood
+// but keep their own position, for nodes placed on purpose. Hidden nodes
+// are left alone. New positions are written to nodes and the freed nodes
+// appended to moved; the caller updates the index and edges for them. A
+// pyramid, if given, has them counted out and back in with
+// DensityPyramid::add(). edges may hold pending live edits, which count as
+// edges.
+IncrementalStats relayout_incremental(NodeStore &nodes,
+                                      const SpatialIndex &index,
+                                      EdgeLayer &edges,
+                                      const std::vector<int> &seeds,
+                                      const std::vector<int> &anchors,
+                                      const IncrementalOptions &options,
+                                      std::vector<int> &moved,
+                                      DensityPyramid *pyramid = NULL);
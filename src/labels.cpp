@@ -0,0 +1,105 @@
+#include "labels.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+#include "debug.h"
+
+static const char *label_text(const NodeStore &nodes, int i, char *buf,
+                              size_t size) {
+  snprintf(buf, size, "%u", nodes.data[i]);
+  return buf;
+}
+
+void LabelLayer::place(const SDL_Surface *surface, const NodeStore &nodes,
+                       const std::vector<int> &visible, float pan_x,
+                       float pan_y, float zoom, GlyphAtlas &atlas) {
+  placed.clear();
+  if (zoom < MIN_ZOOM)
+    return;
+
+  // Priority does not depend on the view, so labels do not jump between
+  // nodes while panning. Ties go to the lower index.
+  order.assign(visible.begin(), visible.end());
+  std::sort(order.begin(), order.end(), [&](int a, int b) {
+    float area_a = nodes.width[a] * nodes.height[a];
+    float area_b = nodes.width[b] * nodes.height[b];
+    return area_a != area_b ? area_a > area_b : a < b;
+  });
+
+  grid_w = (surface->w + CELL - 1) / CELL;
+  grid_h = (surface->h + CELL - 1) / CELL;
+  occupied.assign((size_t)grid_w * grid_h, 0);
+
+  char buf[16];
+  int tries = 0;
+  for (int i : order) {
+    float cx = (nodes.x[i] + pan_x) * zoom;
+    float cy = (nodes.y[i] + pan_y) * zoom;
+    float border = nodes.border_thickness[i] * zoom;
+    float inner_w = nodes.width[i] * zoom - 2.0f * border;
+    float inner_h = nodes.height[i] * zoom - 2.0f * border;
+    if (inner_w < TEXT_PX || inner_h < TEXT_PX)
+      continue;
+    // A label is centered on its node, so a taken center cell rules it out.
+    if (!(cx >= 0.0f && cy >= 0.0f && cx < surface->w && cy < surface->h))
+      continue;
+    if (occupied[(size_t)((int)cy / CELL) * grid_w + (int)cx / CELL])
+      continue;
+    if (++tries > MAX_TRIES)
+      break;
+
+    const GlyphAtlas::TextRun &run =
+        atlas.layout(label_text(nodes, i, buf, sizeof(buf)), TEXT_PX);
+    int text_h = run.ascent - run.descent;
+    if (run.width > inner_w || text_h > inner_h)
+      continue;
+
+    int x = (int)SDL_floorf(cx - run.width / 2.0f);
+    int top = (int)SDL_floorf(cy - text_h / 2.0f);
+    SDL_Rect rect = {x, top, run.width, text_h};
+    int x1 = SDL_max((rect.x - MARGIN) / CELL, 0);
+    int y1 = SDL_max((rect.y - MARGIN) / CELL, 0);
+    int x2 = SDL_min((rect.x + rect.w + MARGIN) / CELL, grid_w - 1);
+    int y2 = SDL_min((rect.y + rect.h + MARGIN) / CELL, grid_h - 1);
+    if (x1 > x2 || y1 > y2)
+      continue; // off screen
+
+    bool free_cells = true;
+    for (int gy = y1; gy <= y2 && free_cells; ++gy)
+      for (int gx = x1; gx <= x2 && free_cells; ++gx)
+        free_cells = !occupied[(size_t)gy * grid_w + gx];
+    if (!free_cells)
+      continue;
+    for (int gy = y1; gy <= y2; ++gy)
+      for (int gx = x1; gx <= x2; ++gx)
+        occupied[(size_t)gy * grid_w + gx] = 1;
+
+    int baseline = top + run.ascent;
+    placed.push_back({i, x, baseline,
+                      {x + run.ink.x, baseline + run.ink.y, run.ink.w,
+                       run.ink.h}});
+    if ((int)placed.size() == MAX_LABELS)
+      break;
+  }
+}
+
+void LabelLayer::render(SDL_Surface *surface, const NodeStore &nodes,
+                        GlyphAtlas &atlas, const SDL_Rect &clip) const {
+  const SDL_PixelFormatDetails *format =
+      SDL_GetPixelFormatDetails(surface->format);
+  char buf[16];
+  for (const Label &label : placed) {
+    if (!SDL_HasRectIntersection(&label.ink, &clip))
+      continue;
+    // Same color as the border, so selection shows on the label too.
+    Uint32 rgba = nodes.color[label.node];
+    bool selected = nodes.selection.contains(label.node);
+    Uint32 color = SDL_MapRGB(format, NULL, selected ? 255 : rgba_r(rgba),
+                              selected ? 255 : rgba_g(rgba),
+                              selected ? 0 : rgba_b(rgba));
+    const GlyphAtlas::TextRun &run =
+        atlas.layout(label_text(nodes, label.node, buf, sizeof(buf)), TEXT_PX);
+    atlas.draw(surface, run, label.x, label.baseline, color, &clip);
+  }
+}
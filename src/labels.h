@@ -0,0 +1,56 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <vector>
+
+#include "glyph_atlas.h"
+#include "node.h"
+
+// Node data drawn as text inside the nodes once zoomed in far enough.
+//
+// place() picks labels for a view from the nodes the spatial index found
+// visible: larger nodes first, only where the text fits inside the border,
+// and only where a screen-space occupancy grid has no label yet, up to
+// MAX_LABELS. Nodes whose center cell is taken are rejected before their
+// text is laid out, and at most MAX_TRIES texts are laid out per view.
+// render() then only draws what was placed, so a frame costs at most
+// MAX_LABELS cached text runs however many nodes are on screen.
+struct LabelLayer {
+  static constexpr float MIN_ZOOM = 1.5f;
+  static constexpr int TEXT_PX = 14;
+  static constexpr int MAX_LABELS = 400;
+  static constexpr int MAX_TRIES = 4 * MAX_LABELS; // texts laid out per view
+  static constexpr int CELL = 8; // occupancy grid cell, pixels
+  static constexpr int MARGIN = 2; // kept free around each label
+
+  struct Label {
+    int node;
+    int x, baseline; // text origin
+    SDL_Rect ink;    // pixels the text covers
+  };
+
+  std::vector<Label> placed;
+  std::vector<int> order;
+  std::vector<Uint8> occupied;
+  int grid_w = 0, grid_h = 0;
+
+  // Picks the labels for a whole view. visible must hold every node that
+  // may show on screen.
+  void place(const SDL_Surface *surface, const NodeStore &nodes,
+             const std::vector<int> &visible, float pan_x, float pan_y,
+             float zoom, GlyphAtlas &atlas);
+  void clear() { placed.clear(); }
+  // Follows the screen contents when they are scrolled by (dx, dy). Nodes
+  // scrolled in stay unlabelled until the next place().
+  void shift(int dx, int dy) {
+    for (Label &label : placed) {
+      label.x += dx;
+      label.baseline += dy;
+      label.ink.x += dx;
+      label.ink.y += dy;
+    }
+  }
+  // Draws the placed labels, writing only pixels inside clip.
+  void render(SDL_Surface *surface, const NodeStore &nodes,
+              GlyphAtlas &atlas, const SDL_Rect &clip) const;
+};
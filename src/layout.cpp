@@ -0,0 +1,154 @@
+#include "layout.h"
+
+#include <ogdf/energybased/FMMMLayout.h>
+#include <ogdf/energybased/FastMultipoleEmbedder.h>
+#include <ogdf/energybased/NodeRespecterLayout.h>
+#include <ogdf/energybased/PivotMDS.h>
+#include <ogdf/energybased/StressMinimization.h>
+#include <ogdf/packing/ComponentSplitterLayout.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+static const char *engine_names[LAYOUT_ENGINE_COUNT] = {
+    "respecter", "fme", "fmme", "fmmm", "pivotmds", "stress",
+};
+
+const char *layout_engine_name(LayoutEngine engine) {
+  return engine_names[engine];
+}
+
+bool parse_layout_engine(const char *name, LayoutEngine &engine) {
+  for (int e = 0; e < LAYOUT_ENGINE_COUNT; ++e) {
+    if (strcmp(name, engine_names[e]) == 0) {
+      engine = (LayoutEngine)e;
+      return true;
+    }
+  }
+  return false;
+}
+
+int parse_layout_arg(const char *arg, LayoutOptions &options) {
+  if (strncmp(arg, "--layout=", 9) == 0)
+    return parse_layout_engine(arg + 9, options.engine) ? 1 : -1;
+  if (strncmp(arg, "--threads=", 10) == 0) {
+    char *end = NULL;
+    long threads = strtol(arg + 10, &end, 10);
+    if (*end != '\0' || threads < 0 || threads > 1024)
+      return -1;
+    options.threads = (int)threads;
+    return 1;
+  }
+  return 0;
+}
+
+void print_layout_usage(FILE *out) {
+  fprintf(out, "  --layout=ENGINE  one of:");
+  for (int e = 0; e < LAYOUT_ENGINE_COUNT; ++e)
+    fprintf(out, " %s", engine_names[e]);
+  fprintf(out, " (default %s)\n", engine_names[LAYOUT_NODE_RESPECTER]);
+  fprintf(out, "  --threads=N      layout threads for fme/fmme, 0 = all "
+               "cores (default)\n");
+}
+
+int layout_round_count(LayoutEngine engine) {
+  switch (engine) {
+  case LAYOUT_NODE_RESPECTER:
+  case LAYOUT_FAST_MULTIPOLE:
+  case LAYOUT_STRESS:
+    return 10;
+  default:
+    return 1;
+  }
+}
+
+// The engines that ignore node sizes get an edge length that leaves room
+// for the average node.
+static double edge_length_for(const ogdf::GraphAttributes &GA) {
+  double total = 0.0;
+  int count = 0;
+  for (ogdf::node v : GA.constGraph().nodes) {
+    total += GA.width(v) > GA.height(v) ? GA.width(v) : GA.height(v);
+    count++;
+  }
+  return count ? 2.0 * total / count : 40.0;
+}
+
+static int thread_count(const LayoutOptions &options) {
+  if (options.threads > 0)
+    return options.threads;
+  int threads = (int)std::thread::hardware_concurrency();
+  return threads > 0 ? threads : 1;
+}
+
+void run_layout_round(ogdf::GraphAttributes &GA, const LayoutOptions &options,
+                      int round, int rounds) {
+  switch (options.engine) {
+  case LAYOUT_NODE_RESPECTER: {
+    // Split the default cooling schedule (30000 iterations from temperature
+    // 10 down to 1) across the rounds.
+    const double t_start = 10.0, t_end = 1.0;
+    ogdf::NodeRespecterLayout layout;
+    // Some padding between components
+    layout.setMinDistCC(20.0);
+    layout.setRandomInitialPlacement(false);
+    layout.setNumberOfIterations(30000 / rounds);
+    layout.setInitialTemperature(t_start - (t_start - t_end) * round / rounds);
+    layout.setMinimalTemperature(t_start -
+                                 (t_start - t_end) * (round + 1) / rounds);
+    layout.call(GA);
+    break;
+  }
+  case LAYOUT_FAST_MULTIPOLE: {
+    double length = edge_length_for(GA);
+    ogdf::FastMultipoleEmbedder layout;
+    layout.setRandomize(false);
+    layout.setNumIterations(300 / rounds);
+    layout.setDefaultEdgeLength((float)length);
+    layout.setDefaultNodeSize((float)(length / 2.0));
+    layout.setNumberOfThreads((uint32_t)thread_count(options));
+    layout.call(GA);
+    break;
+  }
+  case LAYOUT_FAST_MULTIPOLE_MULTILEVEL: {
+    ogdf::FastMultipoleMultilevelEmbedder layout;
+    layout.maxNumThreads(thread_count(options));
+    layout.call(GA);
+    break;
+  }
+  case LAYOUT_FMMM: {
+    ogdf::FMMMLayout layout;
+    layout.useHighLevelOptions(true);
+    layout.unitEdgeLength(edge_length_for(GA));
+    layout.newInitialPlacement(false);
+    layout.call(GA);
+    break;
+  }
+  case LAYOUT_PIVOT_MDS: {
+    // PivotMDS expects a connected graph
+    auto *layout = new ogdf::PivotMDS();
+    layout->setEdgeCosts(edge_length_for(GA));
+    ogdf::ComponentSplitterLayout splitter;
+    splitter.setLayoutModule(layout);
+    splitter.call(GA);
+    break;
+  }
+  case LAYOUT_STRESS: {
+    ogdf::StressMinimization layout;
+    layout.setEdgeCosts(edge_length_for(GA));
+    layout.layoutComponentsSeparately(true);
+    layout.hasInitialLayout(round > 0);
+    layout.setIterations(200 / rounds);
+    layout.call(GA);
+    break;
+  }
+  case LAYOUT_ENGINE_COUNT:
+    break;
+  }
+}
+
+void run_layout(ogdf::GraphAttributes &GA, const LayoutOptions &options) {
+  int rounds = layout_round_count(options.engine);
+  for (int r = 0; r < rounds; ++r)
+    run_layout_round(GA, options, r, rounds);
+}
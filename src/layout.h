@@ -0,0 +1,41 @@
+#pragma once
+
+#include <ogdf/basic/GraphAttributes.h>
+#include <stdio.h>
+
+enum LayoutEngine {
+  LAYOUT_NODE_RESPECTER,            // overlap-aware, single-threaded
+  LAYOUT_FAST_MULTIPOLE,            // FastMultipoleEmbedder, threaded
+  LAYOUT_FAST_MULTIPOLE_MULTILEVEL, // FastMultipoleMultilevelEmbedder, threaded
+  LAYOUT_FMMM,                      // FMMMLayout
+  LAYOUT_PIVOT_MDS,                 // PivotMDS
+  LAYOUT_STRESS,                    // StressMinimization, O(n^2) memory
+  LAYOUT_ENGINE_COUNT
+};
+
+struct LayoutOptions {
+  LayoutEngine engine = LAYOUT_NODE_RESPECTER;
+  // Worker threads for the engines that can use them, 0 = all cores.
+  int threads = 0;
+};
+
+const char *layout_engine_name(LayoutEngine engine);
+bool parse_layout_engine(const char *name, LayoutEngine &engine);
+
+// Handles the shared --layout=NAME and --threads=N command line flags.
+// Returns 1 if arg was one of them, 0 if it was not, -1 if its value is
+// invalid.
+int parse_layout_arg(const char *arg, LayoutOptions &options);
+void print_layout_usage(FILE *out);
+
+// Number of warm-started rounds the engine's work is split into. Engines
+// that cannot resume from a previous result run in a single round.
+int layout_round_count(LayoutEngine engine);
+
+// Runs one round in place. Node sizes in GA must already include the border
+// on both sides; rounds after the first continue from the current positions.
+void run_layout_round(ogdf::GraphAttributes &GA, const LayoutOptions &options,
+                      int round, int rounds);
+
+// Runs every round back to back.
+void run_layout(ogdf::GraphAttributes &GA, const LayoutOptions &options);
@@ -0,0 +1,310 @@
+#include "layout_cache.h"
+
+#include <SDL3/SDL_filesystem.h>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+#include "spatial_index.h"
+
+#include "debug.h"
+
+#define LAYOUT_CACHE_MAGIC "GVLCACHE"
+#define LAYOUT_CACHE_VERSION 1
+
+enum LayoutCacheKind : Uint32 {
+  LAYOUT_CACHE_POSITIONS, // float x[count], float y[count]
+  LAYOUT_CACHE_ORDER,     // Sint32 order[count], a permutation
+  LAYOUT_CACHE_KINDS
+};
+
+static const char *kind_suffix[LAYOUT_CACHE_KINDS] = {".positions",
+                                                      ".order"};
+
+struct LayoutCacheHeader {
+  char magic[8];
+  Uint32 version;
+  Uint32 kind;
+  Uint64 key;
+  Uint64 count;
+};
+static_assert(sizeof(LayoutCacheHeader) == 32, "LayoutCacheHeader layout");
+static_assert(sizeof(int) == sizeof(Sint32), "orders are stored as int");
+
+static const Uint64 HASH_K1 = 0x87C37B91114253D5ull;
+static const Uint64 HASH_K2 = 0x4CF5AD432745937Full;
+
+static Uint64 rotl(Uint64 v, int r) { return (v << r) | (v >> (64 - r)); }
+
+void ContentHash::add(const void *data, size_t bytes) {
+  const Uint8 *p = (const Uint8 *)data;
+  for (; bytes >= 8; p += 8, bytes -= 8) {
+    Uint64 word;
+    memcpy(&word, p, 8);
+    state = rotl(state ^ (word * HASH_K1), 31) * HASH_K2;
+  }
+  // The tail is tagged with its length, so trailing zero bytes still count.
+  if (bytes) {
+    Uint64 word = 0;
+    memcpy(&word, p, bytes);
+    state = rotl(state ^ ((word ^ bytes) * HASH_K1), 31) * HASH_K2;
+  }
+}
+
+Uint64 ContentHash::value() const {
+  Uint64 h = state;
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDull;
+  h ^= h >> 33;
+  h *= 0xC4CEB9FE1A85EC53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+Uint64 layout_cache_key(const NodeStore &nodes, const EdgeCSR &csr,
+                        LayoutEngine engine) {
+  size_t n = nodes.size();
+  ContentHash hash;
+  hash.add_value((Uint32)LAYOUT_CACHE_POSITIONS);
+  hash.add_value((Uint32)engine);
+  hash.add_value((Uint64)n);
+  hash.add(nodes.x.data(), n * sizeof(float));
+  hash.add(nodes.y.data(), n * sizeof(float));
+  hash.add(nodes.width.data(), n * sizeof(float));
+  hash.add(nodes.height.data(), n * sizeof(float));
+  hash.add(nodes.border_thickness.data(), n * sizeof(float));
+  hash.add_value((Uint64)csr.node_count);
+  hash.add_value(csr.edge_count);
+  if (csr.offsets) {
+    hash.add(csr.offsets, ((size_t)csr.node_count + 1) * sizeof(Uint64));
+    hash.add(csr.targets, (size_t)csr.edge_count * sizeof(Uint32));
+  }
+  return hash.value();
+}
+
+Uint64 index_cache_key(const NodeStore &nodes) {
+  size_t n = nodes.size();
+  ContentHash hash;
+  hash.add_value((Uint32)LAYOUT_CACHE_ORDER);
+  hash.add_value((Uint32)SpatialIndex::FANOUT);
+  hash.add_value((Uint64)n);
+  hash.add(nodes.x.data(), n * sizeof(float));
+  hash.add(nodes.y.data(), n * sizeof(float));
+  return hash.value();
+}
+
+static std::string entry_path(const std::string &dir, Uint32 kind,
+                              Uint64 key) {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+  return dir + name + kind_suffix[kind];
+}
+
+bool LayoutCache::open() {
+  dir.clear();
+  char *pref = SDL_GetPrefPath(NULL, "graph_viewer");
+  if (!pref) {
+    log("No pref path for the layout cache: %s\n", SDL_GetError());
+    return false;
+  }
+  std::string base = pref;
+  SDL_free(pref);
+  std::string path = base + "layout_cache";
+  if (!SDL_CreateDirectory(path.c_str())) {
+    log("Failed to create %s: %s\n", path.c_str(), SDL_GetError());
+    return false;
+  }
+  // The pref path ends in the platform's separator.
+  dir = path + base.back();
+  return true;
+}
+
+// Reads an entry whose payload is parts[0..part_count) back to back. Entries
+// that exist but do not match are deleted.
+static bool read_entry(const std::string &dir, Uint32 kind, Uint64 key,
+                       Uint64 count, void *const *parts, const size_t *bytes,
+                       int part_count) {
+  if (dir.empty())
+    return false;
+  std::string path = entry_path(dir, kind, key);
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f)
+    return false;
+  LayoutCacheHeader header;
+  bool ok = fread(&header, sizeof(header), 1, f) == 1 &&
+            memcmp(header.magic, LAYOUT_CACHE_MAGIC, 8) == 0 &&
+            header.version == LAYOUT_CACHE_VERSION && header.kind == kind &&
+            header.key == key && header.count == count;
+  for (int p = 0; p < part_count && ok; ++p)
+    ok = fread(parts[p], 1, bytes[p], f) == bytes[p];
+  ok = ok && fgetc(f) == EOF;
+  fclose(f);
+  if (!ok) {
+    log("Dropping stale cache entry %s\n", path.c_str());
+    SDL_RemovePath(path.c_str());
+    return false;
+  }
+  // Rewriting the header as it is marks the entry used for trim(), which
+  // cannot go by access times: most mounts update them lazily or never.
+  f = fopen(path.c_str(), "r+b");
+  if (f) {
+    fwrite(&header, sizeof(header), 1, f);
+    fclose(f);
+  }
+  return true;
+}
+
+// Writes to a temporary name first, so a concurrent reader never sees a
+// partial entry.
+static bool write_entry(const std::string &dir, Uint32 kind, Uint64 key,
+                        Uint64 count, const void *const *parts,
+                        const size_t *bytes, int part_count) {
+  std::string path = entry_path(dir, kind, key);
+  std::string temp = path + ".tmp";
+  FILE *f = fopen(temp.c_str(), "wb");
+  if (!f) {
+    log("Failed to create %s\n", temp.c_str());
+    return false;
+  }
+  LayoutCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, LAYOUT_CACHE_MAGIC, sizeof(header.magic));
+  header.version = LAYOUT_CACHE_VERSION;
+  header.kind = kind;
+  header.key = key;
+  header.count = count;
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+  for (int p = 0; p < part_count && ok; ++p)
+    ok = fwrite(parts[p], 1, bytes[p], f) == bytes[p];
+  if (fclose(f) != 0)
+    ok = false;
+  ok = ok && SDL_RenamePath(temp.c_str(), path.c_str());
+  if (!ok) {
+    log("Failed to write %s\n", path.c_str());
+    SDL_RemovePath(temp.c_str());
+  }
+  return ok;
+}
+
+bool LayoutCache::load_positions(Uint64 key, size_t count, float *x,
+                                 float *y) {
+  if (recompute)
+    return false;
+  void *parts[2] = {x, y};
+  size_t bytes[2] = {count * sizeof(float), count * sizeof(float)};
+  if (!read_entry(dir, LAYOUT_CACHE_POSITIONS, key, count, parts, bytes, 2))
+    return false;
+  log("Layout cache hit %016llx\n", (unsigned long long)key);
+  return true;
+}
+
+void LayoutCache::store_positions(Uint64 key, size_t count, const float *x,
+                                  const float *y) {
+  if (dir.empty() || limit_bytes == 0)
+    return;
+  const void *parts[2] = {x, y};
+  size_t bytes[2] = {count * sizeof(float), count * sizeof(float)};
+  if (write_entry(dir, LAYOUT_CACHE_POSITIONS, key, count, parts, bytes, 2))
+    trim();
+}
+
+bool LayoutCache::load_order(Uint64 key, size_t count,
+                             std::vector<int> &order) {
+  if (recompute)
+    return false;
+  order.resize(count);
+  void *parts[1] = {order.data()};
+  size_t bytes[1] = {count * sizeof(int)};
+  if (!read_entry(dir, LAYOUT_CACHE_ORDER, key, count, parts, bytes, 1))
+    return false;
+  // A bad permutation would send queries out of bounds, so it is checked
+  // even though the header matched.
+  std::vector<bool> seen(count, false);
+  for (int i : order) {
+    if (i < 0 || (size_t)i >= count || seen[i]) {
+      log("Dropping corrupt index order %016llx\n", (unsigned long long)key);
+      SDL_RemovePath(entry_path(dir, LAYOUT_CACHE_ORDER, key).c_str());
+      return false;
+    }
+    seen[i] = true;
+  }
+  log("Index cache hit %016llx\n", (unsigned long long)key);
+  return true;
+}
+
+void LayoutCache::store_order(Uint64 key, const std::vector<int> &order) {
+  if (dir.empty() || limit_bytes == 0)
+    return;
+  const void *parts[1] = {order.data()};
+  size_t bytes[1] = {order.size() * sizeof(int)};
+  if (write_entry(dir, LAYOUT_CACHE_ORDER, key, order.size(), parts, bytes,
+                  1))
+    trim();
+}
+
+struct CacheEntry {
+  std::string path;
+  Uint64 size;
+  SDL_Time used; // last written, by a store or by read_entry()
+};
+
+struct CacheListing {
+  const std::string *dir;
+  std::vector<CacheEntry> entries;
+};
+
+static SDL_EnumerationResult SDLCALL list_entry(void *userdata, const char *,
+                                                const char *fname) {
+  CacheListing &listing = *(CacheListing *)userdata;
+  std::string path = *listing.dir + fname;
+  SDL_PathInfo info;
+  if (SDL_GetPathInfo(path.c_str(), &info) && info.type == SDL_PATHTYPE_FILE)
+    listing.entries.push_back(
+        {path, info.size, info.modify_time});
+  return SDL_ENUM_CONTINUE;
+}
+
+void LayoutCache::trim() {
+  if (dir.empty())
+    return;
+  CacheListing listing;
+  listing.dir = &dir;
+  SDL_EnumerateDirectory(dir.c_str(), list_entry, &listing);
+  Uint64 total = 0;
+  for (const CacheEntry &entry : listing.entries)
+    total += entry.size;
+  std::sort(listing.entries.begin(), listing.entries.end(),
+            [](const CacheEntry &a, const CacheEntry &b) {
+              return a.used < b.used;
+            });
+  for (const CacheEntry &entry : listing.entries) {
+    if (total <= limit_bytes)
+      break;
+    if (SDL_RemovePath(entry.path.c_str()))
+      total -= entry.size;
+  }
+}
+
+int parse_cache_arg(const char *arg, LayoutCache &cache) {
+  if (strcmp(arg, "--recompute") == 0) {
+    cache.recompute = true;
+    return 1;
+  }
+  if (strncmp(arg, "--cache-mb=", 11) == 0) {
+    char *end = NULL;
+    long mb = strtol(arg + 11, &end, 10);
+    if (*end != '\0' || mb < 0 || mb > (1l << 20))
+      return -1;
+    cache.limit_bytes = (Uint64)mb << 20;
+    return 1;
+  }
+  return 0;
+}
+
+void print_cache_usage(FILE *out) {
+  fprintf(out, "  --recompute      ignore cached layouts and indexes, "
+               "then refresh them\n");
+  fprintf(out, "  --cache-mb=N     layout cache size, 0 = off (default "
+               "%ld)\n",
+          LayoutCache::DEFAULT_LIMIT_MB);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <SDL3/SDL_stdinc.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "edges.h"
+#include "layout.h"
+#include "node.h"
+
+// Incremental 64-bit hash of a graph's content, for cache keys. Fast and
+// well mixed, not cryptographic.
+struct ContentHash {
+  Uint64 state = 0x9E3779B97F4A7C15ull;
+
+  void add(const void *data, size_t bytes);
+  template <typename T> void add_value(const T &value) {
+    add(&value, sizeof(value));
+  }
+  Uint64 value() const;
+};
+
+// Key of the layout engine's result for these start positions, node sizes
+// and edges.
+Uint64 layout_cache_key(const NodeStore &nodes, const EdgeCSR &csr,
+                        LayoutEngine engine);
+// Key of the SpatialIndex order for these node centers.
+Uint64 index_cache_key(const NodeStore &nodes);
+
+// On-disk cache of computed layouts and spatial index orders, one file per
+// entry named after its content hash, under the user's pref path. A graph
+// that changes in any hashed way simply misses; entries from another
+// format version or that fail validation are deleted on sight. After each
+// store the least recently used entries are removed until the directory is
+// under limit_bytes.
+struct LayoutCache {
+  static constexpr long DEFAULT_LIMIT_MB = 256;
+
+  std::string dir; // with trailing separator, empty when disabled
+  Uint64 limit_bytes = (Uint64)DEFAULT_LIMIT_MB << 20;
+  bool recompute = false; // skip lookups, still store fresh results
+
+  // Creates the cache directory. Returns false, leaving the cache
+  // disabled, if that fails.
+  bool open();
+
+  bool load_positions(Uint64 key, size_t count, float *x, float *y);
+  void store_positions(Uint64 key, size_t count, const float *x,
+                       const float *y);
+  bool load_order(Uint64 key, size_t count, std::vector<int> &order);
+  void store_order(Uint64 key, const std::vector<int> &order);
+
+  // Removes least recently used entries until under limit_bytes.
+  void trim();
+};
+
+// Handles the shared --recompute and --cache-mb=N command line flags, with
+// the return values of parse_layout_arg().
+int parse_cache_arg(const char *arg, LayoutCache &cache);
+void print_cache_usage(FILE *out);
@@ -0,0 +1,125 @@
+#include "layout_worker.h"
+
+#include <ogdf/basic/Graph.h>
+#include <ogdf/basic/GraphAttributes.h>
+
+#include "debug.h"
+
+struct LayoutInput {
+  LayoutOptions options;
+  std::vector<float> x, y, width, height;
+  std::vector<Uint32> sources, targets;
+};
+
+static void layout_rounds(std::shared_ptr<LayoutWorker::Run> run,
+                          LayoutInput input) {
+  size_t n = input.x.size();
+  ogdf::Graph G;
+  ogdf::GraphAttributes GA(G, ogdf::GraphAttributes::nodeGraphics);
+  std::vector<ogdf::node> ogdf_nodes(n);
+  for (size_t i = 0; i < n; ++i) {
+    ogdf::node v = G.newNode();
+    GA.x(v) = input.x[i];
+    GA.y(v) = input.y[i];
+    GA.width(v) = input.width[i];
+    GA.height(v) = input.height[i];
+    ogdf_nodes[i] = v;
+  }
+  for (size_t e = 0; e < input.sources.size(); ++e)
+    G.newEdge(ogdf_nodes[input.sources[e]], ogdf_nodes[input.targets[e]]);
+
+  const LayoutOptions &options = input.options;
+  const int rounds = layout_round_count(options.engine);
+  LayoutSnapshot snapshot;
+  snapshot.x.resize(n);
+  snapshot.y.resize(n);
+  snapshot.rounds = rounds;
+  for (int r = 0; r < rounds && !run->cancel_requested.load(); ++r) {
+    run_layout_round(GA, options, r, rounds);
+
+    for (size_t i = 0; i < n; ++i) {
+      snapshot.x[i] = (float)GA.x(ogdf_nodes[i]);
+      snapshot.y[i] = (float)GA.y(ogdf_nodes[i]);
+    }
+    snapshot.round = r + 1;
+    {
+      std::lock_guard<std::mutex> lock(run->mutex);
+      std::swap(run->pending, snapshot);
+      run->has_pending = true;
+    }
+    // The buffer we got back may be one the render thread already consumed
+    // (or empty on the first swap); keep it sized for the next round.
+    snapshot.x.resize(n);
+    snapshot.y.resize(n);
+    snapshot.rounds = rounds;
+    run->rounds_done.store(r + 1);
+    log("Layout round %d/%d (%s)\n", r + 1, rounds,
+        layout_engine_name(options.engine));
+  }
+  run->finished.store(true);
+}
+
+void LayoutWorker::start(const NodeStore &nodes, const EdgeCSR &csr) {
+  cancel();
+
+  LayoutInput input;
+  input.options = options;
+  input.x.assign(nodes.x.begin(), nodes.x.end());
+  input.y.assign(nodes.y.begin(), nodes.y.end());
+  input.width.resize(nodes.size());
+  input.height.resize(nodes.size());
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    input.width[i] = nodes.width[i] + nodes.border_thickness[i] * 2.0f;
+    input.height[i] = nodes.height[i] + nodes.border_thickness[i] * 2.0f;
+  }
+  input.sources.reserve(csr.edge_count);
+  input.targets.reserve(csr.edge_count);
+  for (int i = 0; i < csr.node_count; ++i) {
+    for (Uint64 e = csr.offsets[i]; e < csr.offsets[i + 1]; ++e) {
+      input.sources.push_back((Uint32)i);
+      input.targets.push_back(csr.targets[e]);
+    }
+  }
+
+  rounds_total = layout_round_count(options.engine);
+  run = std::make_shared<Run>();
+  thread = std::thread(layout_rounds, run, std::move(input));
+}
+
+void LayoutWorker::cancel() {
+  reap();
+  if (!run)
+    return;
+  run->cancel_requested.store(true);
+  retired.push_back({run, std::move(thread)});
+  run.reset();
+}
+
+void LayoutWorker::reap() {
+  for (size_t k = 0; k < retired.size();) {
+    if (retired[k].run->finished.load()) {
+      retired[k].thread.join();
+      retired.erase(retired.begin() + k);
+    } else {
+      k++;
+    }
+  }
+}
+
+LayoutWorker::~LayoutWorker() {
+  cancel();
+  for (Retired &r : retired)
+    r.thread.join();
+}
+
+bool LayoutWorker::poll(LayoutSnapshot &out) {
+  reap();
+  if (!run)
+    return false;
+  std::lock_guard<std::mutex> lock(run->mutex);
+  if (!run->has_pending)
+    return false;
+  std::swap(run->pending, out);
+  run->has_pending = false;
+  return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "edges.h"
+#include "layout.h"
+#include "node.h"
+
+struct LayoutSnapshot {
+  std::vector<float> x, y;
+  int round = 0;
+  int rounds = 0;
+};
+
+// Runs the selected layout engine on a background thread in short rounds,
+// each warm-started from the previous one, and publishes the positions after
+// every round. Publishing and picking up a snapshot swap buffers under a
+// mutex, so neither side ever copies while holding it for long.
+//
+// Cancelling never waits for the engine: the cancelled run finishes its
+// round on its own thread, which is joined once it is done, at the latest
+// when the worker is destroyed.
+struct LayoutWorker {
+  // One layout run, shared with its thread so a cancelled run can finish
+  // its round without touching the worker.
+  struct Run {
+    std::atomic<bool> cancel_requested{false};
+    std::atomic<bool> finished{false};
+    std::atomic<int> rounds_done{0};
+    std::mutex mutex;
+    LayoutSnapshot pending; // guarded by mutex
+    // Set under mutex; read without it to tell whether poll() has work.
+    std::atomic<bool> has_pending{false};
+  };
+  struct Retired {
+    std::shared_ptr<Run> run;
+    std::thread thread;
+  };
+
+  LayoutOptions options;
+
+  std::shared_ptr<Run> run;
+  std::thread thread;
+  int rounds_total = 0;
+  std::vector<Retired> retired; // cancelled, possibly still running
+
+  LayoutWorker() = default;
+  LayoutWorker(const LayoutWorker &) = delete;
+  LayoutWorker &operator=(const LayoutWorker &) = delete;
+  ~LayoutWorker();
+
+  // Starts (or restarts) a layout seeded from the current node positions.
+  void start(const NodeStore &nodes, const EdgeCSR &csr);
+  // Stops the run after the round in progress without waiting for it.
+  // Positions it publishes from now on are dropped, not handed to poll().
+  void cancel();
+  // Swaps the newest published snapshot into out. Returns false if nothing
+  // new arrived since the last call.
+  bool poll(LayoutSnapshot &out);
+  bool running() const { return run && !run->finished.load(); }
+  int rounds_done() const { return run ? run->rounds_done.load() : 0; }
+  // Whether poll() still has something to do: a round in progress, a
+  // snapshot not picked up yet or a cancelled run left to join.
+  bool busy() const {
+    return (run && (!run->finished.load() || run->has_pending.load())) ||
+           !retired.empty();
+  }
+
+private:
+  // Joins the cancelled runs that have finished.
+  void reap();
+};
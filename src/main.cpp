@@ -1,266 +1,331 @@
 #include "SDL3/SDL_events.h"
 #include "SDL3/SDL_pixels.h"
 #include "SDL3/SDL_stdinc.h"
-#define DEBUG
 
 #include <SDL3/SDL.h>
 #include <assert.h>
-#include <ogdf/basic/Graph.h>
-#include <ogdf/basic/GraphAttributes.h>
-#include <ogdf/energybased/NodeRespecterLayout.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
-#define STB_TRUETYPE_IMPLEMENTATION
-#include <stb_truetype.h>
+#include "damage.h"
+#include "density_pyramid.h"
+#include "edges.h"
+#include "glyph_atlas.h"
+#include "graph_file.h"
+#include "graph_hierarchy.h"
+#include "graph_stream.h"
+#include "incremental_layout.h"
+#include "labels.h"
+#include "layout_cache.h"
+#include "layout_worker.h"
+#include "node.h"
+#include "overview_worker.h"
+#include "page_cache.h"
+#include "paged_graph.h"
+#include "pixel_format.h"
+#include "profiler.h"
+#include "scene.h"
+#include "search_index.h"
+#include "selection_tools.h"
+#include "spatial_index.h"
+#include "tile_renderer.h"
+#include "widgets.h"
+
+#include "debug.h"
 
 #define PROG_NAME "Graph Viewer"
 #define WIDTH (4 * 200)
 #define HEIGHT (5 * 120)
+#define TRACE_PATH "viewer_trace.json"
+#define PAGE_BUDGET_MB 512
+#define SELECTION_PATH "selection_ids.txt"
+// Past this many selected nodes a selection change repaints everything
+// rather than damaging each node.
+#define SELECTION_DAMAGE_LIMIT 1024
+// Screen distance between recorded lasso points.
+#define LASSO_STEP 3.0f
+// Screen distance within which a click or hover finds a node when none is
+// directly under the cursor.
+#define PICK_RADIUS 4.0f
+// Live updates are drained UPDATE_BATCH at a time until the ring is empty
+// or UPDATE_BUDGET_MS of the frame is spent. The density pyramid follows
+// every batch; the hierarchy and search are rebuilt in the background at
+// most every OVERVIEW_REFRESH_MS while updates keep coming.
+#define UPDATE_BATCH 4096
+#define UPDATE_BUDGET_MS 4
+#define OVERVIEW_REFRESH_MS 1000
 
-#ifdef DEBUG
-#include <stdio.h>
-#define log(...) printf("[LOG] :: " __VA_ARGS__)
-#define assert_eq(x, y, ...)                                                   \
-  if ((x) != (y)) {                                                            \
-    fprintf(stderr, "!!! assertion failed %s != %s\n", #x, #y);                \
-    printf("[FAILED] :: " __VA_ARGS__);                                        \
-    assert(0);                                                                 \
-  }
-#define log_once(...)                                                          \
-  {                                                                            \
-    static bool once = false;                                                  \
-    if (!once) {                                                               \
-      log(__VA_ARGS__);                                                        \
-      once = true;                                                             \
-    }                                                                          \
-  }
-#else
-#define log(...) ((void)0)
-#endif
-
-template <typename T> struct UINode;
-struct QuadTree;
 void do_checks(SDL_Surface *);
-void draw_string_widget(SDL_Surface *, int, int, const char *, Uint32, Uint32);
-void draw_ttf_widget(SDL_Surface *, int, int, const char *, stbtt_fontinfo *,
-                     Uint32, Uint32);
-void draw_ui_widget(SDL_Surface *, int, int, const char *, stbtt_fontinfo *,
-                    Uint32, Uint32);
-void draw(SDL_Surface *, const std::vector<UINode<Uint32>> &, const QuadTree &,
-          float, float, float);
-
-template <typename T> struct UINode {
-  T data;
-  float x, y;
-  float width, height;
-  float border_thickness;
-  Uint8 r, g, b, a;
-  bool selected = false;
-
-  void render(SDL_Surface *surface, float offset_x, float offset_y,
-              float zoom) const {
-    if (!surface)
-      return;
 
-    float scaled_x = (x + offset_x) * zoom;
-    float scaled_y = (y + offset_y) * zoom;
-    float scaled_w = width * zoom;
-    float scaled_h = height * zoom;
-    float scaled_border = border_thickness * zoom;
-
-    float half_w = scaled_w / 2.0f;
-    float half_h = scaled_h / 2.0f;
-
-    float inner_half_w = half_w - scaled_border;
-    float inner_half_h = half_h - scaled_border;
-
-    if (inner_half_w < 0.0f)
-      inner_half_w = 0.0f;
-    if (inner_half_h < 0.0f)
-      inner_half_h = 0.0f;
-
-    int min_x = (int)(scaled_x - half_w - 1);
-    int max_x = (int)(scaled_x + half_w + 1);
-    int min_y = (int)(scaled_y - half_h - 1);
-    int max_y = (int)(scaled_y + half_h + 1);
-
-    if (min_x < 0)
-      min_x = 0;
-    if (max_x >= surface->w)
-      max_x = surface->w - 1;
-    if (min_y < 0)
-      min_y = 0;
-    if (max_y >= surface->h)
-      max_y = surface->h - 1;
-
-#ifndef DEBUG
-    SDL_PixelFormatDetails const *pixel_details =
-        SDL_GetPixelFormatDetails(surface->format);
-    Sint32 stride = pixel_details->bytes_per_pixel;
-#endif
-
-    for (int cy = min_y; cy <= max_y; ++cy) {
-      for (int cx = min_x; cx <= max_x; ++cx) {
-        float dx = (float)cx - scaled_x;
-        float dy = (float)cy - scaled_y;
-
-        // Use inclusive bounds for outer, exclusive for inner to create the
-        // border
-        bool in_outer =
-            (dx >= -half_w && dx <= half_w && dy >= -half_h && dy <= half_h);
-        bool in_inner = (dx > -inner_half_w && dx < inner_half_w &&
-                         dy > -inner_half_h && dy < inner_half_h);
-
-        if (in_outer && !in_inner) {
-          Uint8 out_r = selected ? 255 : r;
-          Uint8 out_g = selected ? 255 : g;
-          Uint8 out_b = selected ? 0 : b;
-#ifndef DEBUG
-          Uint8 *target_pixel = ((Uint8 *)surface->pixels +
-                                 (cy * surface->pitch) + (cx * stride));
-          // Note: Hardcoded RGB channel order, might need adaptation for
-          // specific formats like BGRA
-          target_pixel[0] = out_r;
-          target_pixel[1] = out_g;
-          target_pixel[2] = out_b;
-#else
-          SDL_WriteSurfacePixel(surface, cx, cy, out_r, out_g, out_b, a);
-#endif
-        }
-      }
-    }
-  }
+// One overlay widget as laid out for a frame. Each frame's list is compared
+// with the previous one so only widgets that changed get repainted.
+struct OverlayWidget {
+  char text[48];
+  int x, y;
+  Uint32 bg;
+  bool bitmap; // drawn with the built-in bitmap font
+  bool meter;  // the FPS meter, whose own repaints are not counted
+  SDL_Rect rect;
 };
 
-struct Rect {
-  float x1, y1, x2, y2;
-  bool intersects(const Rect &other) const {
-    return !(x2 < other.x1 || x1 > other.x2 || y2 < other.y1 || y1 > other.y2);
+static bool same_widget(const OverlayWidget &a, const OverlayWidget &b) {
+  return a.x == b.x && a.y == b.y && a.bg == b.bg && a.bitmap == b.bitmap &&
+         strcmp(a.text, b.text) == 0;
+}
+
+static bool has_widget(const std::vector<OverlayWidget> &list,
+                       const OverlayWidget &widget) {
+  for (const OverlayWidget &w : list)
+    if (same_widget(w, widget))
+      return true;
+  return false;
+}
+
+// Damages widgets that disappeared from or appeared in the overlay.
+// Returns whether any of them was not the FPS meter.
+bool damage_overlay(const std::vector<OverlayWidget> &before,
+                    const std::vector<OverlayWidget> &after, Damage &damage) {
+  bool changed = false;
+  for (const OverlayWidget &w : before) {
+    if (!has_widget(after, w)) {
+      damage.add(w.rect);
+      changed = changed || !w.meter;
+    }
   }
-  bool contains(float x, float y) const {
-    return x >= x1 && x <= x2 && y >= y1 && y <= y2;
+  for (const OverlayWidget &w : after) {
+    if (!has_widget(before, w)) {
+      damage.add(w.rect);
+      changed = changed || !w.meter;
+    }
   }
-};
+  return changed;
+}
 
-struct QuadTree {
-  static const int CAPACITY = 16;
-  Rect boundary;
-  std::vector<int> indices;
-  QuadTree *nw, *ne, *sw, *se;
-  const std::vector<UINode<Uint32>> &nodes_ref;
-
-  QuadTree(Rect b, const std::vector<UINode<Uint32>> &nodes)
-      : boundary(b), nw(nullptr), ne(nullptr), sw(nullptr), se(nullptr),
-        nodes_ref(nodes) {}
-  ~QuadTree() {
-    delete nw;
-    delete ne;
-    delete sw;
-    delete se;
-  }
+// Screen pixels node i may cover, with a margin for the raster kernel's
+// rounding.
+SDL_Rect node_screen_rect(const NodeStore &nodes, int i, float pan_x,
+                          float pan_y, float zoom) {
+  Rect box = nodes.box(i);
+  float x1 = SDL_clamp((box.x1 + pan_x) * zoom, -1e6f, 1e6f);
+  float y1 = SDL_clamp((box.y1 + pan_y) * zoom, -1e6f, 1e6f);
+  float x2 = SDL_clamp((box.x2 + pan_x) * zoom, -1e6f, 1e6f);
+  float y2 = SDL_clamp((box.y2 + pan_y) * zoom, -1e6f, 1e6f);
+  int ix1 = (int)SDL_floorf(x1) - 2, iy1 = (int)SDL_floorf(y1) - 2;
+  int ix2 = (int)SDL_ceilf(x2) + 2, iy2 = (int)SDL_ceilf(y2) + 2;
+  return {ix1, iy1, ix2 - ix1 + 1, iy2 - iy1 + 1};
+}
 
-  void subdivide() {
-    float mx = (boundary.x1 + boundary.x2) / 2.0f;
-    float my = (boundary.y1 + boundary.y2) / 2.0f;
-    nw = new QuadTree({boundary.x1, boundary.y1, mx, my}, nodes_ref);
-    ne = new QuadTree({mx, boundary.y1, boundary.x2, my}, nodes_ref);
-    sw = new QuadTree({boundary.x1, my, mx, boundary.y2}, nodes_ref);
-    se = new QuadTree({mx, my, boundary.x2, boundary.y2}, nodes_ref);
+// Screen pixels a 1px line between two points may cover.
+static SDL_Rect segment_screen_rect(float x0, float y0, float x1, float y1) {
+  int ix1 = (int)SDL_floorf(SDL_min(x0, x1)) - 1;
+  int iy1 = (int)SDL_floorf(SDL_min(y0, y1)) - 1;
+  int ix2 = (int)SDL_ceilf(SDL_max(x0, x1)) + 1;
+  int iy2 = (int)SDL_ceilf(SDL_max(y0, y1)) + 1;
+  return {ix1, iy1, ix2 - ix1 + 1, iy2 - iy1 + 1};
+}
+
+// Colors C cycles the selection through.
+static const Uint32 selection_palette[] = {
+    pack_rgba(230, 80, 80, 255),  pack_rgba(80, 200, 120, 255),
+    pack_rgba(90, 140, 240, 255), pack_rgba(240, 200, 60, 255),
+    pack_rgba(200, 110, 220, 255), pack_rgba(255, 255, 255, 255)};
+
+// Milliseconds until deadline, or timeout if that is sooner. A negative
+// timeout means no wait is pending yet.
+static Sint32 sooner(Sint32 timeout, Uint32 deadline, Uint32 now) {
+  Sint32 left = deadline > now ? (Sint32)(deadline - now) : 0;
+  return timeout < 0 || left < timeout ? left : timeout;
+}
+
+void generate_random_nodes(int count, int max_w, int max_h,
+                           NodeStore &nodes) {
+  nodes.resize(count);
+  for (int i = 0; i < count; ++i) {
+    nodes.data[i] = (Uint32)rand();
+    nodes.x[i] = (float)(rand() % max_w);
+    nodes.y[i] = (float)(rand() % max_h);
+    nodes.width[i] = 20.0f + (float)(rand() % 80);
+    nodes.height[i] = 20.0f + (float)(rand() % 80);
+    nodes.border_thickness[i] = 2.0f + (float)(rand() % 5);
+    nodes.color[i] = pack_rgba(255, 255, 255, 255);
   }
+}
 
-  bool insert(int idx) {
-    float x = nodes_ref[idx].x;
-    float y = nodes_ref[idx].y;
-    if (!boundary.contains(x, y))
-      return false;
+// Builds the spatial index, reusing the order cached for these positions
+// when there is one.
+void build_index(const NodeStore &nodes, SpatialIndex &index,
+                 LayoutCache &cache) {
+  Uint64 key = index_cache_key(nodes);
+  std::vector<int> order;
+  if (cache.load_order(key, nodes.size(), order)) {
+    index.adopt(nodes, std::move(order));
+    return;
+  }
+  index.build(nodes);
+  cache.store_order(key, index.order);
+}
 
-    if (nw == nullptr) {
-      if (indices.size() < CAPACITY) {
-        indices.push_back(idx);
-        return true;
-      }
-      subdivide();
-      for (int stored_idx : indices) {
-        if (!nw->insert(stored_idx))
-          if (!ne->insert(stored_idx))
-            if (!sw->insert(stored_idx))
-              se->insert(stored_idx);
-      }
-      indices.clear();
-    }
+// Copies a layout round into the scene. Intermediate rounds only refit the
+// spatial index boxes and the super-nodes; the final round re-sorts the
+// index for tight queries and has the hierarchy regrouped in the background.
+void apply_layout_snapshot(const LayoutSnapshot &snapshot,
+                           NodeStore &nodes, SpatialIndex &index,
+                           EdgeLayer &edges, DensityPyramid &pyramid,
+                           GraphHierarchy &hierarchy,
+                           OverviewWorker &overviews, LayoutCache &cache) {
+  nodes.x.assign(snapshot.x.begin(), snapshot.x.end());
+  nodes.y.assign(snapshot.y.begin(), snapshot.y.end());
+  if (snapshot.round == snapshot.rounds)
+    build_index(nodes, index, cache);
+  else
+    index.refit();
+  edges.rebuild(nodes);
+  pyramid.build(nodes);
+  hierarchy.refit(nodes);
+  overviews.positions_changed();
+  if (snapshot.round == snapshot.rounds)
+    overviews.start(nodes, edges, false);
+  log("Applied layout round %d/%d\n", snapshot.round, snapshot.rounds);
+}
 
-    if (nw->insert(idx))
-      return true;
-    if (ne->insert(idx))
-      return true;
-    if (sw->insert(idx))
-      return true;
-    if (se->insert(idx))
-      return true;
-    return false;
+void generate_random_edges(int node_count, int edge_count, EdgeCSR &csr) {
+  std::vector<Uint32> sources, targets;
+  sources.reserve(edge_count);
+  targets.reserve(edge_count);
+  while ((int)sources.size() < edge_count) {
+    Uint32 s = (Uint32)(rand() % node_count);
+    Uint32 t = (Uint32)(rand() % node_count);
+    if (s == t)
+      continue;
+    sources.push_back(s);
+    targets.push_back(t);
   }
+  csr.assign(node_count, sources.data(), targets.data(), sources.size());
+}
 
-  void query(const Rect &range, std::vector<int> &found) const {
-    if (!boundary.intersects(range))
-      return;
-    if (nw == nullptr) {
-      for (int idx : indices) {
-        float x = nodes_ref[idx].x;
-        float y = nodes_ref[idx].y;
-        if (range.contains(x, y)) {
-          found.push_back(idx);
-        }
-      }
-      return;
+int main(int argc, char **argv) {
+  // A graph file carries its own layout; without one we fall back to a
+  // random scene laid out with OGDF. A paged (.gvp) file is streamed from
+  // disk under a memory budget instead of being loaded.
+  const char *graph_path = NULL;
+  LayoutWorker layout;
+  LayoutCache layout_cache;
+  int render_threads = 0;
+  long page_budget_mb = PAGE_BUDGET_MB;
+  const char *updates_path = NULL;
+  double incremental_ms = 0.0;
+#ifdef PROFILE
+  double trace_seconds = 10.0;
+#endif
+  for (int i = 1; i < argc; ++i) {
+    int parsed = parse_layout_arg(argv[i], layout.options);
+    if (parsed == 0)
+      parsed = parse_cache_arg(argv[i], layout_cache);
+    if (parsed == 0 && strncmp(argv[i], "--render-threads=", 17) == 0) {
+      render_threads = atoi(argv[i] + 17);
+      parsed = render_threads >= 0 ? 1 : -1;
+    }
+    if (parsed == 0 && strncmp(argv[i], "--page-budget=", 14) == 0) {
+      page_budget_mb = atol(argv[i] + 14);
+      parsed = page_budget_mb > 0 ? 1 : -1;
+    }
+    if (parsed == 0 && strncmp(argv[i], "--updates=", 10) == 0) {
+      updates_path = argv[i] + 10;
+      parsed = updates_path[0] ? 1 : -1;
+    }
+    if (parsed == 0 && strncmp(argv[i], "--incremental=", 14) == 0) {
+      incremental_ms = atof(argv[i] + 14);
+      parsed = incremental_ms > 0.0 ? 1 : -1;
     }
-    nw->query(range, found);
-    ne->query(range, found);
-    sw->query(range, found);
-    se->query(range, found);
+#ifdef PROFILE
+    if (parsed == 0 && strncmp(argv[i], "--trace-seconds=", 16) == 0) {
+      trace_seconds = atof(argv[i] + 16);
+      parsed = trace_seconds > 0.0 ? 1 : -1;
+    }
+#endif
+    if (parsed < 0 || (parsed == 0 && (argv[i][0] == '-' || graph_path))) {
+      fprintf(stderr, "usage: %s [options] [graph.gvb|graph.gvp]\n",
+              argv[0]);
+      print_layout_usage(stderr);
+      print_cache_usage(stderr);
+      fprintf(stderr, "  --render-threads=N  node raster threads, 0 = all "
+                      "cores (default), 1 = single-threaded\n");
+      fprintf(stderr, "  --page-budget=MB    page cache size for .gvp "
+                      "files (default %d)\n",
+              PAGE_BUDGET_MB);
+      fprintf(stderr, "  --updates=PATH      apply live updates read from "
+                      "PATH, - for stdin\n");
+      fprintf(stderr, "  --incremental=MS    relax the neighbourhood of "
+                      "live changes for up to MS per frame\n");
+#ifdef PROFILE
+      fprintf(stderr, "  --trace-seconds=N   span of the F4 trace dump "
+                      "(default 10)\n");
+#endif
+      return 2;
+    }
+    if (parsed == 0)
+      graph_path = argv[i];
   }
-};
 
-std::vector<UINode<Uint32>> generate_random_nodes(int count, int max_w,
-                                                  int max_h) {
-  std::vector<UINode<Uint32>> nodes;
-  nodes.reserve(count);
-  for (int i = 0; i < count; ++i) {
-    Uint32 data = (Uint32)rand();
-    float x = (float)(rand() % max_w);
-    float y = (float)(rand() % max_h);
-    float w = 20.0f + (float)(rand() % 80);
-    float h = 20.0f + (float)(rand() % 80);
-    float t = 2.0f + (float)(rand() % 5);
-    Uint8 r = 255;
-    Uint8 g = 255;
-    Uint8 b = 255;
-
-    nodes.push_back({data, x, y, w, h, t, r, g, b, 255, false});
+  size_t path_len = graph_path ? strlen(graph_path) : 0;
+  bool paged =
+      path_len > 4 && strcmp(graph_path + path_len - 4, ".gvp") == 0;
+  GraphFile graph_file;
+  PagedGraph paged_graph;
+  if (paged && !paged_graph.open(graph_path)) {
+    fprintf(stderr, "Failed to load paged graph %s\n", graph_path);
+    return 1;
+  }
+  if (graph_path && !paged && !graph_file.open(graph_path)) {
+    fprintf(stderr, "Failed to load graph file %s\n", graph_path);
+    return 1;
+  }
+  if (paged && updates_path) {
+    fprintf(stderr, "Live updates need the whole graph in memory, not a "
+                    ".gvp file\n");
+    return 2;
   }
-  return nodes;
-}
 
-int main() {
-  assert(SDL_Init(SDL_INIT_VIDEO));
+  if (!SDL_Init(SDL_INIT_VIDEO)) {
+    fprintf(stderr, "SDL_Init failed: %s\n", SDL_GetError());
+    return 1;
+  }
 
   SDL_Window *window =
       SDL_CreateWindow(PROG_NAME, WIDTH, HEIGHT, SDL_WINDOW_RESIZABLE);
-  assert(window);
+  if (!window) {
+    fprintf(stderr, "SDL_CreateWindow failed: %s\n", SDL_GetError());
+    return 1;
+  }
   log("Created: %s %dx%d\n", PROG_NAME, WIDTH, HEIGHT);
 
   SDL_Surface *surface = SDL_GetWindowSurface(window);
-  assert(surface);
+  if (!surface) {
+    fprintf(stderr, "SDL_GetWindowSurface failed: %s\n", SDL_GetError());
+    return 1;
+  }
   do_checks(surface);
 
-  srand((unsigned int)time(NULL));
-  std::vector<UINode<Uint32>> nodes =
-      generate_random_nodes(20000, WIDTH, HEIGHT);
+  NodeStore nodes;
+  EdgeLayer edges;
+  if (paged) {
+    // Filled from the page cache as the view moves.
+  } else if (graph_path) {
+    load_nodes(graph_file.columns, nodes);
+    edges.csr.bind(graph_file.columns);
+  } else {
+    srand((unsigned int)time(NULL));
+    generate_random_nodes(20000, WIDTH, HEIGHT, nodes);
+    generate_random_edges((int)nodes.size(), 20000, edges.csr);
+  }
+  log("Node store: %zu nodes, %zu KiB\n", nodes.size(),
+      nodes.memory_bytes() / 1024);
 
   unsigned char *ttf_buffer = NULL;
-  stbtt_fontinfo font_info;
+  GlyphAtlas font_atlas;
   bool has_font = false;
   FILE *f = fopen("static/Consolas-Regular.ttf", "rb");
   if (f) {
@@ -270,58 +335,59 @@ int main() {
     ttf_buffer = (unsigned char *)malloc(size);
     fread(ttf_buffer, 1, size, f);
     fclose(f);
-    if (stbtt_InitFont(&font_info, ttf_buffer,
-                       stbtt_GetFontOffsetForIndex(ttf_buffer, 0))) {
+    if (font_atlas.init(ttf_buffer)) {
       has_font = true;
     }
   } else {
     log("Failed to load static/Consolas-Regular.ttf\n");
   }
 
-  // Apply OGDF overlap removal layout
-  ogdf::Graph G;
-  ogdf::GraphAttributes GA(G, ogdf::GraphAttributes::nodeGraphics);
-
-  std::vector<ogdf::node> ogdf_nodes;
-  for (size_t i = 0; i < nodes.size(); ++i) {
-    ogdf::node n = G.newNode();
-    GA.x(n) = nodes[i].x;
-    GA.y(n) = nodes[i].y;
-    GA.width(n) = nodes[i].width + nodes[i].border_thickness * 2.0;
-    GA.height(n) = nodes[i].height + nodes[i].border_thickness * 2.0;
-    ogdf_nodes.push_back(n);
-  }
-
-  ogdf::NodeRespecterLayout layout;
-  // Some padding between components
-  layout.setMinDistCC(20.0);
-  layout.call(GA);
-
-  for (size_t i = 0; i < nodes.size(); ++i) {
-    nodes[i].x = GA.x(ogdf_nodes[i]);
-    nodes[i].y = GA.y(ogdf_nodes[i]);
+  // Layouts and indexes of graph files are cached on disk; the generated
+  // scene is different every run.
+  if (graph_path && !paged)
+    layout_cache.open();
+  SpatialIndex index;
+  build_index(nodes, index, layout_cache);
+  SearchIndex search;
+  search.build(nodes);
+  PrefixSearch prefix;
+  edges.rebuild(nodes);
+  // Only the pyramid covers pages that are not resident; the hierarchy
+  // needs the whole graph.
+  DensityPyramid pyramid;
+  GraphHierarchy hierarchy;
+  OverviewWorker overviews;
+  PageCache pages;
+  if (paged) {
+    paged_graph.load_pyramid(pyramid);
+    pages.start(paged_graph, (size_t)page_budget_mb << 20);
+  } else {
+    pyramid.build(nodes);
+    hierarchy.build(nodes, edges.csr);
   }
+  TileRenderer renderer(render_threads);
+  LabelLayer labels;
+  SceneState scene;
 
-  // Populate Quadtree for spatial querying
-  float min_x = 0, min_y = 0, max_x = WIDTH, max_y = HEIGHT;
-  for (const auto &n : nodes) {
-    min_x = n.x < min_x ? n.x : min_x;
-    min_y = n.y < min_y ? n.y : min_y;
-    max_x = n.x > max_x ? n.x : max_x;
-    max_y = n.y > max_y ? n.y : max_y;
-  }
-  QuadTree qtree({min_x - 100, min_y - 100, max_x + 100, max_y + 100}, nodes);
-  for (size_t i = 0; i < nodes.size(); ++i) {
-    qtree.insert((int)i);
-  }
+  // The generated scene is browsable right away and refined by the selected
+  // OGDF layout in the background. Graph files already carry a layout.
+  LayoutSnapshot layout_snapshot;
+  Uint64 layout_key = 0;
+  if (!graph_path)
+    layout.start(nodes, edges.csr);
 
   bool quit = false;
   float pan_x = 0.0f;
   float pan_y = 0.0f;
   float zoom = 1.0f;
-  bool is_dragging = false;
-  bool has_selection = false;
-  Uint32 selected_data = 0;
+  // A plain drag pans; Shift+drag selects with a rubber band and Ctrl+drag
+  // with a lasso, both tracked in screen coordinates until released.
+  enum { DRAG_NONE, DRAG_PAN, DRAG_BOX, DRAG_LASSO } drag_mode = DRAG_NONE;
+  float drag_x = 0.0f, drag_y = 0.0f; // motion not yet applied to the pan
+  bool drag_moved = false;
+  float press_x = 0.0f, press_y = 0.0f, cursor_x = 0.0f, cursor_y = 0.0f;
+  std::vector<float> lasso_x, lasso_y;
+  int palette_next = 0;
 
   bool is_searching = false;
   char search_buffer[32] = {0};
@@ -331,14 +397,146 @@ int main() {
   Uint32 frame_count = 0;
   Uint32 last_time = SDL_GetTicks();
   Uint32 current_fps = 0;
+#ifdef PROFILE
+  // F3 swaps the FPS counter for the profiler overlay, F4 writes a trace.
+  bool show_profiler = false;
+#endif
+
+  // Frames are only drawn when something changed, and then only the parts
+  // of the screen that did.
+  Damage damage;
+  std::vector<OverlayWidget> overlay, last_overlay;
+  auto damage_selection = [&]() {
+    if (nodes.selection.size() > SELECTION_DAMAGE_LIMIT) {
+      damage.add_all();
+      return;
+    }
+    for (int i : nodes.selection.active)
+      damage.add(node_screen_rect(nodes, i, pan_x, pan_y, zoom));
+  };
+  // Paged graphs also keep the selection of nodes whose page is unloaded.
+  auto clear_selection = [&]() {
+    nodes.selection.clear();
+    pages.away_selected.clear();
+  };
+  // The node under the cursor is outlined; hovering repaints only the old
+  // and the new node.
+  int hovered = -1;
+  auto pick_at = [&](float mx, float my) {
+    return index.pick(mx / zoom - pan_x, my / zoom - pan_y,
+                      PICK_RADIUS / zoom);
+  };
+  auto set_hovered = [&](int i) {
+    if (i == hovered)
+      return;
+    if (hovered >= 0)
+      damage.add(node_screen_rect(nodes, hovered, pan_x, pan_y, zoom));
+    hovered = i;
+    if (hovered >= 0)
+      damage.add(node_screen_rect(nodes, hovered, pan_x, pan_y, zoom));
+  };
+  auto damage_band = [&]() {
+    damage.add(segment_screen_rect(press_x, press_y, cursor_x, press_y));
+    damage.add(segment_screen_rect(press_x, cursor_y, cursor_x, cursor_y));
+    damage.add(segment_screen_rect(press_x, press_y, press_x, cursor_y));
+    damage.add(segment_screen_rect(cursor_x, press_y, cursor_x, cursor_y));
+  };
+  auto damage_lasso = [&]() {
+    for (size_t k = 1; k < lasso_x.size(); ++k)
+      damage.add(segment_screen_rect(lasso_x[k - 1], lasso_y[k - 1],
+                                     lasso_x[k], lasso_y[k]));
+  };
+  // Hidden nodes drop out of the index queries at once, but the density
+  // pyramid, the hierarchy and the edge density grid count them and are
+  // rebuilt, the hierarchy in the background.
+  auto hidden_changed = [&]() {
+    if (!paged) {
+      pyramid.build(nodes);
+      overviews.hidden_changed();
+      overviews.start(nodes, edges, false);
+    }
+    edges.hidden_changed();
+    labels.clear();
+    hovered = -1;
+    damage.add_all();
+  };
+  // A relayout that ran to completion before from the same positions is
+  // read back from the cache instead.
+  auto start_layout = [&]() {
+    // The layout sees live edge edits only once they are folded in.
+    if (edges.pending_edits())
+      edges.rebuild(nodes);
+    layout_key = layout_cache_key(nodes, edges.csr, layout.options.engine);
+    LayoutSnapshot cached;
+    cached.x.resize(nodes.size());
+    cached.y.resize(nodes.size());
+    if (layout_cache.load_positions(layout_key, nodes.size(),
+                                    cached.x.data(), cached.y.data())) {
+      cached.round = cached.rounds = 1;
+      apply_layout_snapshot(cached, nodes, index, edges, pyramid, hierarchy,
+                            overviews, layout_cache);
+      damage.add_all();
+    } else {
+      layout.start(nodes, edges.csr);
+    }
+  };
+  // Search results follow the nodes it was rebuilt over; a search in
+  // progress is replayed against the new index.
+  auto replay_search = [&]() {
+    if (is_searching) {
+      prefix.reset(search);
+      for (int k = 0; k < search_len; ++k)
+        prefix.push(search, search_buffer[k] - '0');
+    }
+  };
+  auto rebuild_search = [&]() {
+    search.build(nodes);
+    replay_search();
+  };
+
+  GraphStream stream;
+  UpdateStats update_stats;
+  update_stats.track_changes = incremental_ms > 0.0;
+  IncrementalOptions incremental;
+  incremental.budget_ms = incremental_ms;
+  std::vector<int> relaid;
+  std::vector<GraphUpdate> update_batch(UPDATE_BATCH);
+  bool overview_stale = false;
+  bool search_stale = false;
+  Uint32 overview_time = 0;
+  if (updates_path)
+    stream.open(updates_path);
 
   while (!quit) {
+    // With nothing to repaint, sleep until the next event or until the
+    // layout, the FPS meter or the NOT FOUND banner are due to change.
+    SDL_Event event;
+    bool pending;
+    if (damage.empty()) {
+      Uint32 now = SDL_GetTicks();
+      bool busy = layout.busy() || overviews.running() || pages.loading() ||
+                  stream.active();
+      Sint32 timeout = busy ? 16 : -1;
+      if (search_failed_time > 0)
+        timeout = sooner(timeout, search_failed_time + 2000, now);
+      if (current_fps > 0 || frame_count > 0)
+        timeout = sooner(timeout, last_time + 1001, now);
+      pending = timeout < 0 ? SDL_WaitEvent(&event)
+                            : SDL_WaitEventTimeout(&event, timeout);
+    } else {
+      pending = SDL_PollEvent(&event);
+    }
     Uint32 frame_start = SDL_GetTicks();
+    PROFILE_MARK(profile_frame_start);
 
-    SDL_Event event;
-    while (SDL_PollEvent(&event)) {
+    PROFILE_MARK(events_start);
+    for (; pending; pending = SDL_PollEvent(&event)) {
       if (event.type == SDL_EVENT_QUIT) {
         quit = true;
+      } else if (event.type == SDL_EVENT_WINDOW_EXPOSED) {
+        damage.add_all();
+      } else if (event.type == SDL_EVENT_WINDOW_MOUSE_LEAVE) {
+        set_hovered(-1);
       } else if (event.type == SDL_EVENT_MOUSE_WHEEL) {
         if (event.wheel.y > 0)
           zoom *= 1.1f;
@@ -349,6 +547,7 @@ int main() {
           zoom = 0.1f;
         if (zoom > 10.0f)
           zoom = 10.0f;
+        damage.add_all();
       } else if (event.type == SDL_EVENT_MOUSE_BUTTON_DOWN) {
         if (event.button.button == SDL_BUTTON_LEFT) {
           float mx = event.button.x;
@@ -363,94 +562,151 @@ int main() {
             is_searching = true;
             search_len = 0;
             search_buffer[0] = '\0';
+            prefix.reset(search);
           } else if (mx >= reset_btn.x && mx <= reset_btn.x + reset_btn.w &&
                      my >= reset_btn.y && my <= reset_btn.y + reset_btn.h) {
             zoom = 1.0f;
             pan_x = 0.0f;
             pan_y = 0.0f;
+            damage.add_all();
+          } else if (SDL_GetModState() & (SDL_KMOD_SHIFT | SDL_KMOD_CTRL)) {
+            drag_mode =
+                (SDL_GetModState() & SDL_KMOD_SHIFT) ? DRAG_BOX : DRAG_LASSO;
+            press_x = cursor_x = mx;
+            press_y = cursor_y = my;
+            lasso_x.assign(1, mx);
+            lasso_y.assign(1, my);
           } else {
-            is_dragging = true;
-            bool clicked_on_node = false;
-
-            float click_orig_x = (mx / zoom) - pan_x;
-            float click_orig_y = (my / zoom) - pan_y;
-            std::vector<int> hit_candidates;
-            float search_pad = 200.0f; // maximum width of node / zoom
-            qtree.query({click_orig_x - search_pad, click_orig_y - search_pad,
-                         click_orig_x + search_pad, click_orig_y + search_pad},
-                        hit_candidates);
-
-            for (int i : hit_candidates) {
-              float scaled_x = (nodes[i].x + pan_x) * zoom;
-              float scaled_y = (nodes[i].y + pan_y) * zoom;
-              float scaled_w = nodes[i].width * zoom;
-              float scaled_h = nodes[i].height * zoom;
-
-              float hw = scaled_w / 2.0f;
-              float hh = scaled_h / 2.0f;
-
-              if (mx >= scaled_x - hw && mx <= scaled_x + hw &&
-                  my >= scaled_y - hh && my <= scaled_y + hh) {
-
-                for (auto &n : nodes)
-                  n.selected = false;
-                nodes[i].selected = true;
-                clicked_on_node = true;
-                has_selection = true;
-                selected_data = nodes[i].data;
-                break;
-              }
-            }
-
-            if (!clicked_on_node) {
-              for (auto &n : nodes)
-                n.selected = false;
-              has_selection = false;
-            }
+            drag_mode = DRAG_PAN;
+            drag_x = drag_y = 0.0f;
+
+            // The old selection is repainted unselected, the new one
+            // selected.
+            damage_selection();
+            clear_selection();
+            int hit = pick_at(mx, my);
+            if (hit >= 0)
+              nodes.selection.add(hit);
+            damage_selection();
           } // end else for search button click
         }
       } else if (event.type == SDL_EVENT_MOUSE_BUTTON_UP) {
-        if (event.button.button == SDL_BUTTON_LEFT)
-          is_dragging = false;
+        if (event.button.button == SDL_BUTTON_LEFT &&
+            (drag_mode == DRAG_BOX || drag_mode == DRAG_LASSO)) {
+          // Nodes whose centers fall in the region replace the selection.
+          std::vector<int> found;
+          if (drag_mode == DRAG_BOX) {
+            damage_band();
+            Rect box = {SDL_min(press_x, cursor_x) / zoom - pan_x,
+                        SDL_min(press_y, cursor_y) / zoom - pan_y,
+                        SDL_max(press_x, cursor_x) / zoom - pan_x,
+                        SDL_max(press_y, cursor_y) / zoom - pan_y};
+            query_box(nodes, index, box, found);
+          } else {
+            damage_lasso();
+            for (size_t k = 0; k < lasso_x.size(); ++k) {
+              lasso_x[k] = lasso_x[k] / zoom - pan_x;
+              lasso_y[k] = lasso_y[k] / zoom - pan_y;
+            }
+            query_polygon(nodes, index, lasso_x.data(), lasso_y.data(),
+                          (int)lasso_x.size(), found);
+            lasso_x.clear();
+            lasso_y.clear();
+          }
+          damage_selection();
+          clear_selection();
+          select_nodes(nodes, found);
+          damage_selection();
+          drag_mode = DRAG_NONE;
+        } else if (event.button.button == SDL_BUTTON_LEFT) {
+          drag_mode = DRAG_NONE;
+          // Labels and drawing modes are only picked on full repaints, so
+          // the view is settled with one once the drag ends.
+          if (drag_moved)
+            damage.add_all();
+          drag_moved = false;
+        }
       } else if (event.type == SDL_EVENT_MOUSE_MOTION) {
-        if (is_dragging) {
-          pan_x += event.motion.xrel / zoom;
-          pan_y += event.motion.yrel / zoom;
+        if (drag_mode == DRAG_BOX) {
+          damage_band();
+          cursor_x = event.motion.x;
+          cursor_y = event.motion.y;
+          damage_band();
+        } else if (drag_mode == DRAG_LASSO) {
+          float dx = event.motion.x - lasso_x.back();
+          float dy = event.motion.y - lasso_y.back();
+          if (dx * dx + dy * dy >= LASSO_STEP * LASSO_STEP) {
+            damage.add(segment_screen_rect(lasso_x.back(), lasso_y.back(),
+                                           event.motion.x, event.motion.y));
+            lasso_x.push_back(event.motion.x);
+            lasso_y.push_back(event.motion.y);
+          }
+        } else if (drag_mode == DRAG_NONE) {
+          set_hovered(pick_at(event.motion.x, event.motion.y));
+        } else if (drag_mode == DRAG_PAN) {
+          // The pan moves in whole pixels, so the last frame can be
+          // scrolled instead of redrawn; the remainder carries over.
+          drag_x += event.motion.xrel;
+          drag_y += event.motion.yrel;
+          int dx = (int)drag_x, dy = (int)drag_y;
+          drag_x -= dx;
+          drag_y -= dy;
+          if (dx || dy) {
+            pan_x += dx / zoom;
+            pan_y += dy / zoom;
+            damage.scroll(dx, dy);
+            drag_moved = true;
+          }
         }
       } else if (event.type == SDL_EVENT_KEY_DOWN) {
         if (event.key.key == SDLK_F && (event.key.mod & SDL_KMOD_CTRL)) {
           is_searching = true;
           search_len = 0;
           search_buffer[0] = '\0';
+          prefix.reset(search);
+        } else if (event.key.key == SDLK_L &&
+                   (event.key.mod & SDL_KMOD_CTRL)) {
+          // Ctrl+L cancels a running layout or restarts it from the
+          // current positions.
+          if (layout.running())
+            layout.cancel();
+          else if (!paged)
+            start_layout();
+#ifdef PROFILE
+        } else if (event.key.key == SDLK_F3) {
+          show_profiler = !show_profiler;
+          SDL_Surface *s = SDL_GetWindowSurface(window);
+          if (s)
+            damage.add(profiler.overlay_rect(s));
+        } else if (event.key.key == SDLK_F4) {
+          profiler.write_trace(TRACE_PATH, trace_seconds);
+#endif
         } else if (is_searching) {
           if (event.key.key == SDLK_ESCAPE) {
             is_searching = false;
           } else if (event.key.key == SDLK_BACKSPACE && search_len > 0) {
             search_len--;
             search_buffer[search_len] = '\0';
+            prefix.pop();
           } else if (event.key.key == SDLK_RETURN ||
                      event.key.key == SDLK_KP_ENTER) {
             if (search_len > 0) {
-              Uint32 target_data = (Uint32)atol(search_buffer);
-              bool found = false;
-              for (int i = 0; i < (int)nodes.size(); ++i) {
-                if (nodes[i].data == target_data) {
-                  for (auto &n : nodes)
-                    n.selected = false;
-                  nodes[i].selected = true;
-                  has_selection = true;
-                  selected_data = nodes[i].data;
-                  SDL_Surface *s = SDL_GetWindowSurface(window);
-                  float hw = s ? s->w / 2.0f : WIDTH / 2.0f;
-                  float hh = s ? s->h / 2.0f : HEIGHT / 2.0f;
-                  pan_x = -nodes[i].x + hw / zoom;
-                  pan_y = -nodes[i].y + hh / zoom;
-                  found = true;
-                  break;
-                }
-              }
-              if (!found) {
-                log("Node with data %u not found\n", target_data);
+              unsigned long long value = strtoull(search_buffer, NULL, 10);
+              Uint32 target_data = (Uint32)value;
+              int i = value <= 0xFFFFFFFFull
+                          ? search.find_visible(target_data)
+                          : -1;
+              if (i >= 0) {
+                clear_selection();
+                nodes.selection.add(i);
+                SDL_Surface *s = SDL_GetWindowSurface(window);
+                float hw = s ? s->w / 2.0f : WIDTH / 2.0f;
+                float hh = s ? s->h / 2.0f : HEIGHT / 2.0f;
+                pan_x = -nodes.x[i] + hw / zoom;
+                pan_y = -nodes.y[i] + hh / zoom;
+                damage.add_all();
+              } else {
+                log("Node with data %s not found\n", search_buffer);
                 search_failed_time = SDL_GetTicks();
               }
             }
@@ -459,74 +715,364 @@ int main() {
                      search_len < 31) {
             search_buffer[search_len++] = '0' + (event.key.key - SDLK_0);
             search_buffer[search_len] = '\0';
+            prefix.push(search, (int)(event.key.key - SDLK_0));
           } else if (event.key.key >= SDLK_KP_0 && event.key.key <= SDLK_KP_9 &&
                      search_len < 31) {
             search_buffer[search_len++] = '0' + (event.key.key - SDLK_KP_0);
             search_buffer[search_len] = '\0';
+            prefix.push(search, (int)(event.key.key - SDLK_KP_0));
+          }
+        } else if (event.key.key == SDLK_ESCAPE) {
+          damage_selection();
+          clear_selection();
+        } else if (event.key.key == SDLK_C && !nodes.selection.empty()) {
+          recolor_selection(nodes, selection_palette[palette_next]);
+          int colors = (int)SDL_arraysize(selection_palette);
+          palette_next = (palette_next + 1) % colors;
+          // Super-nodes take on the average of the new colors.
+          if (!paged) {
+            pyramid.build(nodes);
+            hierarchy.refit(nodes);
+          }
+          damage_selection();
+        } else if (event.key.key == SDLK_H) {
+          if (event.key.mod & SDL_KMOD_SHIFT) {
+            show_all(nodes);
+            pages.away_hidden.clear();
+            hidden_changed();
+          } else if (!nodes.selection.empty() ||
+                     !pages.away_selected.empty()) {
+            hide_selection(nodes);
+            pages.away_hidden.insert(pages.away_hidden.end(),
+                                     pages.away_selected.begin(),
+                                     pages.away_selected.end());
+            pages.away_selected.clear();
+            hidden_changed();
+          }
+        } else if (event.key.key == SDLK_E && !nodes.selection.empty()) {
+          if (export_selection(nodes, SELECTION_PATH))
+            log("Exported %zu nodes to %s\n", nodes.selection.size(),
+                SELECTION_PATH);
+        } else if (event.key.key == SDLK_F) {
+          // Frames the selection with a margin, within the zoom limits.
+          Rect bounds;
+          SDL_Surface *s = SDL_GetWindowSurface(window);
+          if (s && selection_bounds(nodes, bounds)) {
+            float w = SDL_max(bounds.x2 - bounds.x1, 1.0f) * 1.2f;
+            float h = SDL_max(bounds.y2 - bounds.y1, 1.0f) * 1.2f;
+            zoom = SDL_clamp(SDL_min(s->w / w, s->h / h), 0.1f, 10.0f);
+            pan_x = s->w / (2.0f * zoom) - (bounds.x1 + bounds.x2) / 2.0f;
+            pan_y = s->h / (2.0f * zoom) - (bounds.y1 + bounds.y2) / 2.0f;
+            damage.add_all();
           }
         }
       }
     }
 
+    // Live updates take node positions over from a running layout. The
+    // index, the edges and the density pyramid follow every batch; the
+    // hierarchy and search catch up on their own schedule.
+    if (stream.active()) {
+      Uint64 updates_start = SDL_GetTicksNS();
+      size_t got;
+      while ((got = stream.poll(update_batch.data(), UPDATE_BATCH)) > 0) {
+        if (layout.running()) {
+          layout.cancel();
+          log("Layout cancelled by live updates\n");
+        }
+        Uint64 added_before = update_stats.nodes_added;
+        Uint64 removed_before = update_stats.nodes_removed;
+        apply_updates(update_batch.data(), got, nodes, index, edges,
+                      update_stats, &pyramid);
+        for (size_t k = 0; k < got; ++k) {
+          UpdateKind kind = update_batch[k].kind;
+          if (kind == UPDATE_REMOVE_NODE || kind == UPDATE_MOVE_NODE ||
+              kind == UPDATE_COLOR_NODE)
+            overviews.node_changed((int)update_batch[k].node);
+        }
+        search_stale |= update_stats.nodes_added != added_before ||
+                        update_stats.nodes_removed != removed_before;
+        overview_stale = true;
+        damage.add_all();
+        if (SDL_GetTicksNS() - updates_start >
+            (Uint64)UPDATE_BUDGET_MS * 1000000)
+          break;
+      }
+      // The neighbourhood of what changed this frame settles around it.
+      if (!update_stats.placed.empty() || !update_stats.moved.empty()) {
+        relaid.clear();
+        relayout_incremental(nodes, index, edges, update_stats.placed,
+                             update_stats.moved, incremental, relaid,
+                             &pyramid);
+        for (int i : relaid) {
+          index.update(i);
+          edges.node_moved(i);
+          overviews.node_changed(i);
+        }
+        update_stats.placed.clear();
+        update_stats.moved.clear();
+      }
+      if (hovered >= 0 && nodes.removed.contains(hovered))
+        hovered = -1;
+      if (edges.edits_due())
+        edges.rebuild(nodes);
+      if (index.worn())
+        index.build(nodes);
+      // Once the stream ends everything is brought up to date.
+      bool drained = stream.drained();
+      if (drained && edges.pending_edits())
+        edges.rebuild(nodes);
+      Uint32 now = SDL_GetTicks();
+      if (drained)
+        pyramid.build(nodes);
+      if (overview_stale &&
+          (drained || now - overview_time >= OVERVIEW_REFRESH_MS)) {
+        overviews.start(nodes, edges, search_stale);
+        overview_stale = search_stale = false;
+        overview_time = now;
+        damage.add_all();
+      }
+      if (drained) {
+        log("Applied %llu live updates, dropped %llu\n",
+            (unsigned long long)update_stats.applied,
+            (unsigned long long)update_stats.dropped);
+        stream.close();
+      }
+    }
+
+    PROFILE_SINCE(PROFILE_EVENTS, events_start);
+
+    // A round finished before live updates added nodes no longer fits.
+    if (layout.poll(layout_snapshot) &&
+        layout_snapshot.x.size() == nodes.size()) {
+      PROFILE_SCOPE(PROFILE_LAYOUT);
+      apply_layout_snapshot(layout_snapshot, nodes, index, edges, pyramid,
+                            hierarchy, overviews, layout_cache);
+      if (layout_snapshot.round == layout_snapshot.rounds)
+        layout_cache.store_positions(layout_key, nodes.size(),
+                                     nodes.x.data(), nodes.y.data());
+      damage.add_all();
+    }
+    bool searched;
+    if (overviews.poll(nodes, edges, hierarchy, search, searched)) {
+      if (searched)
+        replay_search();
+      damage.add_all();
+    }
+
+    Uint32 current_time = SDL_GetTicks();
+    if (current_time > last_time + 1000) {
+      current_fps = frame_count;
+      frame_count = 0;
+      last_time = current_time;
+    }
+    if (search_failed_time > 0 && current_time - search_failed_time >= 2000)
+      search_failed_time = 0;
+
     surface = SDL_GetWindowSurface(window);
     if (surface) {
-      SDL_FillSurfaceRect(surface, NULL, 0); // Clear to black
       do_checks(surface);
-      draw(surface, nodes, qtree, pan_x, pan_y, zoom);
+      damage.resize(surface->w, surface->h);
+
+      // Paged graphs swap the nodes in view in and out as it moves; search
+      // covers the nodes currently loaded.
+      Rect view = {-pan_x, -pan_y, -pan_x + surface->w / zoom,
+                   -pan_y + surface->h / zoom};
+      if (paged && pages.update(view, nodes, index)) {
+        rebuild_search();
+        labels.clear();
+        hovered = -1;
+        damage.add_all();
+      }
+
+      // Panning moves the last frame in place. The strips scrolled in, and
+      // the widgets both where they were carried to and where they belong,
+      // are all that is repainted.
+      bool scrolled = damage.scrolled();
+      if (scrolled) {
+        scroll_surface(surface, damage.scroll_x, damage.scroll_y);
+        labels.shift(damage.scroll_x, damage.scroll_y);
+        for (const OverlayWidget &w : last_overlay) {
+          SDL_Rect moved = {w.rect.x + damage.scroll_x,
+                            w.rect.y + damage.scroll_y, w.rect.w, w.rect.h};
+          damage.add(moved);
+          damage.add(w.rect);
+        }
+      }
 
       const SDL_PixelFormatDetails *format =
           SDL_GetPixelFormatDetails(surface->format);
       Uint32 bg_color = SDL_MapRGB(format, NULL, 50, 50, 50);
       Uint32 fg_color = SDL_MapRGB(format, NULL, 255, 255, 255);
       Uint32 active_bg = SDL_MapRGB(format, NULL, 80, 150, 80);
-
-      if (has_selection) {
+      Uint32 band_color = SDL_MapRGB(format, NULL, 255, 200, 0);
+      Uint32 hover_color = SDL_MapRGB(format, NULL, 0, 200, 255);
+
+      // Lay out this frame's widgets; they are drawn after the scene.
+      overlay.clear();
+      auto add_widget = [&](int x, int y, const char *text, Uint32 bg,
+                            bool bitmap) {
+        OverlayWidget w;
+        snprintf(w.text, sizeof(w.text), "%s", text);
+        w.x = x;
+        w.y = y;
+        w.bg = bg;
+        w.bitmap = bitmap || !has_font;
+        w.meter = false;
+        w.rect = w.bitmap ? measure_string_widget(x, y, w.text)
+                          : measure_ttf_widget(x, y, w.text, &font_atlas);
+        overlay.push_back(w);
+      };
+
+      if (nodes.selection.size() == 1) {
         char buf[32];
-        snprintf(buf, sizeof(buf), "%u", selected_data);
-        draw_ui_widget(surface, 10, 10, buf, has_font ? &font_info : NULL,
-                       bg_color, fg_color);
+        snprintf(buf, sizeof(buf), "%u", nodes.data[nodes.selection.active[0]]);
+        add_widget(10, 10, buf, bg_color, false);
+      } else if (nodes.selection.size() > 1) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%zu SELECTED", nodes.selection.size());
+        add_widget(10, 10, buf, bg_color, false);
       }
 
-      // Draw Find button
-      draw_ui_widget(surface, surface->w / 2 - 40, 10, "FIND",
-                     has_font ? &font_info : NULL,
-                     is_searching ? active_bg : bg_color, fg_color);
-
-      // Draw Reset button
-      draw_ui_widget(surface, surface->w / 2 + 50, 10, "RESET",
-                     has_font ? &font_info : NULL, bg_color, fg_color);
+      // Find and Reset buttons
+      add_widget(surface->w / 2 - 40, 10, "FIND",
+                 is_searching ? active_bg : bg_color, false);
+      add_widget(surface->w / 2 + 50, 10, "RESET", bg_color, false);
 
       if (is_searching) {
         char input_buf[64];
         snprintf(input_buf, sizeof(input_buf), "INPUT: %s", search_buffer);
-        draw_ui_widget(surface, surface->w / 2 - (10 * 4 * 4), 60, input_buf,
-                       has_font ? &font_info : NULL, active_bg, fg_color);
-      } else if (search_failed_time > 0) {
-        if (SDL_GetTicks() - search_failed_time < 2000) {
-          Uint32 error_bg = SDL_MapRGB(format, NULL, 180, 50, 50);
-          draw_ui_widget(surface, surface->w / 2 - (9 * 4 * 4 / 2), 60,
-                         "NOT FOUND", has_font ? &font_info : NULL, error_bg,
-                         fg_color);
-        } else {
-          search_failed_time = 0;
+        add_widget(surface->w / 2 - (10 * 4 * 4), 60, input_buf, active_bg,
+                   false);
+
+        // Live match count and the smallest matching values, both read
+        // from the prefix runs narrowed on each keystroke.
+        if (search_len > 0) {
+          char count_buf[32];
+          snprintf(count_buf, sizeof(count_buf), "FOUND: %llu",
+                   (unsigned long long)prefix.count());
+          add_widget(surface->w / 2 - (10 * 4 * 4), 110, count_buf, bg_color,
+                     false);
+          int candidates[5];
+          int shown = prefix.top(search, candidates, 5);
+          for (int k = 0; k < shown; ++k) {
+            char candidate_buf[16];
+            snprintf(candidate_buf, sizeof(candidate_buf), "%u",
+                     nodes.data[candidates[k]]);
+            add_widget(surface->w / 2 - (10 * 4 * 4), 160 + 50 * k,
+                       candidate_buf, bg_color, false);
+          }
         }
+      } else if (search_failed_time > 0) {
+        Uint32 error_bg = SDL_MapRGB(format, NULL, 180, 50, 50);
+        add_widget(surface->w / 2 - (9 * 4 * 4 / 2), 60, "NOT FOUND",
+                   error_bg, false);
+      }
+
+      if (layout.running()) {
+        char layout_buf[32];
+        snprintf(layout_buf, sizeof(layout_buf), "LAYOUT %d/%d",
+                 layout.rounds_done(), layout.rounds_total);
+        add_widget(10, surface->h - 60, layout_buf, bg_color, false);
       }
 
-      frame_count++;
-      Uint32 current_time = SDL_GetTicks();
-      if (current_time > last_time + 1000) {
-        current_fps = frame_count;
-        frame_count = 0;
-        last_time = current_time;
+      // FPS meter in top right, counting presented frames
+      bool show_fps = true;
+#ifdef PROFILE
+      show_fps = !show_profiler;
+#endif
+      if (show_fps) {
+        char fps_buf[16];
+        snprintf(fps_buf, sizeof(fps_buf), "%u", current_fps);
+        add_widget(surface->w - 80, 10, fps_buf, bg_color, true);
+        overlay.back().meter = true;
       }
 
-      // Render FPS meter in top right
-      char fps_buf[16];
-      snprintf(fps_buf, sizeof(fps_buf), "%u", current_fps);
-      draw_string_widget(surface, surface->w - 80, 10, fps_buf, bg_color,
-                         fg_color);
+      // A present that only updates the meter is not counted, or an idle
+      // window would keep waking up to show its own repaints.
+      bool counted = !damage.empty();
+      counted = damage_overlay(last_overlay, overlay, damage) || counted;
+      last_overlay.swap(overlay);
+#ifdef PROFILE
+      // The profiler overlay shows the frames before this one, so it is
+      // refreshed whenever anything else is drawn.
+      if (show_profiler && !damage.empty())
+        damage.add(profiler.overlay_rect(surface));
+#endif
 
-      SDL_UpdateWindowSurface(window);
+      if (!damage.empty()) {
+        const std::vector<SDL_Rect> &regions = damage.regions();
+        for (const SDL_Rect &region : regions) {
+          SDL_FillSurfaceRect(surface, &region, 0); // Clear to black
+          if (paged && pages.overview)
+            pyramid.render(surface, nodes, pan_x, pan_y, zoom, region);
+          else
+            draw(surface, nodes, index, edges, renderer, pyramid, hierarchy,
+                 labels, scene, has_font ? &font_atlas : NULL, pan_x, pan_y,
+                 zoom, region);
+          if (drag_mode == DRAG_BOX) {
+            draw_line(surface, press_x, press_y, cursor_x, press_y,
+                      band_color, &region);
+            draw_line(surface, press_x, cursor_y, cursor_x, cursor_y,
+                      band_color, &region);
+            draw_line(surface, press_x, press_y, press_x, cursor_y,
+                      band_color, &region);
+            draw_line(surface, cursor_x, press_y, cursor_x, cursor_y,
+                      band_color, &region);
+          } else if (drag_mode == DRAG_LASSO) {
+            for (size_t k = 1; k < lasso_x.size(); ++k)
+              draw_line(surface, lasso_x[k - 1], lasso_y[k - 1], lasso_x[k],
+                        lasso_y[k], band_color, &region);
+          }
+          if (hovered >= 0) {
+            // One pixel outside the node, inside node_screen_rect().
+            Rect box = nodes.box(hovered);
+            float x1 = (box.x1 + pan_x) * zoom - 1.0f;
+            float y1 = (box.y1 + pan_y) * zoom - 1.0f;
+            float x2 = (box.x2 + pan_x) * zoom + 1.0f;
+            float y2 = (box.y2 + pan_y) * zoom + 1.0f;
+            draw_line(surface, x1, y1, x2, y1, hover_color, &region);
+            draw_line(surface, x1, y2, x2, y2, hover_color, &region);
+            draw_line(surface, x1, y1, x1, y2, hover_color, &region);
+            draw_line(surface, x2, y1, x2, y2, hover_color, &region);
+          }
+        }
+        // Widgets are opaque, so one touching a region is redrawn whole;
+        // the pixels it writes outside the regions are unchanged.
+        PROFILE_MARK(widgets_start);
+        for (const OverlayWidget &w : last_overlay) {
+          bool touched = false;
+          for (const SDL_Rect &region : regions)
+            touched = touched || SDL_HasRectIntersection(&w.rect, &region);
+          if (!touched)
+            continue;
+          if (w.bitmap)
+            draw_string_widget(surface, w.x, w.y, w.text, w.bg, fg_color);
+          else
+            draw_ttf_widget(surface, w.x, w.y, w.text, &font_atlas, w.bg,
+                            fg_color);
+        }
+#ifdef PROFILE
+        if (show_profiler)
+          profiler.draw_overlay(surface, has_font ? &font_atlas : NULL);
+#endif
+        PROFILE_SINCE(PROFILE_WIDGETS, widgets_start);
+
+        PROFILE_MARK(present_start);
+        if (damage.whole || scrolled)
+          SDL_UpdateWindowSurface(window);
+        else
+          SDL_UpdateWindowSurfaceRects(window, regions.data(),
+                                       (int)regions.size());
+        PROFILE_SINCE(PROFILE_PRESENT, present_start);
+        damage.clear();
+        if (counted)
+          frame_count++;
+#ifdef PROFILE
+        PROFILE_SINCE(PROFILE_FRAME, profile_frame_start);
+        profiler.end_frame(profile_frame_start);
+#endif
+      }
     }
 
     Uint32 frame_time = SDL_GetTicks() - frame_start;
@@ -535,6 +1081,8 @@ int main() {
     }
   }
 
+  layout.cancel();
+  pages.stop();
   if (ttf_buffer)
     free(ttf_buffer);
 
@@ -548,266 +1096,13 @@ void do_checks(SDL_Surface *surface) {
       SDL_GetPixelFormatDetails(surface->format);
   assert_eq(pixel_details->bytes_per_pixel, 4, "%d\n",
             pixel_details->bytes_per_pixel);
+  // Other 32-bit formats still draw correctly, one SDL call per pixel in
+  // the few places that write unmapped colors.
+  if (!with_pixel_layout(surface->format, [](auto) {}))
+    log_once("No pixel layout for %s, using SDL pixel calls\n",
+             SDL_GetPixelFormatName(surface->format));
   // log("PixelFormat: %s : %d\n", SDL_GetPixelFormatName(surface->format),
   //     SDL_BITSPERPIXEL(surface->format));
   // log("Surface: w:%d h:%d\n", surface->w, surface->h);
   return;
 }
-
-void draw(SDL_Surface *surface, const std::vector<UINode<Uint32>> &nodes,
-          const QuadTree &qtree, float pan_x, float pan_y, float zoom) {
-#if 0
-#ifndef DEBUG
-  void *pixels = surface->pixels;
-  SDL_PixelFormatDetails const *pixel_details =
-      SDL_GetPixelFormatDetails(surface->format);
-  Sint32 stride = pixel_details->bytes_per_pixel;
-#endif
-  for (int y = 0; y < surface->h; ++y) {
-    for (int x = 0; x < surface->w; ++x) {
-      Uint8 val = ((x / 32) + (y / 32)) % 2 == 0 ? 0xFF : 0x00;
-#ifndef DEBUG
-      Uint8 *target_pixel =
-          ((Uint8 *)pixels + (y * surface->pitch) + (x * stride));
-      target_pixel[0] = val;
-      target_pixel[1] = val;
-      target_pixel[2] = val;
-#else
-      log_once("Using SDL api for filling\n");
-      SDL_WriteSurfacePixel(surface, x, y, val, val, val, 0xff);
-#endif
-    }
-  }
-#endif
-
-  float max_w = 200.0f; // Padding larger than max expected node size
-  float orig_x1 = -pan_x - (max_w / zoom);
-  float orig_y1 = -pan_y - (max_w / zoom);
-  float orig_x2 = orig_x1 + (surface->w / zoom) + 2.0f * (max_w / zoom);
-  float orig_y2 = orig_y1 + (surface->h / zoom) + 2.0f * (max_w / zoom);
-
-  std::vector<int> visible;
-  qtree.query({orig_x1, orig_y1, orig_x2, orig_y2}, visible);
-
-  static size_t last_visible_count = -1;
-  if (visible.size() != last_visible_count) {
-    if (visible.size() > 10000) {
-      log("Rendering Point Cloud Blob: %zu / %zu nodes (%.1f%%)\n",
-          visible.size(), nodes.size(),
-          (float)visible.size() / nodes.size() * 100.0f);
-    } else {
-      log("Rendering Detailed Nodes: %zu / %zu nodes (%.1f%%)\n",
-          visible.size(), nodes.size(),
-          (float)visible.size() / nodes.size() * 100.0f);
-    }
-    last_visible_count = visible.size();
-  }
-
-  if (visible.size() > 10000) {
-#ifndef DEBUG
-    SDL_PixelFormatDetails const *pixel_details =
-        SDL_GetPixelFormatDetails(surface->format);
-    Sint32 stride = pixel_details->bytes_per_pixel;
-#endif
-    for (int idx : visible) {
-      const auto &n = nodes[idx];
-      float scaled_x = (n.x + pan_x) * zoom;
-      float scaled_y = (n.y + pan_y) * zoom;
-      int cx = (int)scaled_x;
-      int cy = (int)scaled_y;
-
-      if (cx >= 0 && cx < surface->w && cy >= 0 && cy < surface->h) {
-        Uint8 out_r = n.selected ? 255 : n.r;
-        Uint8 out_g = n.selected ? 255 : n.g;
-        Uint8 out_b = n.selected ? 0 : n.b;
-#ifndef DEBUG
-        Uint8 *target_pixel =
-            ((Uint8 *)surface->pixels + (cy * surface->pitch) + (cx * stride));
-        target_pixel[0] = out_r;
-        target_pixel[1] = out_g;
-        target_pixel[2] = out_b;
-#else
-        SDL_WriteSurfacePixel(surface, cx, cy, out_r, out_g, out_b, n.a);
-#endif
-      }
-    }
-  } else {
-    for (int idx : visible) {
-      nodes[idx].render(surface, pan_x, pan_y, zoom);
-    }
-  }
-}
-
-void draw_string_widget(SDL_Surface *surface, int x, int y, const char *str,
-                        Uint32 bg_color, Uint32 fg_color) {
-  int scale = 4;
-  int num_chars = 0;
-  for (int i = 0; str[i] != '\0'; ++i)
-    num_chars++;
-
-  SDL_Rect bg = {x, y, 20 + num_chars * (4 * scale), 20 + (5 * scale)};
-  SDL_FillSurfaceRect(surface, &bg, bg_color);
-
-  const Uint8 font_0_9[10][15] = {
-      {1, 1, 1, 1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 1, 1}, // 0
-      {0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0}, // 1
-      {1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1}, // 2
-      {1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1}, // 3
-      {1, 0, 1, 1, 0, 1, 1, 1, 1, 0, 0, 1, 0, 0, 1}, // 4
-      {1, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 1}, // 5
-      {1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 1, 1, 1, 1}, // 6
-      {1, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1}, // 7
-      {1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1}, // 8
-      {1, 1, 1, 1, 0, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1}  // 9
-  };
-  const Uint8 font_F[15] = {1, 1, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1, 0, 0};
-  const Uint8 font_I[15] = {1, 1, 1, 0, 1, 0, 0, 1, 0, 0, 1, 0, 1, 1, 1};
-  const Uint8 font_N[15] = {1, 1, 1, 1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0, 1};
-  const Uint8 font_D[15] = {1, 1, 0, 1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 1, 0};
-  const Uint8 font_R[15] = {1, 1, 1, 1, 0, 1, 1, 1, 0, 1, 0, 1, 1, 0, 1};
-  const Uint8 font_E[15] = {1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 1};
-  const Uint8 font_S[15] = {1, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 1};
-  const Uint8 font_P[15] = {1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 0, 0, 1, 0, 0};
-  const Uint8 font_U[15] = {1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 1, 1};
-  const Uint8 font_T[15] = {1, 1, 1, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0};
-  const Uint8 font_O[15] = {1, 1, 1, 1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 1, 1};
-  const Uint8 font_SPACE[15] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-  const Uint8 font_COLON[15] = {0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0};
-
-  int cursor_x = x + 10;
-  int cursor_y = y + 10;
-
-  for (int i = 0; str[i] != '\0'; ++i) {
-    const Uint8 *c_font = nullptr;
-    if (str[i] >= '0' && str[i] <= '9') {
-      c_font = font_0_9[str[i] - '0'];
-    } else if (str[i] == 'F') {
-      c_font = font_F;
-    } else if (str[i] == 'I') {
-      c_font = font_I;
-    } else if (str[i] == 'N') {
-      c_font = font_N;
-    } else if (str[i] == 'D') {
-      c_font = font_D;
-    } else if (str[i] == 'R') {
-      c_font = font_R;
-    } else if (str[i] == 'E') {
-      c_font = font_E;
-    } else if (str[i] == 'S') {
-      c_font = font_S;
-    } else if (str[i] == 'P') {
-      c_font = font_P;
-    } else if (str[i] == 'U') {
-      c_font = font_U;
-    } else if (str[i] == 'T') {
-      c_font = font_T;
-    } else if (str[i] == 'O') {
-      c_font = font_O;
-    } else if (str[i] == ' ') {
-      c_font = font_SPACE;
-    } else if (str[i] == ':') {
-      c_font = font_COLON;
-    }
-
-    if (c_font) {
-      for (int y_pos = 0; y_pos < 5; ++y_pos) {
-        for (int x_pos = 0; x_pos < 3; ++x_pos) {
-          if (c_font[y_pos * 3 + x_pos]) {
-            SDL_Rect pixel = {cursor_x + x_pos * scale,
-                              cursor_y + y_pos * scale, scale, scale};
-            SDL_FillSurfaceRect(surface, &pixel, fg_color);
-          }
-        }
-      }
-    }
-    cursor_x += 4 * scale;
-  }
-}
-
-void draw_ttf_widget(SDL_Surface *surface, int x, int y, const char *text,
-                     stbtt_fontinfo *font, Uint32 bg_color, Uint32 fg_color) {
-  float scale = stbtt_ScaleForPixelHeight(font, 24.0f);
-  int ascent, descent, lineGap;
-  stbtt_GetFontVMetrics(font, &ascent, &descent, &lineGap);
-  ascent = (int)(ascent * scale);
-  descent = (int)(descent * scale);
-
-  int text_w = 0;
-  for (int i = 0; text[i]; ++i) {
-    int advanceX, leftBearing;
-    stbtt_GetCodepointHMetrics(font, text[i], &advanceX, &leftBearing);
-    text_w += (int)(advanceX * scale);
-    if (text[i + 1]) {
-      text_w +=
-          (int)(stbtt_GetCodepointKernAdvance(font, text[i], text[i + 1]) *
-                scale);
-    }
-  }
-
-  SDL_Rect bg = {x, y, text_w + 20, ascent - descent + 20};
-  SDL_FillSurfaceRect(surface, &bg, bg_color);
-
-  int cursor_x = x + 10;
-  int cursor_y = y + 10 + ascent;
-
-  SDL_PixelFormatDetails const *pixel_details =
-      SDL_GetPixelFormatDetails(surface->format);
-  Sint32 stride = pixel_details->bytes_per_pixel;
-
-  Uint8 fg_r, fg_g, fg_b;
-  SDL_GetRGB(fg_color, pixel_details, NULL, &fg_r, &fg_g, &fg_b);
-  Uint8 bg_r, bg_g, bg_b;
-  SDL_GetRGB(bg_color, pixel_details, NULL, &bg_r, &bg_g, &bg_b);
-
-  for (int i = 0; text[i]; ++i) {
-    int advanceX, leftBearing;
-    stbtt_GetCodepointHMetrics(font, text[i], &advanceX, &leftBearing);
-
-    int x0, y0, x1, y1;
-    stbtt_GetCodepointBitmapBox(font, text[i], scale, scale, &x0, &y0, &x1,
-                                &y1);
-
-    int w = x1 - x0;
-    int h = y1 - y0;
-
-    if (w > 0 && h > 0) {
-      unsigned char *bitmap = (unsigned char *)malloc(w * h);
-      stbtt_MakeCodepointBitmap(font, bitmap, w, h, w, scale, scale, text[i]);
-
-      for (int py = 0; py < h; ++py) {
-        for (int px = 0; px < w; ++px) {
-          unsigned char alpha = bitmap[py * w + px];
-          if (alpha > 0) {
-            int draw_x = cursor_x + x0 + px;
-            int draw_y = cursor_y + y0 + py;
-            if (draw_x >= 0 && draw_x < surface->w && draw_y >= 0 &&
-                draw_y < surface->h) {
-              float a = alpha / 255.0f;
-              Uint8 out_r = (Uint8)(fg_r * a + bg_r * (1.0f - a));
-              Uint8 out_g = (Uint8)(fg_g * a + bg_g * (1.0f - a));
-              Uint8 out_b = (Uint8)(fg_b * a + bg_b * (1.0f - a));
-              SDL_WriteSurfacePixel(surface, draw_x, draw_y, out_r, out_g,
-                                    out_b, 255);
-            }
-          }
-        }
-      }
-      free(bitmap);
-    }
-    cursor_x += (int)(advanceX * scale);
-    if (text[i + 1]) {
-      cursor_x +=
-          (int)(stbtt_GetCodepointKernAdvance(font, text[i], text[i + 1]) *
-                scale);
-    }
-  }
-}
-
-void draw_ui_widget(SDL_Surface *surface, int x, int y, const char *text,
-                    stbtt_fontinfo *font, Uint32 bg_color, Uint32 fg_color) {
-  if (font) {
-    draw_ttf_widget(surface, x, y, text, font, bg_color, fg_color);
-  } else {
-    draw_string_widget(surface, x, y, text, bg_color, fg_color);
-  }
-}
@@ -0,0 +1,96 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "debug.h"
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char *path) {
+  close();
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    log("Failed to open %s\n", path);
+    return false;
+  }
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (!mapping) {
+    CloseHandle(file);
+    return false;
+  }
+  void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!view) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+  file_handle = file;
+  mapping_handle = mapping;
+  data = (const Uint8 *)view;
+  size = (size_t)file_size.QuadPart;
+  return true;
+}
+
+void MappedFile::close() {
+  if (data)
+    UnmapViewOfFile(data);
+  if (mapping_handle)
+    CloseHandle((HANDLE)mapping_handle);
+  if (file_handle)
+    CloseHandle((HANDLE)file_handle);
+  data = nullptr;
+  size = 0;
+  file_handle = nullptr;
+  mapping_handle = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const char *path) {
+  close();
+  int file = ::open(path, O_RDONLY);
+  if (file < 0) {
+    log("Failed to open %s\n", path);
+    return false;
+  }
+  struct stat st;
+  if (fstat(file, &st) != 0 || st.st_size == 0) {
+    ::close(file);
+    return false;
+  }
+  void *view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, file, 0);
+  if (view == MAP_FAILED) {
+    ::close(file);
+    return false;
+  }
+  fd = file;
+  data = (const Uint8 *)view;
+  size = (size_t)st.st_size;
+  return true;
+}
+
+void MappedFile::close() {
+  if (data)
+    munmap((void *)data, size);
+  if (fd >= 0)
+    ::close(fd);
+  data = nullptr;
+  size = 0;
+  fd = -1;
+}
+
+#endif
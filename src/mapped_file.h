@@ -0,0 +1,25 @@
+#pragma once
+
+#include <SDL3/SDL_stdinc.h>
+#include <stddef.h>
+
+// Read-only memory mapping of a whole file. Pages are faulted in lazily by
+// the OS, so opening a multi-gigabyte file costs a few syscalls.
+struct MappedFile {
+  const Uint8 *data = nullptr;
+  size_t size = 0;
+#ifdef _WIN32
+  void *file_handle = nullptr;
+  void *mapping_handle = nullptr;
+#else
+  int fd = -1;
+#endif
+
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile() { close(); }
+
+  bool open(const char *path);
+  void close();
+};
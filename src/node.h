@@ -0,0 +1,155 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <new>
+#include <vector>
+
+struct Rect {
+  float x1, y1, x2, y2;
+  bool intersects(const Rect &other) const {
+    return !(x2 < other.x1 || x1 > other.x2 || y2 < other.y1 || y1 > other.y2);
+  }
+  bool contains(float x, float y) const {
+    return x >= x1 && x <= x2 && y >= y1 && y <= y2;
+  }
+};
+
+// Node colors are packed with r in the low byte, the same order the graph
+// file uses.
+inline Uint32 pack_rgba(Uint8 r, Uint8 g, Uint8 b, Uint8 a) {
+  return (Uint32)r | ((Uint32)g << 8) | ((Uint32)b << 16) | ((Uint32)a << 24);
+}
+inline Uint8 rgba_r(Uint32 rgba) { return (Uint8)rgba; }
+inline Uint8 rgba_g(Uint32 rgba) { return (Uint8)(rgba >> 8); }
+inline Uint8 rgba_b(Uint32 rgba) { return (Uint8)(rgba >> 16); }
+inline Uint8 rgba_a(Uint32 rgba) { return (Uint8)(rgba >> 24); }
+
+// Allocator that starts every array on its own cache line, so SIMD loads
+// over a column never straddle one at the start and columns do not share
+// lines with each other.
+template <typename T> struct CacheAligned {
+  static constexpr size_t ALIGN = 64;
+  using value_type = T;
+
+  CacheAligned() = default;
+  template <typename U> CacheAligned(const CacheAligned<U> &) {}
+
+  T *allocate(size_t n) {
+    return (T *)::operator new(n * sizeof(T), std::align_val_t(ALIGN));
+  }
+  void deallocate(T *p, size_t) {
+    ::operator delete(p, std::align_val_t(ALIGN));
+  }
+  template <typename U> bool operator==(const CacheAligned<U> &) const {
+    return true;
+  }
+  template <typename U> bool operator!=(const CacheAligned<U> &) const {
+    return false;
+  }
+};
+
+template <typename T> using AlignedVector = std::vector<T, CacheAligned<T>>;
+
+// Set of node indices as one bit per node for O(1) lookups while drawing,
+// plus the list of set bits so clearing costs O(selected) instead of O(n).
+// Used for the selection and the hidden nodes.
+struct Selection {
+  std::vector<Uint64> bits;
+  std::vector<int> active;
+
+  void resize(size_t count) {
+    clear();
+    bits.assign((count + 63) / 64, 0);
+  }
+  // Makes room for count nodes, keeping the set.
+  void grow(size_t count) { bits.resize((count + 63) / 64, 0); }
+  bool contains(int i) const { return (bits[i >> 6] >> (i & 63)) & 1; }
+  bool empty() const { return active.empty(); }
+  size_t size() const { return active.size(); }
+
+  void add(int i) {
+    if (contains(i))
+      return;
+    bits[i >> 6] |= 1ull << (i & 63);
+    active.push_back(i);
+  }
+  // O(selected); removals are rare next to clear() and add().
+  void remove(int i) {
+    if (!contains(i))
+      return;
+    bits[i >> 6] &= ~(1ull << (i & 63));
+    for (size_t k = 0; k < active.size(); ++k) {
+      if (active[k] == i) {
+        active[k] = active.back();
+        active.pop_back();
+        break;
+      }
+    }
+  }
+  void clear() {
+    for (int i : active)
+      bits[i >> 6] = 0;
+    active.clear();
+  }
+};
+
+// Columnar node storage. Centers and sizes, read by culling, indexing and
+// rasterization, live in separate cache-aligned arrays; border, color and
+// payload are only read once a node is known to be drawn or searched for.
+// Hidden nodes are skipped by the spatial index, and so by everything that
+// draws or picks nodes through it. Nodes removed by live updates keep their
+// index and stay hidden for good.
+struct NodeStore {
+  AlignedVector<float> x, y;
+  AlignedVector<float> width, height;
+  std::vector<float> border_thickness;
+  std::vector<Uint32> color; // pack_rgba()
+  std::vector<Uint32> data;
+  Selection selection;
+  Selection hidden;
+  Selection removed; // always hidden too
+
+  size_t size() const { return x.size(); }
+  bool empty() const { return x.empty(); }
+
+  void resize(size_t count) {
+    x.resize(count);
+    y.resize(count);
+    width.resize(count);
+    height.resize(count);
+    border_thickness.resize(count);
+    color.resize(count);
+    data.resize(count);
+    selection.resize(count);
+    hidden.resize(count);
+    removed.resize(count);
+  }
+  // Appends one node, keeping selection, hidden and removed nodes.
+  size_t append(float cx, float cy, float w, float h, float border,
+                Uint32 rgba, Uint32 value) {
+    x.push_back(cx);
+    y.push_back(cy);
+    width.push_back(w);
+    height.push_back(h);
+    border_thickness.push_back(border);
+    color.push_back(rgba);
+    data.push_back(value);
+    selection.grow(size());
+    hidden.grow(size());
+    removed.grow(size());
+    return size() - 1;
+  }
+
+  // Axis-aligned extent of node i.
+  Rect box(size_t i) const {
+    float hw = width[i] / 2.0f;
+    float hh = height[i] / 2.0f;
+    return {x[i] - hw, y[i] - hh, x[i] + hw, y[i] + hh};
+  }
+
+  size_t memory_bytes() const {
+    return size() * (4 * sizeof(float) + sizeof(float) + 2 * sizeof(Uint32)) +
+           (selection.bits.size() + hidden.bits.size() + removed.bits.size()) *
+               sizeof(Uint64);
+  }
+};
@@ -0,0 +1,126 @@
+#include "overview_worker.h"
+
+#include "debug.h"
+
+static void build_overviews(std::shared_ptr<OverviewWorker::Run> run) {
+  run->hierarchy.build(run->nodes, run->csr);
+  if (run->search)
+    run->search_index.build(run->nodes);
+  run->finished.store(true);
+}
+
+// Makes to's membership of node i match from's.
+static void copy_member(const Selection &from, Selection &to, int i) {
+  if (from.contains(i))
+    to.add(i);
+  else
+    to.remove(i);
+}
+
+void OverviewWorker::update_copy(const NodeStore &nodes,
+                                 const EdgeLayer &edges) {
+  NodeStore &copy = run->nodes;
+  size_t old_size = copied ? copy.size() : 0;
+  if (!copied || old_size > nodes.size()) {
+    copy = nodes;
+  } else {
+    for (size_t i = old_size; i < nodes.size(); ++i) {
+      copy.append(nodes.x[i], nodes.y[i], nodes.width[i], nodes.height[i],
+                  nodes.border_thickness[i], nodes.color[i], nodes.data[i]);
+      if (nodes.hidden.contains((int)i))
+        copy.hidden.add((int)i);
+      if (nodes.removed.contains((int)i))
+        copy.removed.add((int)i);
+    }
+    if (all_moved) {
+      copy.x.assign(nodes.x.begin(), nodes.x.end());
+      copy.y.assign(nodes.y.begin(), nodes.y.end());
+    }
+    if (all_hidden) {
+      copy.hidden = nodes.hidden;
+      copy.removed = nodes.removed;
+    }
+    for (int i : changed) {
+      if (i < 0 || (size_t)i >= old_size)
+        continue;
+      copy.x[i] = nodes.x[i];
+      copy.y[i] = nodes.y[i];
+      copy.width[i] = nodes.width[i];
+      copy.height[i] = nodes.height[i];
+      copy.border_thickness[i] = nodes.border_thickness[i];
+      copy.color[i] = nodes.color[i];
+      if (!all_hidden) {
+        copy_member(nodes.hidden, copy.hidden, i);
+        copy_member(nodes.removed, copy.removed, i);
+      }
+    }
+  }
+  changed.clear();
+  all_moved = all_hidden = false;
+
+  // The CSR may view the file's edge block or the edge layer's buffers,
+  // which change under the thread, so the copy owns its arrays.
+  if (!copied || edges.version != copied_edges) {
+    const EdgeCSR &csr = edges.csr;
+    EdgeCSR &to = run->csr;
+    to.node_count = csr.node_count;
+    to.edge_count = csr.edge_count;
+    to.offsets = NULL;
+    to.targets = NULL;
+    to.owned_offsets.clear();
+    to.owned_targets.clear();
+    if (csr.offsets) {
+      to.owned_offsets.assign(csr.offsets, csr.offsets + csr.node_count + 1);
+      to.owned_targets.assign(csr.targets, csr.targets + csr.edge_count);
+      to.offsets = to.owned_offsets.data();
+      to.targets = to.owned_targets.data();
+    }
+    copied_edges = edges.version;
+  }
+  copied = true;
+}
+
+void OverviewWorker::start(const NodeStore &nodes, const EdgeLayer &edges,
+                           bool search) {
+  if (running()) {
+    queued = true;
+    queued_search |= search;
+    return;
+  }
+  queued = queued_search = false;
+  if (!run)
+    run = std::make_shared<Run>();
+  update_copy(nodes, edges);
+  run->search = search;
+  run->finished.store(false);
+  thread = std::thread(build_overviews, run);
+}
+
+bool OverviewWorker::poll(const NodeStore &nodes, const EdgeLayer &edges,
+                          GraphHierarchy &hierarchy, SearchIndex &search,
+                          bool &searched) {
+  searched = false;
+  if (!running() || !run->finished.load())
+    return false;
+  thread.join();
+  // Swapping the level vectors keeps each level's address, which its index
+  // points into.
+  hierarchy.levels.swap(run->hierarchy.levels);
+  run->hierarchy.clear();
+  hierarchy.refit(nodes);
+  if (run->search) {
+    // The copy holds the same data for every node it has.
+    std::swap(search, run->search_index);
+    search.nodes = &nodes;
+    run->search_index = SearchIndex();
+    searched = true;
+  }
+  if (queued)
+    start(nodes, edges, queued_search);
+  return true;
+}
+
+OverviewWorker::~OverviewWorker() {
+  if (thread.joinable())
+    thread.join();
+}
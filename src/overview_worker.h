@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "edges.h"
+#include "graph_hierarchy.h"
+#include "node.h"
+#include "search_index.h"
+
+// Rebuilds the GraphHierarchy, and the SearchIndex when asked, on a
+// background thread, so hiding nodes or a stream of live updates does not
+// stall the UI on a full coarsening or sort. The previous ones stay in use
+// until poll() swaps the new ones in.
+//
+// The worker keeps its own copy of the nodes and edges between rebuilds.
+// start() brings it up to date with only what changed since the last one:
+// nodes appended since, the nodes passed to node_changed(), and everyone's
+// positions or hidden state after positions_changed() or hidden_changed().
+// The edges are copied again only after EdgeLayer::rebuild() changed them.
+//
+// A rebuild cannot be cancelled. One requested while another runs waits
+// for it and then starts from the nodes as they are at that point, so
+// bursts of requests cost at most one extra build.
+struct OverviewWorker {
+  // One rebuild, shared with its thread.
+  struct Run {
+    std::atomic<bool> finished{false};
+    NodeStore nodes;
+    EdgeCSR csr;
+    bool search = false; // rebuild search too
+    GraphHierarchy hierarchy;
+    SearchIndex search_index;
+  };
+
+  // The copy, with the last or current rebuild; the thread is joinable
+  // while one is in progress.
+  std::shared_ptr<Run> run;
+  std::thread thread;
+  bool queued = false;        // another rebuild is due once this one is in
+  bool queued_search = false; // and it includes search
+
+  // What changed in the real nodes since the copy was brought up to date.
+  bool copied = false;
+  Uint64 copied_edges = 0; // EdgeLayer::version of the copied CSR
+  std::vector<int> changed;
+  bool all_moved = false;
+  bool all_hidden = false;
+
+  OverviewWorker() = default;
+  OverviewWorker(const OverviewWorker &) = delete;
+  OverviewWorker &operator=(const OverviewWorker &) = delete;
+  ~OverviewWorker();
+
+  void node_changed(int i) { changed.push_back(i); }
+  void positions_changed() { all_moved = true; }
+  void hidden_changed() { all_hidden = true; }
+  // Starts a rebuild from the current nodes and edges, or queues one behind
+  // the rebuild in progress.
+  void start(const NodeStore &nodes, const EdgeLayer &edges, bool search);
+  // Swaps a finished rebuild into hierarchy, refitted to where the nodes are
+  // now, and into search if it was rebuilt too, setting searched. Then starts
+  // the queued one. Returns true if anything changed.
+  bool poll(const NodeStore &nodes, const EdgeLayer &edges,
+            GraphHierarchy &hierarchy, SearchIndex &search, bool &searched);
+  bool running() const { return thread.joinable(); }
+
+private:
+  void update_copy(const NodeStore &nodes, const EdgeLayer &edges);
+};
@@ -0,0 +1,267 @@
+#include "page_cache.h"
+
+#include <algorithm>
+#include <limits.h>
+#include <string.h>
+
+#include "scene.h"
+
+#include "debug.h"
+
+// The prefetch ring grows the view by RING_MARGIN of its size on every side
+// and by RING_AHEAD views in the direction of travel.
+static constexpr float RING_MARGIN = 0.25f;
+static constexpr float RING_AHEAD = 1.0f;
+
+// Fraction of a's area inside b; 1 for a degenerate a touching b.
+static float overlap(const Rect &a, const Rect &b) {
+  float w = SDL_min(a.x2, b.x2) - SDL_max(a.x1, b.x1);
+  float h = SDL_min(a.y2, b.y2) - SDL_max(a.y1, b.y1);
+  if (w < 0.0f || h < 0.0f)
+    return 0.0f;
+  float area = (a.x2 - a.x1) * (a.y2 - a.y1);
+  return area > 0.0f ? SDL_min(w * h / area, 1.0f) : 1.0f;
+}
+
+static void load_pages(PageCache *cache) {
+  std::unique_lock<std::mutex> lock(cache->mutex);
+  for (;;) {
+    cache->wake.wait(lock, [&]() {
+      return cache->stopping || !cache->requests.empty();
+    });
+    if (cache->stopping)
+      return;
+    Uint32 p = cache->requests.back();
+    cache->requests.pop_back();
+    lock.unlock();
+
+    std::vector<Uint8> bytes(paged_page_bytes(cache->graph->pages[p].count));
+    memcpy(bytes.data(), cache->graph->page_data(p), bytes.size());
+
+    lock.lock();
+    cache->finished.push_back(p);
+    cache->done.push_back(std::move(bytes));
+  }
+}
+
+void PageCache::start(const PagedGraph &source, size_t budget_bytes) {
+  stop();
+  graph = &source;
+  budget = budget_bytes;
+  pages.assign(source.page_count, Page());
+  resident.clear();
+  resident_bytes = 0;
+  in_flight = 0;
+  overview = true;
+  working.clear();
+  working_first.clear();
+  away_selected.clear();
+  away_hidden.clear();
+  stopping = false;
+  thread = std::thread(load_pages, this);
+}
+
+void PageCache::stop() {
+  if (!thread.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    requests.clear();
+  }
+  wake.notify_all();
+  thread.join();
+  finished.clear();
+  done.clear();
+}
+
+bool PageCache::update(const Rect &view, NodeStore &nodes,
+                       SpatialIndex &index) {
+  bool arrived = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t k = 0; k < finished.size(); ++k) {
+      Page &page = pages[finished[k]];
+      page.bytes.swap(done[k]);
+      page.queued = false;
+      page.last_used = tick;
+      resident.push_back(finished[k]);
+      resident_bytes += page.bytes.size();
+      in_flight--;
+      arrived = true;
+    }
+    finished.clear();
+    done.clear();
+  }
+  bool moved = memcmp(&view, &last_view, sizeof(view)) != 0;
+  if (!arrived && !moved)
+    return false;
+
+  float dx = (view.x1 + view.x2) - (last_view.x1 + last_view.x2);
+  float dy = (view.y1 + view.y2) - (last_view.y1 + last_view.y2);
+  if (dx != 0.0f || dy != 0.0f) {
+    heading_x = dx > 0.0f ? 1.0f : (dx < 0.0f ? -1.0f : 0.0f);
+    heading_y = dy > 0.0f ? 1.0f : (dy < 0.0f ? -1.0f : 0.0f);
+  }
+  last_view = view;
+  ++tick;
+
+  // Pages in view, and an estimate of the nodes they put in it assuming
+  // nodes spread evenly over each page's bounds.
+  std::vector<Uint32> visible;
+  float estimate = 0.0f;
+  graph->query_pages(view, visible);
+  for (Uint32 p : visible) {
+    const PagedPageEntry &entry = graph->pages[p];
+    estimate += entry.count * overlap(entry.bounds, view);
+  }
+  bool was_overview = overview;
+  overview = estimate > (float)DETAIL_NODES;
+  if (overview)
+    visible.clear();
+
+  std::vector<Uint32> ring;
+  if (!overview) {
+    float w = view.x2 - view.x1, h = view.y2 - view.y1;
+    Rect reach = {view.x1 - w * RING_MARGIN, view.y1 - h * RING_MARGIN,
+                  view.x2 + w * RING_MARGIN, view.y2 + h * RING_MARGIN};
+    if (heading_x > 0.0f)
+      reach.x2 += w * RING_AHEAD;
+    else if (heading_x < 0.0f)
+      reach.x1 -= w * RING_AHEAD;
+    if (heading_y > 0.0f)
+      reach.y2 += h * RING_AHEAD;
+    else if (heading_y < 0.0f)
+      reach.y1 -= h * RING_AHEAD;
+    std::vector<Uint32> reached;
+    graph->query_pages(reach, reached);
+    for (Uint32 p : reached)
+      if (!graph->pages[p].bounds.intersects(view))
+        ring.push_back(p);
+    // Nearest first, so a tight budget keeps the pages needed soonest.
+    float cx = (view.x1 + view.x2) * 0.5f, cy = (view.y1 + view.y2) * 0.5f;
+    auto distance = [&](Uint32 p) {
+      const Rect &b = graph->pages[p].bounds;
+      float px = (b.x1 + b.x2) * 0.5f - cx, py = (b.y1 + b.y2) * 0.5f - cy;
+      return px * px + py * py;
+    };
+    std::sort(ring.begin(), ring.end(), [&](Uint32 a, Uint32 b) {
+      return distance(a) < distance(b);
+    });
+  }
+
+  // Visible pages are always wanted; the ring only as far as the budget
+  // reaches. Wanted pages are marked used now so eviction skips them.
+  std::vector<Uint32> wanted;
+  size_t wanted_bytes = 0;
+  for (Uint32 p : visible) {
+    wanted.push_back(p);
+    wanted_bytes += paged_page_bytes(graph->pages[p].count);
+  }
+  for (Uint32 p : ring) {
+    size_t bytes = paged_page_bytes(graph->pages[p].count);
+    if (wanted_bytes + bytes > budget)
+      break;
+    wanted.push_back(p);
+    wanted_bytes += bytes;
+  }
+  if (wanted_bytes > budget)
+    log_once("Pages in view need %zu KiB, over the %zu KiB budget\n",
+             wanted_bytes / 1024, budget / 1024);
+  for (Uint32 p : wanted)
+    pages[p].last_used = tick;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (Uint32 p : requests) {
+      pages[p].queued = false;
+      in_flight--;
+    }
+    requests.clear();
+    for (size_t k = wanted.size(); k-- > 0;) {
+      Page &page = pages[wanted[k]];
+      if (!page.bytes.empty() || page.queued)
+        continue;
+      page.queued = true;
+      in_flight++;
+      requests.push_back(wanted[k]);
+    }
+  }
+  wake.notify_one();
+
+  // Least recently used first; pages wanted now carry this tick and stay.
+  while (resident_bytes > budget) {
+    size_t oldest = resident.size();
+    for (size_t k = 0; k < resident.size(); ++k) {
+      Uint64 used = pages[resident[k]].last_used;
+      if (used != tick &&
+          (oldest == resident.size() ||
+           used < pages[resident[oldest]].last_used))
+        oldest = k;
+    }
+    if (oldest == resident.size())
+      break;
+    Page &page = pages[resident[oldest]];
+    resident_bytes -= page.bytes.size();
+    std::vector<Uint8>().swap(page.bytes);
+    resident[oldest] = resident.back();
+    resident.pop_back();
+  }
+
+  // Working-set indices are int, which only a view the estimate badly
+  // underrated could overflow; it is cut short there.
+  std::vector<Uint32> next;
+  size_t next_nodes = 0;
+  for (Uint32 p : visible) {
+    if (pages[p].bytes.empty() ||
+        next_nodes + graph->pages[p].count > (size_t)INT_MAX)
+      continue;
+    next.push_back(p);
+    next_nodes += graph->pages[p].count;
+  }
+  if (next == working && overview == was_overview)
+    return false;
+
+  // Selected and hidden nodes are kept by page and offset across the
+  // rebuild, and for as long as their page is out of the working set.
+  auto locate = [&](int i) {
+    size_t w = std::upper_bound(working_first.begin(), working_first.end(),
+                                (size_t)i) -
+               working_first.begin() - 1;
+    return std::make_pair(working[w], (size_t)i - working_first[w]);
+  };
+  for (int i : nodes.selection.active)
+    away_selected.push_back(locate(i));
+  for (int i : nodes.hidden.active)
+    away_hidden.push_back(locate(i));
+
+  size_t total = 0;
+  working_first.clear();
+  for (Uint32 p : next) {
+    working_first.push_back(total);
+    total += graph->pages[p].count;
+  }
+  nodes.resize(total);
+  for (size_t w = 0; w < next.size(); ++w)
+    copy_page_columns(pages[next[w]].bytes.data(),
+                      graph->pages[next[w]].count, nodes, working_first[w]);
+  working.swap(next);
+  auto restore = [&](std::vector<std::pair<Uint32, size_t>> &away,
+                     Selection &set) {
+    size_t kept = 0;
+    for (const auto &s : away) {
+      auto it = std::find(working.begin(), working.end(), s.first);
+      if (it != working.end())
+        set.add((int)(working_first[it - working.begin()] + s.second));
+      else
+        away[kept++] = s;
+    }
+    away.resize(kept);
+  };
+  restore(away_selected, nodes.selection);
+  restore(away_hidden, nodes.hidden);
+  index.build(nodes);
+  log("Working set: %zu pages, %zu nodes; %zu resident, %zu KiB\n",
+      working.size(), total, resident.size(), resident_bytes / 1024);
+  return true;
+}
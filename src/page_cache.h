@@ -0,0 +1,78 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "node.h"
+#include "paged_graph.h"
+#include "spatial_index.h"
+
+// Keeps the pages of a PagedGraph that the view needs in memory.
+//
+// Each update() looks the view up in the page tree. Views estimated to
+// show more than DETAIL_NODES are left to the file's aggregates and load
+// nothing. Otherwise the pages intersecting the view are requested first,
+// then those of a prefetch ring around it that reaches one view further in
+// the direction the view last moved. A loader thread copies requested pages
+// out of the mapping, so page faults never stall a frame, and hands them
+// back to be inserted into an LRU cache of at most budget bytes. Pages in
+// or near the view are never evicted, so a view needing more than the
+// budget overshoots it rather than thrashing.
+//
+// The nodes of the resident pages intersecting the view are gathered into a
+// regular NodeStore and SpatialIndex for draw(); they are rebuilt whenever
+// that set changes. Selected and hidden nodes keep that state while their
+// page is out of the set, and get it back when it returns.
+struct PageCache {
+  struct Page {
+    std::vector<Uint8> bytes; // the page's columns, empty when not resident
+    Uint64 last_used = 0;
+    bool queued = false;
+  };
+
+  const PagedGraph *graph = nullptr;
+  size_t budget = 0;
+  std::vector<Page> pages;
+  std::vector<Uint32> resident;
+  size_t resident_bytes = 0;
+  size_t in_flight = 0; // queued pages, until update() collects them
+  Uint64 tick = 0;
+
+  // Set by the last update(): whether the view is served from aggregates,
+  // and the pages whose nodes are in the working set with the index of
+  // each page's first node there.
+  bool overview = true;
+  std::vector<Uint32> working;
+  std::vector<size_t> working_first;
+  // Selected and hidden nodes outside the working set, by page and offset.
+  std::vector<std::pair<Uint32, size_t>> away_selected, away_hidden;
+
+  Rect last_view = {0, 0, 0, 0};
+  float heading_x = 0.0f, heading_y = 0.0f; // last direction of travel
+
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::vector<Uint32> requests;         // guarded, most urgent last
+  std::vector<Uint32> finished;         // guarded, loaded page ids
+  std::vector<std::vector<Uint8>> done; // guarded, their bytes
+  bool stopping = false;                // guarded
+
+  PageCache() = default;
+  PageCache(const PageCache &) = delete;
+  PageCache &operator=(const PageCache &) = delete;
+  ~PageCache() { stop(); }
+
+  void start(const PagedGraph &source, size_t budget_bytes);
+  void stop();
+
+  // Brings the cache up to date with view (world coordinates). Rebuilds
+  // nodes and index and returns true when the working set or the overview
+  // decision changed, so the view needs a full repaint.
+  bool update(const Rect &view, NodeStore &nodes, SpatialIndex &index);
+  // Pages requested but not yet collected by update().
+  bool loading() const { return in_flight > 0; }
+};
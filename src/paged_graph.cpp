@@ -0,0 +1,391 @@
+#include "paged_graph.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "parallel.h"
+#include "spatial_index.h"
+
+#include "debug.h"
+
+// Nodes sorted at a time when writing a paged file, which bounds the
+// writer's memory: a run's nodes are held as PagedRecords.
+static constexpr size_t PAGED_SORT_RUN_NODES = 1 << 22;
+
+// One node on its way into a page. Ordered by Morton code, then index, as
+// SpatialIndex orders nodes.
+struct PagedRecord {
+  Uint32 code;
+  Uint32 color;
+  Uint64 index;
+  float x, y, width, height, border_thickness;
+  Uint32 data;
+
+  bool operator<(const PagedRecord &other) const {
+    return code != other.code ? code < other.code : index < other.index;
+  }
+};
+
+static Uint64 align_to(Uint64 value, Uint64 align) {
+  return (value + align - 1) & ~(align - 1);
+}
+
+static Rect merge(const Rect &a, const Rect &b) {
+  return {SDL_min(a.x1, b.x1), SDL_min(a.y1, b.y1), SDL_max(a.x2, b.x2),
+          SDL_max(a.y2, b.y2)};
+}
+
+bool PagedGraph::open(const char *path) {
+  header = nullptr;
+  pages = nullptr;
+  page_count = node_count = 0;
+  if (!file.open(path))
+    return false;
+
+  if (file.size < sizeof(PagedFileHeader)) {
+    log("%s: truncated header\n", path);
+    file.close();
+    return false;
+  }
+  const PagedFileHeader &h = *(const PagedFileHeader *)file.data;
+  if (memcmp(h.magic, PAGED_FILE_MAGIC, sizeof(h.magic)) != 0) {
+    log("%s: not a paged graph file\n", path);
+    file.close();
+    return false;
+  }
+  if (h.version != PAGED_FILE_VERSION) {
+    log("%s: unsupported version %u (expected %u)\n", path, h.version,
+        PAGED_FILE_VERSION);
+    file.close();
+    return false;
+  }
+  // Page ids are Uint32; nodes are only ever counted in int within the
+  // working set of one view.
+  if (h.page_nodes == 0 || h.page_count > 0xFFFFFFFFull ||
+      h.page_count != (h.node_count + h.page_nodes - 1) / h.page_nodes) {
+    log("%s: bad page geometry\n", path);
+    file.close();
+    return false;
+  }
+
+  Uint64 table_bytes = h.page_count * sizeof(PagedPageEntry);
+  Uint64 levels_bytes = (Uint64)h.level_count * sizeof(PagedLevelEntry);
+  if (h.page_offset > file.size || table_bytes > file.size - h.page_offset ||
+      h.level_offset > file.size ||
+      levels_bytes > file.size - h.level_offset) {
+    log("%s: page table out of bounds\n", path);
+    file.close();
+    return false;
+  }
+
+  // The table is small next to the pages, so it is checked whole here and
+  // the pages never are.
+  const PagedPageEntry *table =
+      (const PagedPageEntry *)(file.data + h.page_offset);
+  for (Uint64 p = 0; p < h.page_count; ++p) {
+    Uint32 expected = p + 1 < h.page_count
+                          ? h.page_nodes
+                          : (Uint32)(h.node_count - p * h.page_nodes);
+    size_t bytes = paged_page_bytes(table[p].count);
+    if (table[p].count != expected || table[p].offset > file.size ||
+        bytes > file.size - table[p].offset) {
+      log("%s: page out of bounds\n", path);
+      file.close();
+      return false;
+    }
+  }
+  const PagedLevelEntry *levels =
+      (const PagedLevelEntry *)(file.data + h.level_offset);
+  for (Uint32 l = 0; l < h.level_count; ++l) {
+    Uint64 bytes = (Uint64)levels[l].w * levels[l].h * sizeof(Uint32);
+    if (levels[l].offset > file.size || bytes > file.size - levels[l].offset) {
+      log("%s: aggregate level out of bounds\n", path);
+      file.close();
+      return false;
+    }
+  }
+
+  header = &h;
+  pages = table;
+  page_count = h.page_count;
+  node_count = h.node_count;
+
+  page_tree.clear();
+  size_t count = (size_t)page_count;
+  while (count > 1 || page_tree.empty()) {
+    size_t below = count;
+    count = (count + PAGE_TREE_FANOUT - 1) / PAGE_TREE_FANOUT;
+    std::vector<Rect> level(count);
+    for (size_t j = 0; j < count; ++j) {
+      size_t first = j * PAGE_TREE_FANOUT;
+      size_t last = SDL_min(first + PAGE_TREE_FANOUT, below);
+      auto box = [&](size_t k) {
+        return page_tree.empty() ? table[k].bounds : page_tree.back()[k];
+      };
+      Rect bounds = box(first);
+      for (size_t k = first + 1; k < last; ++k)
+        bounds = merge(bounds, box(k));
+      level[j] = bounds;
+    }
+    page_tree.push_back(std::move(level));
+  }
+  log("Mapped %s: %llu nodes in %llu pages\n", path,
+      (unsigned long long)node_count, (unsigned long long)page_count);
+  return true;
+}
+
+void PagedGraph::load_pyramid(DensityPyramid &pyramid) const {
+  pyramid.levels.clear();
+  pyramid.bounds = header->bounds;
+  const PagedLevelEntry *levels =
+      (const PagedLevelEntry *)(file.data + header->level_offset);
+  for (Uint32 l = 0; l < header->level_count; ++l) {
+    DensityPyramid::Level level;
+    level.w = (int)levels[l].w;
+    level.h = (int)levels[l].h;
+    level.cell = levels[l].cell;
+    level.max_count = levels[l].max_count;
+    const Uint32 *cells = (const Uint32 *)(file.data + levels[l].offset);
+    level.cells.assign(cells, cells + (size_t)level.w * level.h);
+    pyramid.levels.push_back(std::move(level));
+  }
+  log("Aggregates: %zu levels, %zu KiB\n", pyramid.levels.size(),
+      pyramid.memory_bytes() / 1024);
+}
+
+void PagedGraph::query_pages(const Rect &range,
+                             std::vector<Uint32> &found) const {
+  if (page_count == 0)
+    return;
+  // Depth-first over (level, box) pairs, -1 being the pages themselves;
+  // children are pushed last first so pages come out in order.
+  struct Entry {
+    int level;
+    size_t index;
+  };
+  Entry stack[PAGE_TREE_FANOUT * 16];
+  int top = 0;
+  stack[top++] = {(int)page_tree.size() - 1, 0};
+  while (top > 0) {
+    Entry e = stack[--top];
+    if (e.level < 0) {
+      if (pages[e.index].bounds.intersects(range))
+        found.push_back((Uint32)e.index);
+      continue;
+    }
+    if (!page_tree[e.level][e.index].intersects(range))
+      continue;
+    size_t first = e.index * PAGE_TREE_FANOUT;
+    size_t last = SDL_min(first + PAGE_TREE_FANOUT,
+                          e.level > 0 ? page_tree[e.level - 1].size()
+                                      : (size_t)page_count);
+    for (size_t k = last; k-- > first;)
+      stack[top++] = {e.level - 1, k};
+  }
+}
+
+void copy_page_columns(const Uint8 *src, Uint32 count, NodeStore &nodes,
+                       size_t at) {
+  size_t column = (size_t)count * 4;
+  memcpy(nodes.x.data() + at, src, column);
+  memcpy(nodes.y.data() + at, src + column, column);
+  memcpy(nodes.width.data() + at, src + 2 * column, column);
+  memcpy(nodes.height.data() + at, src + 3 * column, column);
+  memcpy(nodes.border_thickness.data() + at, src + 4 * column, column);
+  memcpy(nodes.color.data() + at, src + 5 * column, column);
+  memcpy(nodes.data.data() + at, src + 6 * column, column);
+}
+
+static bool write_padding(FILE *f, Uint64 &written, Uint64 offset) {
+  static const Uint8 zeros[PAGED_FILE_ALIGN] = {};
+  Uint64 bytes = offset - written;
+  written = offset;
+  return fwrite(zeros, 1, bytes, f) == bytes;
+}
+
+bool write_paged_file(const char *path, const GraphColumns &columns) {
+  Uint64 n = columns.node_count;
+  Rect bounds = {0, 0, 0, 0};
+  if (n > 0)
+    bounds = {columns.x[0], columns.y[0], columns.x[0], columns.y[0]};
+  for (Uint64 i = 1; i < n; ++i)
+    bounds = merge(bounds, {columns.x[i], columns.y[i], columns.x[i],
+                            columns.y[i]});
+  // The order SpatialIndex::build() gives, which is exactly the clustering
+  // the pages want.
+  MortonGrid grid(bounds);
+  DensityPyramid pyramid;
+  if (n > 0)
+    pyramid.start(bounds);
+
+  // Runs of PAGED_SORT_RUN_NODES nodes are sorted one at a time. If there
+  // is more than one, they go to a scratch file next to the output and are
+  // merged from its mapping, which the OS pages in and out as needed.
+  std::string scratch_path = std::string(path) + ".sort";
+  Uint64 run_count = (n + PAGED_SORT_RUN_NODES - 1) / PAGED_SORT_RUN_NODES;
+  FILE *scratch = NULL;
+  if (run_count > 1 && !(scratch = fopen(scratch_path.c_str(), "wb"))) {
+    log("Failed to create %s\n", scratch_path.c_str());
+    return false;
+  }
+  std::vector<PagedRecord> run;
+  bool ok = true;
+  for (Uint64 r = 0; r < run_count && ok; ++r) {
+    Uint64 first = r * PAGED_SORT_RUN_NODES;
+    size_t count = (size_t)SDL_min((Uint64)PAGED_SORT_RUN_NODES, n - first);
+    run.resize(count);
+    parallel_for(count, 16384, [&](size_t begin, size_t end) {
+      for (size_t k = begin; k < end; ++k) {
+        Uint64 i = first + k;
+        run[k] = {grid.code(columns.x[i], columns.y[i]), columns.color[i], i,
+                  columns.x[i], columns.y[i], columns.width[i],
+                  columns.height[i], columns.border_thickness[i],
+                  columns.data[i]};
+      }
+    });
+    for (const PagedRecord &record : run)
+      pyramid.accumulate(record.x, record.y, record.color);
+    std::sort(run.begin(), run.end());
+    if (scratch)
+      ok = fwrite(run.data(), sizeof(PagedRecord), count, scratch) == count;
+  }
+  if (n > 0)
+    pyramid.finish();
+
+  // Where each run's next node is.
+  struct Cursor {
+    const PagedRecord *next, *end;
+  };
+  std::vector<Cursor> cursors;
+  MappedFile spilled;
+  if (scratch) {
+    std::vector<PagedRecord>().swap(run);
+    if (fclose(scratch) != 0 || !spilled.open(scratch_path.c_str()))
+      ok = false;
+    const PagedRecord *records = (const PagedRecord *)spilled.data;
+    for (Uint64 r = 0; r < run_count && ok; ++r)
+      cursors.push_back(
+          {records + r * PAGED_SORT_RUN_NODES,
+           records + SDL_min((r + 1) * PAGED_SORT_RUN_NODES, n)});
+  } else if (n > 0) {
+    cursors.push_back({run.data(), run.data() + run.size()});
+  }
+
+  PagedFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, PAGED_FILE_MAGIC, sizeof(header.magic));
+  header.version = PAGED_FILE_VERSION;
+  header.page_nodes = PAGED_FILE_PAGE_NODES;
+  header.node_count = n;
+  header.page_count = (n + PAGED_FILE_PAGE_NODES - 1) / PAGED_FILE_PAGE_NODES;
+  header.bounds = pyramid.levels.empty() ? Rect{0, 0, 0, 0} : pyramid.bounds;
+  header.level_count = (Uint32)pyramid.levels.size();
+
+  // Page bounds are filled in as the pages are written, and the table is
+  // written again once they are all known.
+  std::vector<PagedPageEntry> table(header.page_count);
+  std::vector<PagedLevelEntry> levels(header.level_count);
+  header.page_offset = align_to(sizeof(header), 64);
+  header.level_offset =
+      align_to(header.page_offset + table.size() * sizeof(PagedPageEntry), 64);
+  Uint64 offset = header.level_offset + levels.size() * sizeof(PagedLevelEntry);
+  for (size_t l = 0; l < levels.size(); ++l) {
+    const DensityPyramid::Level &level = pyramid.levels[l];
+    levels[l] = {(Uint32)level.w, (Uint32)level.h, level.cell,
+                 level.max_count, align_to(offset, 64)};
+    offset = levels[l].offset + level.cells.size() * sizeof(Uint32);
+  }
+  for (Uint64 p = 0; p < header.page_count; ++p) {
+    Uint32 count = (Uint32)SDL_min((Uint64)PAGED_FILE_PAGE_NODES,
+                                   n - p * PAGED_FILE_PAGE_NODES);
+    table[p] = {Rect{0, 0, 0, 0}, align_to(offset, PAGED_FILE_ALIGN), count,
+                0};
+    offset = table[p].offset + paged_page_bytes(count);
+  }
+
+  FILE *f = ok ? fopen(path, "wb") : NULL;
+  if (!f) {
+    if (ok)
+      log("Failed to create %s\n", path);
+    else
+      log("Failed to write %s\n", scratch_path.c_str());
+    if (scratch) {
+      spilled.close();
+      remove(scratch_path.c_str());
+    }
+    return false;
+  }
+  // An empty graph has no table or levels, and fwrite() wants a buffer.
+  auto write_table = [&]() {
+    return table.empty() ||
+           fwrite(table.data(), sizeof(PagedPageEntry), table.size(), f) ==
+               table.size();
+  };
+  Uint64 written = sizeof(header);
+  ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+       write_padding(f, written, header.page_offset) && write_table();
+  written += table.size() * sizeof(PagedPageEntry);
+  ok = ok && write_padding(f, written, header.level_offset) &&
+       (levels.empty() ||
+        fwrite(levels.data(), sizeof(PagedLevelEntry), levels.size(), f) ==
+            levels.size());
+  written += levels.size() * sizeof(PagedLevelEntry);
+  for (size_t l = 0; l < levels.size() && ok; ++l) {
+    const std::vector<Uint32> &cells = pyramid.levels[l].cells;
+    ok = write_padding(f, written, levels[l].offset) &&
+         fwrite(cells.data(), sizeof(Uint32), cells.size(), f) == cells.size();
+    written += cells.size() * sizeof(Uint32);
+  }
+  pyramid.levels.clear();
+
+  // Merges the runs, smallest head first.
+  auto later = [](const Cursor &a, const Cursor &b) {
+    return *b.next < *a.next;
+  };
+  std::make_heap(cursors.begin(), cursors.end(), later);
+  std::vector<Uint8> page;
+  for (Uint64 p = 0; p < header.page_count && ok; ++p) {
+    Uint32 count = table[p].count;
+    size_t column = (size_t)count * 4;
+    page.resize(paged_page_bytes(count));
+    Uint8 *to = page.data();
+    for (Uint32 k = 0; k < count; ++k) {
+      std::pop_heap(cursors.begin(), cursors.end(), later);
+      const PagedRecord &node = *cursors.back().next++;
+      if (cursors.back().next == cursors.back().end)
+        cursors.pop_back();
+      else
+        std::push_heap(cursors.begin(), cursors.end(), later);
+      memcpy(to + k * 4, &node.x, 4);
+      memcpy(to + column + k * 4, &node.y, 4);
+      memcpy(to + 2 * column + k * 4, &node.width, 4);
+      memcpy(to + 3 * column + k * 4, &node.height, 4);
+      memcpy(to + 4 * column + k * 4, &node.border_thickness, 4);
+      memcpy(to + 5 * column + k * 4, &node.color, 4);
+      memcpy(to + 6 * column + k * 4, &node.data, 4);
+      float hw = node.width / 2.0f, hh = node.height / 2.0f;
+      Rect box = {node.x - hw, node.y - hh, node.x + hw, node.y + hh};
+      table[p].bounds = k == 0 ? box : merge(table[p].bounds, box);
+    }
+    ok = write_padding(f, written, table[p].offset) &&
+         fwrite(page.data(), 1, page.size(), f) == page.size();
+    written += page.size();
+  }
+  ok = ok && fseek(f, (long)header.page_offset, SEEK_SET) == 0 &&
+       write_table();
+  if (fclose(f) != 0)
+    ok = false;
+  if (scratch) {
+    spilled.close();
+    remove(scratch_path.c_str());
+  }
+  if (!ok)
+    log("Failed to write %s\n", path);
+  else
+    log("Wrote %s: %llu pages of %d nodes\n", path,
+        (unsigned long long)header.page_count, PAGED_FILE_PAGE_NODES);
+  return ok;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <SDL3/SDL_stdinc.h>
+#include <vector>
+
+#include "density_pyramid.h"
+#include "graph_file.h"
+#include "mapped_file.h"
+#include "node.h"
+
+// Paged graph format (.gvp), for graphs whose nodes do not fit in memory.
+//
+// Nodes are sorted by the Morton code of their center and cut into pages of
+// page_nodes consecutive nodes, so each page covers a compact patch of the
+// layout. Every page stores the NodeStore columns back to back and starts on
+// a PAGED_FILE_ALIGN boundary. A small page table (bounds, offset and count
+// per page) and the levels of a DensityPyramid over all nodes sit after the
+// header; the viewer maps those and reads pages on demand. Edges are not
+// stored. All values are little endian.
+
+#define PAGED_FILE_MAGIC "GVPAGED1"
+#define PAGED_FILE_VERSION 1
+#define PAGED_FILE_ALIGN 4096
+#define PAGED_FILE_PAGE_NODES 4096
+
+struct PagedFileHeader {
+  char magic[8];
+  Uint32 version;
+  Uint32 page_nodes; // nodes per page, the last one may hold fewer
+  Uint64 node_count;
+  Uint64 page_count;
+  Rect bounds;          // of node centers
+  Uint64 page_offset;   // PagedPageEntry[page_count]
+  Uint64 level_offset;  // PagedLevelEntry[level_count]
+  Uint32 level_count;
+  Uint8 reserved[60];
+};
+static_assert(sizeof(PagedFileHeader) == 128, "PagedFileHeader layout");
+
+struct PagedPageEntry {
+  Rect bounds;   // of node extents
+  Uint64 offset; // x, y, width, height, border, color, data; count each
+  Uint32 count;
+  Uint32 reserved;
+};
+static_assert(sizeof(PagedPageEntry) == 32, "PagedPageEntry layout");
+
+// One DensityPyramid::Level; its cells are Uint32[w * h] at offset.
+struct PagedLevelEntry {
+  Uint32 w, h;
+  float cell;
+  Uint32 max_count;
+  Uint64 offset;
+};
+static_assert(sizeof(PagedLevelEntry) == 24, "PagedLevelEntry layout");
+
+// Bytes of one page's columns.
+inline size_t paged_page_bytes(Uint32 count) {
+  return (size_t)count * (5 * sizeof(float) + 2 * sizeof(Uint32));
+}
+
+struct PagedGraph {
+  static constexpr int PAGE_TREE_FANOUT = 16;
+
+  MappedFile file;
+  const PagedFileHeader *header = nullptr;
+  const PagedPageEntry *pages = nullptr;
+  Uint64 page_count = 0;
+  Uint64 node_count = 0;
+  // Packed R-tree over the page bounds, laid out like SpatialIndex::levels:
+  // levels[0] boxes PAGE_TREE_FANOUT consecutive pages, each level above
+  // PAGE_TREE_FANOUT boxes of the one below. Consecutive pages are
+  // neighbours in Morton order, so the boxes stay tight.
+  std::vector<std::vector<Rect>> page_tree;
+
+  // Maps and validates the file. Only the header, page table and
+  // aggregate levels are touched.
+  bool open(const char *path);
+  // Copies the precomputed aggregate levels into pyramid.
+  void load_pyramid(DensityPyramid &pyramid) const;
+  // Appends the pages whose bounds intersect range, in page order.
+  void query_pages(const Rect &range, std::vector<Uint32> &found) const;
+  // Page p's columns inside the mapping, paged_page_bytes() long. Reading
+  // them faults the page in from disk.
+  const Uint8 *page_data(Uint64 p) const { return file.data + pages[p].offset; }
+};
+
+// Copies count nodes stored in the page layout at src into nodes at
+// [at, at + count).
+void copy_page_columns(const Uint8 *src, Uint32 count, NodeStore &nodes,
+                       size_t at);
+
+// Sorts nodes into pages and writes them with their aggregates. The
+// columns may be a mapped .gvb of any size: they are read in order and
+// sorted in runs of bounded size merged through a scratch file next to the
+// output, so memory use does not grow with the graph beyond the page table.
+bool write_paged_file(const char *path, const GraphColumns &columns);
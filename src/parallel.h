@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+#include <thread>
+#include <vector>
+
+inline int worker_count() {
+  int threads = (int)std::thread::hardware_concurrency();
+  return threads < 1 ? 1 : (threads > 64 ? 64 : threads);
+}
+
+// Splits [0, count) into contiguous chunks of at least min_chunk items, one
+// per hardware thread, and runs fn(begin, end) on each. The last chunk runs
+// on the calling thread.
+template <typename Fn>
+void parallel_for(size_t count, size_t min_chunk, Fn fn) {
+  size_t chunks = (size_t)worker_count();
+  if (min_chunk > 0 && count / min_chunk < chunks)
+    chunks = count / min_chunk;
+  if (chunks <= 1) {
+    if (count)
+      fn((size_t)0, count);
+    return;
+  }
+  std::vector<std::thread> threads;
+  threads.reserve(chunks - 1);
+  for (size_t c = 0; c + 1 < chunks; ++c)
+    threads.emplace_back(fn, count * c / chunks, count * (c + 1) / chunks);
+  fn(count * (chunks - 1) / chunks, count);
+  for (auto &t : threads)
+    t.join();
+}
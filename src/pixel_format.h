@@ -0,0 +1,69 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+#include "node.h"
+#include "raster.h"
+
+// Channel layouts of the 32-bit formats window surfaces come in, fixed at
+// compile time so packing a color is a few constant shifts and writing it
+// is one store. with_pixel_layout() picks the layout once per surface
+// format; code templated on it keeps the per-pixel work free of format
+// lookups. Shifts are bit positions, -1 for an unused alpha byte.
+template <int R, int G, int B, int A> struct PixelLayout {
+  static Uint32 pack(Uint8 r, Uint8 g, Uint8 b, Uint8 a) {
+    Uint32 pixel = ((Uint32)r << R) | ((Uint32)g << G) | ((Uint32)b << B);
+    if (A >= 0)
+      pixel |= (Uint32)a << (A >= 0 ? A : 0);
+    return pixel;
+  }
+  // From a NodeStore color.
+  static Uint32 pack_rgba(Uint32 rgba) {
+    return pack(rgba_r(rgba), rgba_g(rgba), rgba_b(rgba), rgba_a(rgba));
+  }
+  static Uint32 *row(SDL_Surface *surface, int y) {
+    return (Uint32 *)((Uint8 *)surface->pixels + (size_t)y * surface->pitch);
+  }
+  static void put(SDL_Surface *surface, int x, int y, Uint8 r, Uint8 g,
+                  Uint8 b, Uint8 a) {
+    row(surface, y)[x] = pack(r, g, b, a);
+  }
+  static void fill(SDL_Surface *surface, int x, int y, int count,
+                   Uint32 pixel) {
+    fill_span(row(surface, y) + x, count, pixel);
+  }
+};
+
+using PixelARGB8888 = PixelLayout<16, 8, 0, 24>;
+using PixelXRGB8888 = PixelLayout<16, 8, 0, -1>;
+using PixelABGR8888 = PixelLayout<0, 8, 16, 24>;
+using PixelBGRA8888 = PixelLayout<8, 16, 24, 0>;
+
+// Any other format, one SDL call per pixel.
+struct PixelAnyFormat {
+  static void put(SDL_Surface *surface, int x, int y, Uint8 r, Uint8 g,
+                  Uint8 b, Uint8 a) {
+    SDL_WriteSurfacePixel(surface, x, y, r, g, b, a);
+  }
+};
+
+// Calls fn with a value of the layout type matching format and returns
+// true, or returns false without calling fn when format has no layout.
+template <typename Fn> bool with_pixel_layout(SDL_PixelFormat format, Fn fn) {
+  switch (format) {
+  case SDL_PIXELFORMAT_ARGB8888:
+    fn(PixelARGB8888());
+    return true;
+  case SDL_PIXELFORMAT_XRGB8888:
+    fn(PixelXRGB8888());
+    return true;
+  case SDL_PIXELFORMAT_ABGR8888:
+    fn(PixelABGR8888());
+    return true;
+  case SDL_PIXELFORMAT_BGRA8888:
+    fn(PixelBGRA8888());
+    return true;
+  default:
+    return false;
+  }
+}
@@ -0,0 +1,184 @@
+#include "profiler.h"
+
+#ifdef PROFILE
+
+#include <stdio.h>
+
+#include "scene.h"
+
+#include "debug.h"
+
+Profiler profiler;
+
+static const char *kind_names[PROFILE_KINDS] = {
+    "frame",  "events",  "layout",  "edges",   "query",
+    "nodes",  "labels",  "widgets", "present", "visible",
+    "drawn"};
+
+Uint16 profile_thread() {
+  static std::atomic<Uint16> next{0};
+  thread_local Uint16 id = next.fetch_add(1, std::memory_order_relaxed);
+  return id;
+}
+
+void ProfileRing::push(const ProfileEvent &event) {
+  Uint64 n = head.fetch_add(1, std::memory_order_relaxed);
+  Slot &slot = slots[n & (CAPACITY - 1)];
+  slot.seq.store(2 * n + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.event = event;
+  slot.seq.store(2 * n + 2, std::memory_order_release);
+}
+
+Uint64 ProfileRing::read(Uint64 from,
+                         std::vector<ProfileEvent> &out) const {
+  Uint64 end = head.load(std::memory_order_acquire);
+  if (end - from > CAPACITY)
+    from = end - CAPACITY;
+  for (Uint64 n = from; n < end; ++n) {
+    const Slot &slot = slots[n & (CAPACITY - 1)];
+    Uint64 seq = slot.seq.load(std::memory_order_acquire);
+    if (seq != 2 * n + 2)
+      continue;
+    ProfileEvent event = slot.event;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.seq.load(std::memory_order_relaxed) == seq)
+      out.push_back(event);
+  }
+  return end;
+}
+
+void Profiler::end_frame(Uint64 frame_start) {
+  scratch.clear();
+  cursor = ring.read(cursor, scratch);
+  Frame &frame = history[frames % HISTORY];
+  frame = Frame{};
+  for (const ProfileEvent &e : scratch) {
+    if (e.start < frame_start)
+      continue;
+    if (e.kind < PROFILE_PHASES)
+      frame.ms[e.kind] += (float)(e.value - e.start) / 1e6f;
+    else if (e.kind == PROFILE_VISIBLE)
+      visible = e.value;
+    else if (e.kind == PROFILE_DRAWN)
+      frame.drawn += e.value;
+  }
+  frame.visible = visible;
+  frames++;
+}
+
+bool Profiler::write_trace(const char *path, double seconds) {
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    log("Failed to open %s\n", path);
+    return false;
+  }
+  scratch.clear();
+  ring.read(0, scratch);
+  Uint64 now = SDL_GetTicksNS();
+  Uint64 since = now - SDL_min(now, (Uint64)(seconds * 1e9));
+  fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+  bool first = true;
+  size_t written = 0;
+  for (const ProfileEvent &e : scratch) {
+    if (e.start < since)
+      continue;
+    // Chrome traces count microseconds.
+    if (e.kind < PROFILE_PHASES)
+      fprintf(f,
+              "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, "
+              "\"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}",
+              first ? "" : ",\n", kind_names[e.kind], e.thread,
+              e.start / 1e3, (e.value - e.start) / 1e3);
+    else
+      fprintf(f,
+              "%s{\"name\": \"%s\", \"ph\": \"C\", \"pid\": 1, "
+              "\"tid\": %u, \"ts\": %.3f, \"args\": {\"nodes\": %llu}}",
+              first ? "" : ",\n", kind_names[e.kind], e.thread,
+              e.start / 1e3, (unsigned long long)e.value);
+    first = false;
+    written++;
+  }
+  fprintf(f, "\n]}\n");
+  fclose(f);
+  log("Wrote %zu profile events to %s\n", written, path);
+  return true;
+}
+
+static constexpr int OVERLAY_W = 300;
+static constexpr int GRAPH_H = 80;
+static constexpr int TEXT_PX = 14;
+static constexpr int LINE_H = 16;
+static constexpr int PAD = 10;
+static constexpr float GRAPH_MS = 33.3f; // frame time at the graph's top
+
+SDL_Rect Profiler::overlay_rect(const SDL_Surface *surface) const {
+  int lines = PROFILE_PHASES + 1; // one per phase plus the node counts
+  int h = PAD + GRAPH_H + PAD + lines * LINE_H + PAD;
+  return {surface->w - OVERLAY_W - PAD, surface->h - h - PAD, OVERLAY_W, h};
+}
+
+void Profiler::draw_overlay(SDL_Surface *surface, GlyphAtlas *atlas) const {
+  const SDL_PixelFormatDetails *format =
+      SDL_GetPixelFormatDetails(surface->format);
+  SDL_Rect box = overlay_rect(surface);
+  SDL_FillSurfaceRect(surface, &box, SDL_MapRGB(format, NULL, 30, 30, 30));
+
+  // One bar per frame, newest on the right, colored by the frame budget
+  // it fits in; the line marks 60 fps.
+  Uint32 fast = SDL_MapRGB(format, NULL, 80, 200, 80);
+  Uint32 slow = SDL_MapRGB(format, NULL, 220, 200, 60);
+  Uint32 late = SDL_MapRGB(format, NULL, 220, 70, 60);
+  int graph_x = box.x + PAD, graph_y = box.y + PAD;
+  int bar_w = (OVERLAY_W - 2 * PAD) / HISTORY;
+  int shown = SDL_min(frames, HISTORY);
+  for (int k = 0; k < shown; ++k) {
+    const Frame &frame = history[(frames - shown + k) % HISTORY];
+    float ms = frame.ms[PROFILE_FRAME];
+    int h = SDL_clamp((int)(ms / GRAPH_MS * GRAPH_H), 1, GRAPH_H);
+    SDL_Rect bar = {graph_x + (HISTORY - shown + k) * bar_w,
+                    graph_y + GRAPH_H - h, bar_w, h};
+    SDL_FillSurfaceRect(surface, &bar,
+                        ms <= 16.7f ? fast : (ms <= 33.3f ? slow : late));
+  }
+  int budget_y = graph_y + GRAPH_H - (int)(16.7f / GRAPH_MS * GRAPH_H);
+  SDL_Rect budget = {graph_x, budget_y, HISTORY * bar_w, 1};
+  SDL_FillSurfaceRect(surface, &budget,
+                      SDL_MapRGB(format, NULL, 120, 120, 120));
+
+  if (!atlas || frames == 0)
+    return;
+  // Averages and the worst frame over the last AVERAGE frames.
+  int count = SDL_min(frames, AVERAGE);
+  float avg[PROFILE_PHASES] = {0};
+  float worst = 0.0f;
+  for (int k = 0; k < count; ++k) {
+    const Frame &frame = history[(frames - 1 - k) % HISTORY];
+    for (int p = 0; p < PROFILE_PHASES; ++p)
+      avg[p] += frame.ms[p] / count;
+    worst = SDL_max(worst, frame.ms[PROFILE_FRAME]);
+  }
+  const Frame &last = history[(frames - 1) % HISTORY];
+  Uint32 fg = SDL_MapRGB(format, NULL, 255, 255, 255);
+  int y = graph_y + GRAPH_H + PAD;
+  char buf[64];
+  for (int p = 0; p <= PROFILE_PHASES; ++p) {
+    if (p == PROFILE_FRAME)
+      snprintf(buf, sizeof(buf), "frame   %6.2f ms  max %6.2f", avg[p],
+               worst);
+    else if (p < PROFILE_PHASES)
+      snprintf(buf, sizeof(buf), "%-7s %6.2f ms", kind_names[p], avg[p]);
+    else if (last.visible > DETAIL_NODES) // draw() stops counting there
+      snprintf(buf, sizeof(buf), "nodes   >%d visible  %llu drawn",
+               DETAIL_NODES, (unsigned long long)last.drawn);
+    else
+      snprintf(buf, sizeof(buf), "nodes   %llu visible  %llu drawn",
+               (unsigned long long)last.visible,
+               (unsigned long long)last.drawn);
+    const GlyphAtlas::TextRun &run = atlas->layout(buf, TEXT_PX);
+    atlas->draw(surface, run, box.x + PAD, y + run.ascent, fg, &box);
+    y += LINE_H;
+  }
+}
+
+#endif
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+// Frame phase profiler. Only built when PROFILE is defined (Debug and
+// RelWithDebInfo builds); otherwise every macro below expands to nothing and
+// none of the types exist.
+//
+// Scoped timers push (phase, start, end) events into a fixed ring buffer
+// that any thread may write without locks. The main thread folds each
+// drawn frame's events into a short per-frame history for the overlay, and
+// can dump whatever the ring still holds as a Chrome trace.
+
+enum ProfilePhase {
+  PROFILE_FRAME,
+  PROFILE_EVENTS,
+  PROFILE_LAYOUT,
+  PROFILE_EDGES,
+  PROFILE_QUERY,
+  PROFILE_NODES,
+  PROFILE_LABELS,
+  PROFILE_WIDGETS,
+  PROFILE_PRESENT,
+  PROFILE_PHASES
+};
+
+// Counters share the event kinds after the phases.
+enum ProfileCounter {
+  PROFILE_VISIBLE = PROFILE_PHASES, // nodes in view, as last counted
+  PROFILE_DRAWN,                    // nodes rasterized this frame
+  PROFILE_KINDS
+};
+
+#ifdef PROFILE
+
+#include <atomic>
+#include <vector>
+
+#include "glyph_atlas.h"
+
+struct ProfileEvent {
+  Uint64 start; // ns, SDL_GetTicksNS()
+  Uint64 value; // end in ns for phases, the count for counters
+  Uint16 kind;
+  Uint16 thread;
+};
+
+// Multi-producer ring of the most recent CAPACITY events. Writers claim a
+// slot with one fetch_add and publish it through the slot's sequence
+// number; readers skip slots that are mid-write or already reused.
+struct ProfileRing {
+  static constexpr Uint64 CAPACITY = 1 << 16;
+
+  struct Slot {
+    std::atomic<Uint64> seq{0}; // 2 * n + 2 once event n is complete
+    ProfileEvent event;
+  };
+
+  std::atomic<Uint64> head{0};
+  Slot slots[CAPACITY];
+
+  void push(const ProfileEvent &event);
+  // Appends the complete events numbered [from, head) still held, oldest
+  // first, and returns head.
+  Uint64 read(Uint64 from, std::vector<ProfileEvent> &out) const;
+};
+
+struct Profiler {
+  static constexpr int HISTORY = 120; // frames shown in the graph
+  static constexpr int AVERAGE = 60;  // frames averaged in the breakdown
+
+  struct Frame {
+    float ms[PROFILE_PHASES];
+    Uint64 visible, drawn;
+  };
+
+  ProfileRing ring;
+  Uint64 cursor = 0; // first event not yet folded into a frame
+  Frame history[HISTORY];
+  int frames = 0; // frames recorded so far
+  Uint64 visible = 0;
+  std::vector<ProfileEvent> scratch;
+
+  // Folds the events since the last call that started at or after
+  // frame_start into a new history entry.
+  void end_frame(Uint64 frame_start);
+  // Writes the events of the last seconds as Chrome trace JSON.
+  bool write_trace(const char *path, double seconds);
+
+  // Screen box of the overlay, in the bottom right corner of a surface.
+  SDL_Rect overlay_rect(const SDL_Surface *surface) const;
+  // Frame time graph, per-phase averages and node counts. Without an
+  // atlas only the graph is drawn.
+  void draw_overlay(SDL_Surface *surface, GlyphAtlas *atlas) const;
+};
+
+extern Profiler profiler;
+
+Uint16 profile_thread();
+
+inline void profile_record(int kind, Uint64 start, Uint64 value) {
+  profiler.ring.push({start, value, (Uint16)kind, profile_thread()});
+}
+
+struct ProfileScope {
+  ProfilePhase phase;
+  Uint64 start;
+
+  explicit ProfileScope(ProfilePhase p) : phase(p), start(SDL_GetTicksNS()) {}
+  ~ProfileScope() { profile_record(phase, start, SDL_GetTicksNS()); }
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+// Times the rest of the enclosing block as phase.
+#define PROFILE_SCOPE(phase)                                                   \
+  ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(phase)
+// Marks a start time in var, for phases that do not fit one block.
+#define PROFILE_MARK(var) Uint64 var = SDL_GetTicksNS()
+#define PROFILE_SINCE(phase, var) profile_record(phase, var, SDL_GetTicksNS())
+#define PROFILE_COUNT(counter, count)                                          \
+  profile_record(counter, SDL_GetTicksNS(), (Uint64)(count))
+
+#else
+
+#define PROFILE_SCOPE(phase) ((void)0)
+#define PROFILE_MARK(var) ((void)0)
+#define PROFILE_SINCE(phase, var) ((void)0)
+#define PROFILE_COUNT(counter, count) ((void)0)
+
+#endif
@@ -0,0 +1,205 @@
+#include "raster.h"
+
+#include "pixel_format.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define RASTER_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) ||                                   \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RASTER_SSE2 1
+#endif
+
+#include "debug.h"
+
+void transform_nodes(const NodeStore &nodes, const std::vector<int> &visible,
+                     float pan_x, float pan_y, float zoom,
+                     const SDL_PixelFormatDetails *format, ScreenNodes &out) {
+  size_t count = visible.size();
+  out.index = visible;
+  out.x.resize(count);
+  out.y.resize(count);
+  out.half_w.resize(count);
+  out.half_h.resize(count);
+  out.inner_half_w.resize(count);
+  out.inner_half_h.resize(count);
+  out.color.resize(count);
+  out.direct = format && format->bytes_per_pixel == 4;
+
+  auto node_rgba = [&](size_t k) {
+    int i = visible[k];
+    Uint32 rgba = nodes.color[i];
+    if (nodes.selection.contains(i))
+      rgba = pack_rgba(255, 255, 0, rgba_a(rgba));
+    return rgba;
+  };
+  // The common formats pack inline; other 32-bit ones go through SDL.
+  bool packed = out.direct && with_pixel_layout(format->format, [&](auto px) {
+    for (size_t k = 0; k < count; ++k)
+      out.color[k] = px.pack_rgba(node_rgba(k));
+  });
+  for (size_t k = 0; k < count && !packed; ++k) {
+    Uint32 rgba = node_rgba(k);
+    out.color[k] = out.direct ? SDL_MapRGBA(format, NULL, rgba_r(rgba),
+                                            rgba_g(rgba), rgba_b(rgba),
+                                            rgba_a(rgba))
+                              : rgba;
+  }
+
+#ifdef RASTER_SSE2
+  // Every entry goes through the vector path, the last group padded by
+  // repeating its final node, so results never depend on lane position.
+  __m128 pan_x4 = _mm_set1_ps(pan_x), pan_y4 = _mm_set1_ps(pan_y);
+  __m128 zoom4 = _mm_set1_ps(zoom), half4 = _mm_set1_ps(0.5f);
+  __m128 zero4 = _mm_setzero_ps();
+  const float *xs = nodes.x.data(), *ys = nodes.y.data();
+  const float *ws = nodes.width.data(), *hs = nodes.height.data();
+  const float *ts = nodes.border_thickness.data();
+  for (size_t k = 0; k < count; k += 4) {
+    int n[4];
+    for (int lane = 0; lane < 4; ++lane)
+      n[lane] = visible[k + lane < count ? k + lane : count - 1];
+    __m128 x = _mm_setr_ps(xs[n[0]], xs[n[1]], xs[n[2]], xs[n[3]]);
+    __m128 y = _mm_setr_ps(ys[n[0]], ys[n[1]], ys[n[2]], ys[n[3]]);
+    __m128 w = _mm_setr_ps(ws[n[0]], ws[n[1]], ws[n[2]], ws[n[3]]);
+    __m128 h = _mm_setr_ps(hs[n[0]], hs[n[1]], hs[n[2]], hs[n[3]]);
+    __m128 t = _mm_setr_ps(ts[n[0]], ts[n[1]], ts[n[2]], ts[n[3]]);
+    __m128 hw = _mm_mul_ps(_mm_mul_ps(w, zoom4), half4);
+    __m128 hh = _mm_mul_ps(_mm_mul_ps(h, zoom4), half4);
+    __m128 border = _mm_mul_ps(t, zoom4);
+    float lanes[6][4];
+    _mm_storeu_ps(lanes[0], _mm_mul_ps(_mm_add_ps(x, pan_x4), zoom4));
+    _mm_storeu_ps(lanes[1], _mm_mul_ps(_mm_add_ps(y, pan_y4), zoom4));
+    _mm_storeu_ps(lanes[2], hw);
+    _mm_storeu_ps(lanes[3], hh);
+    _mm_storeu_ps(lanes[4], _mm_max_ps(_mm_sub_ps(hw, border), zero4));
+    _mm_storeu_ps(lanes[5], _mm_max_ps(_mm_sub_ps(hh, border), zero4));
+    size_t valid = count - k < 4 ? count - k : 4;
+    for (size_t lane = 0; lane < valid; ++lane) {
+      out.x[k + lane] = lanes[0][lane];
+      out.y[k + lane] = lanes[1][lane];
+      out.half_w[k + lane] = lanes[2][lane];
+      out.half_h[k + lane] = lanes[3][lane];
+      out.inner_half_w[k + lane] = lanes[4][lane];
+      out.inner_half_h[k + lane] = lanes[5][lane];
+    }
+  }
+#else
+  for (size_t k = 0; k < count; ++k) {
+    int i = visible[k];
+    float hw = nodes.width[i] * zoom * 0.5f;
+    float hh = nodes.height[i] * zoom * 0.5f;
+    float border = nodes.border_thickness[i] * zoom;
+    out.x[k] = (nodes.x[i] + pan_x) * zoom;
+    out.y[k] = (nodes.y[i] + pan_y) * zoom;
+    out.half_w[k] = hw;
+    out.half_h[k] = hh;
+    out.inner_half_w[k] = hw - border > 0.0f ? hw - border : 0.0f;
+    out.inner_half_h[k] = hh - border > 0.0f ? hh - border : 0.0f;
+  }
+#endif
+}
+
+void screen_node_box(const ScreenNodes &screen, size_t k, int &x1, int &y1,
+                     int &x2, int &y2) {
+  x1 = (int)(screen.x[k] - screen.half_w[k] - 1);
+  x2 = (int)(screen.x[k] + screen.half_w[k] + 1);
+  y1 = (int)(screen.y[k] - screen.half_h[k] - 1);
+  y2 = (int)(screen.y[k] + screen.half_h[k] + 1);
+}
+
+// Integer range [lo, hi] within [min, max] of c with
+// -half <= c - center <= half (inclusive) or -half < c - center < half
+// (exclusive), evaluated with the same float subtraction the per-pixel test
+// used. The rounded guess is corrected by stepping until the exact predicate
+// agrees; the steps stay inside [min, max] so far off-screen or degenerate
+// boxes cannot loop for long. lo > hi means the range is empty.
+static void pixel_range(float center, float half, bool inclusive, int min,
+                        int max, int &lo, int &hi) {
+  auto inside_lo = [&](int c) {
+    float d = (float)c - center;
+    return inclusive ? d >= -half : d > -half;
+  };
+  auto inside_hi = [&](int c) {
+    float d = (float)c - center;
+    return inclusive ? d <= half : d < half;
+  };
+  auto guess = [&](float v) {
+    if (!(v >= (float)min))
+      return min;
+    return v > (float)max ? max : (int)v;
+  };
+  lo = guess(SDL_ceilf(center - half));
+  while (lo > min && inside_lo(lo - 1))
+    --lo;
+  while (lo <= max && !inside_lo(lo))
+    ++lo;
+  hi = guess(SDL_floorf(center + half));
+  while (hi < max && inside_hi(hi + 1))
+    ++hi;
+  while (hi >= min && !inside_hi(hi))
+    --hi;
+}
+
+void raster_node(SDL_Surface *surface, const ScreenNodes &screen, size_t k,
+                 int clip_x1, int clip_y1, int clip_x2, int clip_y2) {
+  int ox1, ox2, oy1, oy2, ix1, ix2, iy1, iy2;
+  pixel_range(screen.y[k], screen.half_h[k], true, clip_y1, clip_y2, oy1,
+              oy2);
+  if (oy1 > oy2)
+    return;
+  pixel_range(screen.x[k], screen.half_w[k], true, clip_x1, clip_x2, ox1,
+              ox2);
+  if (ox1 > ox2)
+    return;
+  // Only the part of the hole inside the clip matters; if there is none the
+  // rows are solid.
+  pixel_range(screen.x[k], screen.inner_half_w[k], false, clip_x1, clip_x2,
+              ix1, ix2);
+  pixel_range(screen.y[k], screen.inner_half_h[k], false, clip_y1, clip_y2,
+              iy1, iy2);
+
+  Uint32 color = screen.color[k];
+  bool hollow = ix1 <= ix2;
+  int left_end = ix1 - 1;
+  int right_begin = ix2 + 1;
+
+  auto span = [&](int cy, int x, int count) {
+    if (screen.direct) {
+      Uint8 *row = (Uint8 *)surface->pixels + cy * surface->pitch;
+      fill_span((Uint32 *)row + x, count, color);
+      return;
+    }
+    for (int cx = x; cx < x + count; ++cx)
+      SDL_WriteSurfacePixel(surface, cx, cy, rgba_r(color), rgba_g(color),
+                            rgba_b(color), rgba_a(color));
+  };
+  for (int cy = oy1; cy <= oy2; ++cy) {
+    if (!hollow || cy < iy1 || cy > iy2) {
+      span(cy, ox1, ox2 - ox1 + 1);
+      continue;
+    }
+    if (left_end >= ox1)
+      span(cy, ox1, left_end - ox1 + 1);
+    if (ox2 >= right_begin)
+      span(cy, right_begin, ox2 - right_begin + 1);
+  }
+}
+
+void fill_span(Uint32 *dst, int count, Uint32 color) {
+  int i = 0;
+#if defined(RASTER_AVX2)
+  __m256i c8 = _mm256_set1_epi32((int)color);
+  for (; i + 8 <= count; i += 8)
+    _mm256_storeu_si256((__m256i *)(dst + i), c8);
+#endif
+#if defined(RASTER_SSE2)
+  __m128i c4 = _mm_set1_epi32((int)color);
+  for (; i + 4 <= count; i += 4)
+    _mm_storeu_si128((__m128i *)(dst + i), c4);
+#endif
+  for (; i < count; ++i)
+    dst[i] = color;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <vector>
+
+#include "node.h"
+
+// Screen-space boxes of the visible nodes for one frame, one array per
+// field so the transform runs four nodes per SIMD instruction.
+struct ScreenNodes {
+  std::vector<int> index; // node index for entry k
+  std::vector<float> x, y;
+  std::vector<float> half_w, half_h;
+  std::vector<float> inner_half_w, inner_half_h; // clamped at 0
+  // Pixel values in the surface format when direct is set, pack_rgba()
+  // values for surfaces that are not 32-bit.
+  std::vector<Uint32> color;
+  bool direct = true;
+
+  size_t size() const { return index.size(); }
+};
+
+// World to screen transform of node visible[k] for every k, with colors
+// mapped through format (selected nodes are yellow).
+void transform_nodes(const NodeStore &nodes, const std::vector<int> &visible,
+                     float pan_x, float pan_y, float zoom,
+                     const SDL_PixelFormatDetails *format, ScreenNodes &out);
+
+// Pixel box that holds every pixel raster_node may write for entry k.
+void screen_node_box(const ScreenNodes &screen, size_t k, int &x1, int &y1,
+                     int &x2, int &y2);
+
+// Draws the border of entry k as horizontal spans inside the inclusive clip
+// box. A pixel at distance (dx, dy) from the center is drawn when it lies
+// within the inclusive outer half extent and outside the exclusive inner
+// one. Handles any surface format; 32-bit ones are written directly.
+void raster_node(SDL_Surface *surface, const ScreenNodes &screen, size_t k,
+                 int clip_x1, int clip_y1, int clip_x2, int clip_y2);
+
+// Sets count 32-bit pixels starting at dst.
+void fill_span(Uint32 *dst, int count, Uint32 color);
+
+// Blends color onto each of the four byte lanes of dst with coverage alpha
+// in [0, 255], rounding like x / 255.
+inline Uint32 blend_pixel(Uint32 dst, Uint32 color, Uint32 alpha) {
+  Uint32 inv = 255 - alpha;
+  Uint32 rb = (color & 0x00FF00FF) * alpha + (dst & 0x00FF00FF) * inv +
+              0x00800080;
+  Uint32 ga = ((color >> 8) & 0x00FF00FF) * alpha +
+              ((dst >> 8) & 0x00FF00FF) * inv + 0x00800080;
+  rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+  ga = (ga + ((ga >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+  return rb | ga;
+}
@@ -0,0 +1,122 @@
+#include "scene.h"
+
+#include "profiler.h"
+
+#include "debug.h"
+
+void draw(SDL_Surface *surface, const NodeStore &nodes,
+          const SpatialIndex &index, EdgeLayer &edges, TileRenderer &renderer,
+          const DensityPyramid &pyramid, GraphHierarchy &hierarchy,
+          LabelLayer &labels, SceneState &state, GlyphAtlas *atlas,
+          float pan_x, float pan_y, float zoom, const SDL_Rect &clip) {
+  // The index matches node extents, so the clip box only needs the one
+  // pixel the raster kernel may spill over a node's edge.
+  float pad = 1.0f / zoom;
+  float orig_x1 = clip.x / zoom - pan_x - pad;
+  float orig_y1 = clip.y / zoom - pan_y - pad;
+  float orig_x2 = (clip.x + clip.w) / zoom - pan_x + pad;
+  float orig_y2 = (clip.y + clip.h) / zoom - pan_y + pad;
+
+  // Partial repaints, scrolled ones included, keep the drawing mode picked
+  // from the visible count of the last full one so they match the pixels
+  // around them. Counting stops past DETAIL_NODES, so zoomed-out frames do
+  // not visit every node.
+  size_t &view_count = state.view_count;
+  int &level = state.level;
+  bool full = clip.x == 0 && clip.y == 0 && clip.w == surface->w &&
+              clip.h == surface->h;
+  if (full) {
+    PROFILE_MARK(count_start);
+    Rect view = {orig_x1, orig_y1, orig_x2, orig_y2};
+    view_count = index.count(view, DETAIL_NODES + 1);
+    // Each level is counted only up to the limit, from the coarsest one
+    // down, so picking one costs at most DETAIL_NODES per level.
+    level = -1;
+    int coarsest = (int)hierarchy.levels.size() - 1;
+    if (view_count > DETAIL_NODES && coarsest >= 0 &&
+        hierarchy.levels[coarsest].index.count(view, DETAIL_NODES + 1) <=
+            DETAIL_NODES) {
+      level = coarsest;
+      while (level > 0 &&
+             hierarchy.levels[level - 1].index.count(view, DETAIL_NODES + 1) <=
+                 DETAIL_NODES)
+        level--;
+    }
+    PROFILE_SINCE(PROFILE_QUERY, count_start);
+    PROFILE_COUNT(PROFILE_VISIBLE, view_count);
+  }
+  // A rebuild may have dropped levels since the last full repaint.
+  if (level >= (int)hierarchy.levels.size())
+    level = -1;
+
+  if (view_count != state.logged_count || level != state.logged_level) {
+    if (level >= 0) {
+      log("Rendering Coarse Level %d: %zu super-nodes for %zu nodes\n",
+          level + 1, hierarchy.levels[level].nodes.size(), nodes.size());
+    } else if (view_count > DETAIL_NODES) {
+      log("Rendering Density Overview: over %d / %zu nodes\n", DETAIL_NODES,
+          nodes.size());
+    } else {
+      log("Rendering Detailed Nodes: %zu / %zu nodes (%.1f%%)\n",
+          view_count, nodes.size(),
+          (float)view_count / nodes.size() * 100.0f);
+    }
+    state.logged_count = view_count;
+    state.logged_level = level;
+  }
+
+  // A coarse level stands in for the real nodes and edges, labels
+  // included.
+  const NodeStore &shown = level >= 0 ? hierarchy.levels[level].nodes : nodes;
+  const SpatialIndex &shown_index =
+      level >= 0 ? hierarchy.levels[level].index : index;
+  bool detail = level >= 0 || view_count <= DETAIL_NODES;
+
+  // Edges go underneath the nodes
+  PROFILE_MARK(edges_start);
+  EdgeLayer &shown_edges = level >= 0 ? hierarchy.levels[level].edges : edges;
+  shown_edges.render(surface, shown, pan_x, pan_y, zoom, clip);
+  PROFILE_SINCE(PROFILE_EDGES, edges_start);
+
+  std::vector<int> &visible = state.visible;
+  visible.clear();
+  auto query_visible = [&]() {
+    PROFILE_SCOPE(PROFILE_QUERY);
+    shown_index.query({orig_x1, orig_y1, orig_x2, orig_y2}, visible);
+  };
+  if (!detail) {
+    PROFILE_MARK(pyramid_start);
+    bool shaded = pyramid.render(surface, nodes, pan_x, pan_y, zoom, clip);
+    PROFILE_SINCE(PROFILE_NODES, pyramid_start);
+    // Zoomed in too far for the pyramid's base level, the visible nodes
+    // are plotted one pixel each instead.
+    if (!shaded) {
+      query_visible();
+      PROFILE_SCOPE(PROFILE_NODES);
+      renderer.render_points(surface, nodes, visible, pan_x, pan_y, zoom,
+                             clip);
+    }
+  } else {
+    query_visible();
+    PROFILE_SCOPE(PROFILE_NODES);
+    renderer.render_nodes(surface, shown, visible, pan_x, pan_y, zoom, clip);
+    // Selected nodes stay visible inside their super-nodes as single
+    // pixels, as over the pyramid.
+    if (level >= 0 && !nodes.selection.empty())
+      renderer.render_points(surface, nodes, nodes.selection.active, pan_x,
+                             pan_y, zoom, clip);
+  }
+  PROFILE_COUNT(PROFILE_DRAWN, visible.size());
+
+  // Labels go on top of the nodes. Like the drawing mode they are picked
+  // on full repaints only, so partial ones redraw the same labels.
+  PROFILE_SCOPE(PROFILE_LABELS);
+  if (full) {
+    if (atlas && detail)
+      labels.place(surface, shown, visible, pan_x, pan_y, zoom, *atlas);
+    else
+      labels.clear();
+  }
+  if (atlas)
+    labels.render(surface, shown, *atlas, clip);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <vector>
+
+#include "density_pyramid.h"
+#include "edges.h"
+#include "glyph_atlas.h"
+#include "graph_hierarchy.h"
+#include "labels.h"
+#include "node.h"
+#include "spatial_index.h"
+#include "tile_renderer.h"
+
+// Above this many visible nodes the finest coarse level with at most this
+// many in view replaces the graph, or the density pyramid if none has that
+// few.
+#define DETAIL_NODES 10000
+
+// What draw() keeps between calls for one view: the drawing mode picked on
+// the last full repaint, which partial ones reuse so they match the pixels
+// around them, and a scratch list of the nodes in the clip.
+struct SceneState {
+  // Visible nodes at the last full repaint, counted up to DETAIL_NODES + 1.
+  size_t view_count = 0;
+  // Finest coarse level that fits DETAIL_NODES in view, -1 for none.
+  int level = -1;
+  size_t logged_count = (size_t)-1; // mode last logged
+  int logged_level = -1;
+  std::vector<int> visible;
+};
+
+// Draws edges, nodes and labels for the view into clip, which the caller
+// has cleared. The drawing mode and the labels are picked on full repaints
+// (clip covering the surface) and reused by partial ones. hierarchy may be
+// empty, in which case only the pyramid stands in for dense views. atlas
+// may be NULL, in which case no labels are drawn.
+void draw(SDL_Surface *surface, const NodeStore &nodes,
+          const SpatialIndex &index, EdgeLayer &edges, TileRenderer &renderer,
+          const DensityPyramid &pyramid, GraphHierarchy &hierarchy,
+          LabelLayer &labels, SceneState &state, GlyphAtlas *atlas,
+          float pan_x, float pan_y, float zoom, const SDL_Rect &clip);
@@ -0,0 +1,184 @@
+#include "search_index.h"
+
+#include <thread>
+
+#include "debug.h"
+
+static Uint32 hash_u32(Uint32 v) {
+  v ^= v >> 16;
+  v *= 0x85ebca6bu;
+  v ^= v >> 13;
+  v *= 0xc2b2ae35u;
+  v ^= v >> 16;
+  return v;
+}
+
+static Uint64 pow10(int e) {
+  Uint64 p = 1;
+  while (e-- > 0)
+    p *= 10;
+  return p;
+}
+
+void SearchIndex::build(const NodeStore &source) {
+  nodes = &source;
+  size_t n = source.size();
+  const Uint32 *data = source.data.data();
+  // Nodes removed by live updates can never be found again.
+  bool any_removed = !source.removed.empty();
+  auto live = [&](size_t i) {
+    return !any_removed || !source.removed.contains((int)i);
+  };
+
+  // Hash table on a second thread while this one sorts.
+  std::thread hash_thread([&]() {
+    size_t capacity = 16;
+    while (capacity < n + n / 2)
+      capacity *= 2;
+    slots.assign(capacity, 0);
+    mask = (Uint32)(capacity - 1);
+    for (size_t i = 0; i < n; ++i) {
+      if (!live(i))
+        continue;
+      Uint32 slot = hash_u32(data[i]) & mask;
+      while (slots[slot] && data[slots[slot] - 1] != data[i])
+        slot = (slot + 1) & mask;
+      if (!slots[slot])
+        slots[slot] = (Uint32)i + 1;
+    }
+  });
+
+  // LSD radix sort of (data << 32 | index) on the data bytes, stable so
+  // equal values stay in index order.
+  std::vector<Uint64> keys, scratch;
+  keys.reserve(n);
+  for (size_t i = 0; i < n; ++i)
+    if (live(i))
+      keys.push_back(((Uint64)data[i] << 32) | (Uint64)i);
+  scratch.resize(keys.size());
+  for (int shift = 32; shift < 64; shift += 8) {
+    size_t counts[257] = {0};
+    for (Uint64 k : keys)
+      counts[((k >> shift) & 0xFF) + 1]++;
+    for (int b = 0; b < 256; ++b)
+      counts[b + 1] += counts[b];
+    for (Uint64 k : keys)
+      scratch[counts[(k >> shift) & 0xFF]++] = k;
+    keys.swap(scratch);
+  }
+  sorted.resize(keys.size());
+  for (size_t k = 0; k < keys.size(); ++k)
+    sorted[k] = (Uint32)keys[k];
+
+  hash_thread.join();
+  log("Search index: %zu nodes, %zu KiB\n", n, memory_bytes() / 1024);
+}
+
+int SearchIndex::find(Uint32 value) const {
+  if (slots.empty())
+    return -1;
+  const Uint32 *data = nodes->data.data();
+  for (Uint32 slot = hash_u32(value) & mask; slots[slot];
+       slot = (slot + 1) & mask) {
+    if (data[slots[slot] - 1] == value)
+      return (int)slots[slot] - 1;
+  }
+  return -1;
+}
+
+int SearchIndex::find_visible(Uint32 value) const {
+  int first = find(value);
+  if (first < 0 || !nodes->hidden.contains(first))
+    return first;
+  // Equal values are in index order in sorted.
+  const Uint32 *data = nodes->data.data();
+  Uint32 n = (Uint32)sorted.size();
+  for (Uint32 k = lower_bound(value, 0, n); k < n && data[sorted[k]] == value;
+       ++k)
+    if (!nodes->hidden.contains((int)sorted[k]))
+      return (int)sorted[k];
+  return -1;
+}
+
+Uint32 SearchIndex::lower_bound(Uint64 value, Uint32 lo, Uint32 hi) const {
+  const Uint32 *data = nodes->data.data();
+  while (lo < hi) {
+    Uint32 mid = lo + (hi - lo) / 2;
+    if (data[sorted[mid]] < value)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+void PrefixSearch::reset(const SearchIndex &index) {
+  Runs all;
+  Uint32 n = (Uint32)index.sorted.size();
+  all.begin[0] = all.end[0] = 0;
+  for (int d = 1; d <= SearchIndex::MAX_DIGITS; ++d) {
+    Uint64 lo = d == 1 ? 0 : pow10(d - 1);
+    all.begin[d] = index.lower_bound(lo, 0, n);
+    all.end[d] = index.lower_bound(pow10(d), 0, n);
+  }
+  all.count = n;
+  stack.assign(1, all);
+}
+
+Uint64 PrefixSearch::push(const SearchIndex &index, int digit) {
+  if (stack.empty())
+    reset(index);
+  Runs next = stack.back();
+  next.value = next.value * 10 + (Uint64)digit;
+  next.digits++;
+  next.count = 0;
+  // A leading zero only matches the value 0 itself.
+  bool leading_zero = next.digits > 1 && stack.back().value == 0;
+  for (int d = 0; d <= SearchIndex::MAX_DIGITS; ++d) {
+    if (d < next.digits || leading_zero || (next.value == 0 && d > 1)) {
+      next.end[d] = next.begin[d];
+      continue;
+    }
+    Uint64 scale = pow10(d - next.digits);
+    Uint32 lo = next.begin[d], hi = next.end[d];
+    next.begin[d] = index.lower_bound(next.value * scale, lo, hi);
+    next.end[d] =
+        index.lower_bound((next.value + 1) * scale, next.begin[d], hi);
+    next.count += next.end[d] - next.begin[d];
+  }
+  stack.push_back(next);
+  return next.count;
+}
+
+void PrefixSearch::pop() {
+  if (stack.size() > 1)
+    stack.pop_back();
+}
+
+int PrefixSearch::top(const SearchIndex &index, int *out, int max) const {
+  if (stack.empty())
+    return 0;
+  const Runs &runs = stack.back();
+  const NodeStore &nodes = *index.nodes;
+  bool any_hidden = !nodes.hidden.empty();
+  int written = 0;
+  // Fewer digits means a smaller value, so the runs are already in order.
+  // Each value's run of equal entries is found with a search, and within it
+  // the first node that is not hidden is the one find_visible() returns.
+  for (int d = 0; d <= SearchIndex::MAX_DIGITS && written < max; ++d) {
+    Uint32 k = runs.begin[d];
+    while (k < runs.end[d] && written < max) {
+      Uint32 value = nodes.data[index.sorted[k]];
+      Uint32 next = index.lower_bound((Uint64)value + 1, k + 1, runs.end[d]);
+      for (; k < next; ++k) {
+        int node = (int)index.sorted[k];
+        if (!any_hidden || !nodes.hidden.contains(node)) {
+          out[written++] = node;
+          break;
+        }
+      }
+      k = next;
+    }
+  }
+  return written;
+}
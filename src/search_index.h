@@ -0,0 +1,62 @@
+#pragma once
+
+#include <SDL3/SDL_stdinc.h>
+#include <vector>
+
+#include "node.h"
+
+// Lookup structures over NodeStore::data, built once per loaded graph and
+// again after live updates. Nodes removed by updates are left out.
+//
+// slots is an open-addressing hash table holding node index + 1 (0 marks an
+// empty slot) for the first node with each value, so an exact lookup is one
+// probe sequence. sorted holds every remaining node index ordered by data,
+// which turns a decimal prefix into at most ten contiguous runs, one per
+// digit count.
+struct SearchIndex {
+  static constexpr int MAX_DIGITS = 10; // digits of the largest Uint32
+
+  const NodeStore *nodes = nullptr;
+  std::vector<Uint32> slots;
+  Uint32 mask = 0;
+  std::vector<Uint32> sorted;
+
+  void build(const NodeStore &source);
+  // Lowest node index whose data equals value, or -1.
+  int find(Uint32 value) const;
+  // Lowest index of a node with that value that is not hidden, or -1.
+  int find_visible(Uint32 value) const;
+  // First position in sorted whose data is >= value, searching [lo, hi).
+  Uint32 lower_bound(Uint64 value, Uint32 lo, Uint32 hi) const;
+  size_t memory_bytes() const {
+    return (slots.capacity() + sorted.capacity()) * sizeof(Uint32);
+  }
+};
+
+// Matches of a decimal prefix typed one digit at a time. Each pushed digit
+// narrows the runs of the previous prefix with binary searches inside them,
+// and popping restores the previous runs from the stack, so a keystroke
+// never rescans the nodes.
+struct PrefixSearch {
+  // Matching positions in SearchIndex::sorted, one run per digit count of
+  // the matching values.
+  struct Runs {
+    Uint32 begin[SearchIndex::MAX_DIGITS + 1];
+    Uint32 end[SearchIndex::MAX_DIGITS + 1];
+    Uint64 value = 0; // the prefix typed so far
+    int digits = 0;
+    Uint64 count = 0;
+  };
+
+  std::vector<Runs> stack; // stack[0] matches everything
+
+  void reset(const SearchIndex &index);
+  // Appends a digit to the prefix and returns the new match count.
+  Uint64 push(const SearchIndex &index, int digit);
+  void pop();
+  Uint64 count() const { return stack.empty() ? 0 : stack.back().count; }
+  // Writes up to max matching node indices with distinct data, smallest
+  // first; the node for each value is the one find_visible() returns, and
+  // values whose nodes are all hidden are left out.
+  int top(const SearchIndex &index, int *out, int max) const;
+};
@@ -0,0 +1,204 @@
+#include "selection_tools.h"
+
+#include <stdio.h>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                   \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SELECT_SSE2 1
+#endif
+
+#include "debug.h"
+
+// Horizontal bands a polygon is split into. A lasso crosses any one band
+// with a handful of edges, so each center is tested against those only.
+static constexpr int POLYGON_BANDS = 64;
+
+struct PolygonEdge {
+  float x0, y0, y1;
+  float slope; // dx / dy, 0 for horizontal edges, which never cross
+};
+
+void query_box(const NodeStore &nodes, const SpatialIndex &index,
+               const Rect &box, std::vector<int> &found) {
+  std::vector<int> candidates;
+  index.query(box, candidates);
+  for (int i : candidates)
+    if (box.contains(nodes.x[i], nodes.y[i]))
+      found.push_back(i);
+}
+
+// Crossing-number test of count centers against one band's edges. Both
+// paths evaluate the same expressions, so results do not depend on which
+// lane a node lands in.
+static void test_band(const PolygonEdge *edges, size_t edge_count,
+                      const float *px, const float *py, const int *ids,
+                      size_t count, std::vector<int> &found) {
+  size_t k = 0;
+#ifdef SELECT_SSE2
+  for (; k + 4 <= count; k += 4) {
+    __m128 x = _mm_loadu_ps(px + k), y = _mm_loadu_ps(py + k);
+    __m128 inside = _mm_setzero_ps();
+    for (size_t e = 0; e < edge_count; ++e) {
+      const PolygonEdge &edge = edges[e];
+      __m128 y0 = _mm_set1_ps(edge.y0);
+      __m128 crosses = _mm_xor_ps(_mm_cmpgt_ps(y0, y),
+                                  _mm_cmpgt_ps(_mm_set1_ps(edge.y1), y));
+      __m128 cross_x =
+          _mm_add_ps(_mm_set1_ps(edge.x0),
+                     _mm_mul_ps(_mm_sub_ps(y, y0), _mm_set1_ps(edge.slope)));
+      inside = _mm_xor_ps(inside,
+                          _mm_and_ps(crosses, _mm_cmplt_ps(x, cross_x)));
+    }
+    int mask = _mm_movemask_ps(inside);
+    for (int lane = 0; lane < 4; ++lane)
+      if ((mask >> lane) & 1)
+        found.push_back(ids[k + lane]);
+  }
+#endif
+  for (; k < count; ++k) {
+    bool inside = false;
+    for (size_t e = 0; e < edge_count; ++e) {
+      const PolygonEdge &edge = edges[e];
+      bool crosses = (edge.y0 > py[k]) != (edge.y1 > py[k]);
+      float cross_x = edge.x0 + (py[k] - edge.y0) * edge.slope;
+      if (crosses && px[k] < cross_x)
+        inside = !inside;
+    }
+    if (inside)
+      found.push_back(ids[k]);
+  }
+}
+
+void query_polygon(const NodeStore &nodes, const SpatialIndex &index,
+                   const float *xs, const float *ys, int vertices,
+                   std::vector<int> &found) {
+  if (vertices < 3)
+    return;
+  Rect box = {xs[0], ys[0], xs[0], ys[0]};
+  for (int v = 1; v < vertices; ++v) {
+    box.x1 = xs[v] < box.x1 ? xs[v] : box.x1;
+    box.y1 = ys[v] < box.y1 ? ys[v] : box.y1;
+    box.x2 = xs[v] > box.x2 ? xs[v] : box.x2;
+    box.y2 = ys[v] > box.y2 ? ys[v] : box.y2;
+  }
+  float band_h = (box.y2 - box.y1) / POLYGON_BANDS;
+  if (!(band_h > 0.0f))
+    return;
+  auto band_of = [&](float y) {
+    return SDL_clamp((int)((y - box.y1) / band_h), 0, POLYGON_BANDS - 1);
+  };
+
+  // Edges by band: counted, then placed, so each band's edges are
+  // contiguous.
+  std::vector<size_t> edge_begin(POLYGON_BANDS + 1, 0);
+  for (int v = 0; v < vertices; ++v) {
+    int w = v + 1 < vertices ? v + 1 : 0;
+    int b1 = band_of(SDL_max(ys[v], ys[w]));
+    for (int b = band_of(SDL_min(ys[v], ys[w])); b <= b1; ++b)
+      edge_begin[b + 1]++;
+  }
+  for (int b = 0; b < POLYGON_BANDS; ++b)
+    edge_begin[b + 1] += edge_begin[b];
+  std::vector<PolygonEdge> edges(edge_begin[POLYGON_BANDS]);
+  std::vector<size_t> cursor(edge_begin.begin(), edge_begin.end() - 1);
+  for (int v = 0; v < vertices; ++v) {
+    int w = v + 1 < vertices ? v + 1 : 0;
+    float dy = ys[w] - ys[v];
+    PolygonEdge edge = {xs[v], ys[v], ys[w],
+                        dy != 0.0f ? (xs[w] - xs[v]) / dy : 0.0f};
+    int b1 = band_of(SDL_max(ys[v], ys[w]));
+    for (int b = band_of(SDL_min(ys[v], ys[w])); b <= b1; ++b)
+      edges[cursor[b]++] = edge;
+  }
+
+  // Candidate centers by band, in the same way.
+  std::vector<int> candidates;
+  index.query(box, candidates);
+  std::vector<size_t> point_begin(POLYGON_BANDS + 1, 0);
+  for (int i : candidates)
+    if (box.contains(nodes.x[i], nodes.y[i]))
+      point_begin[band_of(nodes.y[i]) + 1]++;
+  for (int b = 0; b < POLYGON_BANDS; ++b)
+    point_begin[b + 1] += point_begin[b];
+  size_t points = point_begin[POLYGON_BANDS];
+  std::vector<float> px(points), py(points);
+  std::vector<int> ids(points);
+  cursor.assign(point_begin.begin(), point_begin.end() - 1);
+  for (int i : candidates) {
+    if (!box.contains(nodes.x[i], nodes.y[i]))
+      continue;
+    size_t k = cursor[band_of(nodes.y[i])]++;
+    px[k] = nodes.x[i];
+    py[k] = nodes.y[i];
+    ids[k] = i;
+  }
+
+  for (int b = 0; b < POLYGON_BANDS; ++b) {
+    size_t first = point_begin[b];
+    test_band(edges.data() + edge_begin[b], edge_begin[b + 1] - edge_begin[b],
+              px.data() + first, py.data() + first, ids.data() + first,
+              point_begin[b + 1] - first, found);
+  }
+}
+
+void select_nodes(NodeStore &nodes, const std::vector<int> &found) {
+  nodes.selection.clear();
+  for (int i : found)
+    nodes.selection.add(i);
+}
+
+bool selection_bounds(const NodeStore &nodes, Rect &bounds) {
+  if (nodes.selection.empty())
+    return false;
+  bounds = nodes.box(nodes.selection.active[0]);
+  for (int i : nodes.selection.active) {
+    Rect r = nodes.box(i);
+    bounds.x1 = SDL_min(bounds.x1, r.x1);
+    bounds.y1 = SDL_min(bounds.y1, r.y1);
+    bounds.x2 = SDL_max(bounds.x2, r.x2);
+    bounds.y2 = SDL_max(bounds.y2, r.y2);
+  }
+  return true;
+}
+
+void recolor_selection(NodeStore &nodes, Uint32 rgba) {
+  for (int i : nodes.selection.active)
+    nodes.color[i] = rgba;
+}
+
+void hide_selection(NodeStore &nodes) {
+  for (int i : nodes.selection.active)
+    nodes.hidden.add(i);
+  nodes.selection.clear();
+}
+
+void show_all(NodeStore &nodes) {
+  nodes.hidden.clear();
+  for (int i : nodes.removed.active)
+    nodes.hidden.add(i);
+}
+
+bool export_selection(const NodeStore &nodes, const char *path) {
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    log("Failed to create %s\n", path);
+    return false;
+  }
+  // Formatted into one buffer and written at once; a selection can be
+  // millions of nodes.
+  std::string text;
+  text.reserve(nodes.selection.size() * 11);
+  char line[16];
+  for (int i : nodes.selection.active) {
+    int len = snprintf(line, sizeof(line), "%u\n", nodes.data[i]);
+    text.append(line, len);
+  }
+  bool ok = fwrite(text.data(), 1, text.size(), f) == text.size();
+  if (fclose(f) != 0)
+    ok = false;
+  if (!ok)
+    log("Failed to write %s\n", path);
+  return ok;
+}
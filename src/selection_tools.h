@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+
+#include "node.h"
+#include "spatial_index.h"
+
+// Region selection and bulk operations on NodeStore::selection.
+//
+// A node is inside a region when its center is. Regions are resolved in
+// two steps: the spatial index narrows the nodes to those overlapping the
+// region's bounding box, then the centers are tested against the exact
+// shape. Polygon tests split the polygon into horizontal bands and test
+// each band's centers against only the edges crossing it, four at a time
+// with SSE2.
+
+// Appends the nodes whose center lies inside box.
+void query_box(const NodeStore &nodes, const SpatialIndex &index,
+               const Rect &box, std::vector<int> &found);
+// Appends the nodes whose center lies inside the polygon (xs[k], ys[k]),
+// closed implicitly, by the even-odd rule.
+void query_polygon(const NodeStore &nodes, const SpatialIndex &index,
+                   const float *xs, const float *ys, int vertices,
+                   std::vector<int> &found);
+
+// Replaces the selection with found.
+void select_nodes(NodeStore &nodes, const std::vector<int> &found);
+// Union of the selected nodes' extents; false if nothing is selected.
+bool selection_bounds(const NodeStore &nodes, Rect &bounds);
+void recolor_selection(NodeStore &nodes, Uint32 rgba);
+// Moves the selected nodes to NodeStore::hidden.
+void hide_selection(NodeStore &nodes);
+// Shows every hidden node but the removed ones.
+void show_all(NodeStore &nodes);
+// Writes the selected nodes' data values, one per line.
+bool export_selection(const NodeStore &nodes, const char *path);
@@ -0,0 +1,333 @@
+#include "spatial_index.h"
+
+#include <algorithm>
+
+#include "parallel.h"
+
+#include "debug.h"
+
+static Rect merge(const Rect &a, const Rect &b) {
+  return {a.x1 < b.x1 ? a.x1 : b.x1, a.y1 < b.y1 ? a.y1 : b.y1,
+          a.x2 > b.x2 ? a.x2 : b.x2, a.y2 > b.y2 ? a.y2 : b.y2};
+}
+
+// Sorts chunks on separate threads, then merges neighbouring runs pairwise,
+// also in parallel, until one run is left.
+static void parallel_sort(std::vector<Uint64> &keys) {
+  size_t n = keys.size();
+  size_t runs = (size_t)worker_count();
+  if (n < 65536 || runs <= 1) {
+    std::sort(keys.begin(), keys.end());
+    return;
+  }
+  std::vector<size_t> bounds(runs + 1);
+  for (size_t r = 0; r <= runs; ++r)
+    bounds[r] = n * r / runs;
+  parallel_for(runs, 1, [&](size_t begin, size_t end) {
+    for (size_t r = begin; r < end; ++r)
+      std::sort(keys.begin() + bounds[r], keys.begin() + bounds[r + 1]);
+  });
+  std::vector<Uint64> scratch(n);
+  while (bounds.size() > 2) {
+    size_t pairs = (bounds.size() - 1) / 2;
+    parallel_for(pairs, 1, [&](size_t begin, size_t end) {
+      for (size_t p = begin; p < end; ++p) {
+        size_t lo = bounds[2 * p], mid = bounds[2 * p + 1],
+               hi = bounds[2 * p + 2];
+        std::merge(keys.begin() + lo, keys.begin() + mid, keys.begin() + mid,
+                   keys.begin() + hi, scratch.begin() + lo);
+      }
+    });
+    // An odd trailing run is carried over unchanged.
+    size_t tail = bounds[2 * pairs];
+    std::copy(keys.begin() + tail, keys.end(), scratch.begin() + tail);
+    keys.swap(scratch);
+    std::vector<size_t> merged;
+    for (size_t b = 0; b < bounds.size(); b += 2)
+      merged.push_back(bounds[b]);
+    if (merged.back() != n)
+      merged.push_back(n);
+    bounds.swap(merged);
+  }
+}
+
+void SpatialIndex::build(const NodeStore &source) {
+  nodes = &source;
+  size_t n = source.size();
+  order.resize(n);
+  levels.clear();
+  if (n == 0)
+    return;
+
+  const float *xs = source.x.data();
+  const float *ys = source.y.data();
+  Rect b = {xs[0], ys[0], xs[0], ys[0]};
+  for (size_t i = 0; i < n; ++i)
+    b = merge(b, {xs[i], ys[i], xs[i], ys[i]});
+  MortonGrid grid(b);
+
+  // Morton code in the high half, node index in the low half, so a plain
+  // integer sort orders by code and keeps ties deterministic.
+  std::vector<Uint64> keys(n);
+  parallel_for(n, 16384, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      keys[i] = ((Uint64)grid.code(xs[i], ys[i]) << 32) | (Uint64)i;
+    }
+  });
+  parallel_sort(keys);
+  parallel_for(n, 16384, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      order[i] = (int)(keys[i] & 0xFFFFFFFFu);
+  });
+
+  ranks.clear();
+  edits = 0;
+  refit();
+  log("Spatial index: %zu nodes, %zu levels, %zu KiB\n", n, levels.size(),
+      memory_bytes() / 1024);
+}
+
+void SpatialIndex::adopt(const NodeStore &source, std::vector<int> sorted) {
+  nodes = &source;
+  order.swap(sorted);
+  levels.clear();
+  ranks.clear();
+  edits = 0;
+  refit();
+}
+
+void SpatialIndex::refit() {
+  size_t n = order.size();
+  if (n == 0)
+    return;
+  const NodeStore &source = *nodes;
+
+  if (levels.empty()) {
+    size_t count = n;
+    do {
+      count = (count + FANOUT - 1) / FANOUT;
+      levels.emplace_back(count);
+    } while (count > 1);
+  }
+
+  std::vector<Rect> &leaves = levels[0];
+  parallel_for(leaves.size(), 1024, [&](size_t begin, size_t end) {
+    for (size_t leaf = begin; leaf < end; ++leaf) {
+      size_t first = leaf * FANOUT;
+      size_t last = std::min(first + FANOUT, n);
+      Rect box = source.box(order[first]);
+      for (size_t k = first + 1; k < last; ++k)
+        box = merge(box, source.box(order[k]));
+      leaves[leaf] = box;
+    }
+  });
+  for (size_t l = 1; l < levels.size(); ++l) {
+    const std::vector<Rect> &below = levels[l - 1];
+    std::vector<Rect> &level = levels[l];
+    for (size_t j = 0; j < level.size(); ++j) {
+      size_t first = j * FANOUT;
+      size_t last = std::min(first + FANOUT, below.size());
+      Rect box = below[first];
+      for (size_t k = first + 1; k < last; ++k)
+        box = merge(box, below[k]);
+      level[j] = box;
+    }
+  }
+}
+
+// Recomputes the boxes from the leaf holding rank up to the root.
+void SpatialIndex::refit_path(size_t rank) {
+  const NodeStore &source = *nodes;
+  size_t j = rank / FANOUT;
+  size_t first = j * FANOUT;
+  size_t last = std::min(first + FANOUT, order.size());
+  Rect box = source.box(order[first]);
+  for (size_t k = first + 1; k < last; ++k)
+    box = merge(box, source.box(order[k]));
+  levels[0][j] = box;
+  for (size_t l = 1; l < levels.size(); ++l) {
+    const std::vector<Rect> &below = levels[l - 1];
+    j /= FANOUT;
+    first = j * FANOUT;
+    last = std::min(first + FANOUT, below.size());
+    box = below[first];
+    for (size_t k = first + 1; k < last; ++k)
+      box = merge(box, below[k]);
+    levels[l][j] = box;
+  }
+}
+
+void SpatialIndex::update(int i) {
+  if (ranks.size() != order.size()) {
+    ranks.resize(order.size());
+    for (size_t r = 0; r < order.size(); ++r)
+      ranks[order[r]] = (int)r;
+  }
+  edits++;
+  refit_path(ranks[i]);
+}
+
+void SpatialIndex::insert(int i) {
+  order.push_back(i);
+  if (ranks.size() + 1 == order.size())
+    ranks.push_back((int)order.size() - 1);
+  edits++;
+  if (levels.empty()) {
+    refit();
+    return;
+  }
+  // Levels gain a box whenever the one below outgrows them, and the tree
+  // a level once the root has company.
+  size_t count = order.size();
+  for (size_t l = 0;; ++l) {
+    count = (count + FANOUT - 1) / FANOUT;
+    if (l == levels.size())
+      levels.emplace_back(count);
+    else if (levels[l].size() < count)
+      levels[l].resize(count);
+    if (count == 1)
+      break;
+  }
+  refit_path(order.size() - 1);
+}
+
+size_t SpatialIndex::memory_bytes() const {
+  size_t bytes = (order.capacity() + ranks.capacity()) * sizeof(int);
+  for (const auto &level : levels)
+    bytes += level.capacity() * sizeof(Rect);
+  return bytes;
+}
+
+// Calls fn(idx) for every node overlapping range until fn returns false.
+template <typename Fn>
+void SpatialIndex::visit(const Rect &range, Fn fn) const {
+  if (order.empty())
+    return;
+  const NodeStore &source = *nodes;
+  bool any_hidden = !source.hidden.empty();
+
+  // Depth-first over (level, box) pairs; FANOUT entries per level at most.
+  struct Entry {
+    int level;
+    size_t index;
+  };
+  Entry stack[FANOUT * 16];
+  int top = 0;
+  stack[top++] = {(int)levels.size() - 1, 0};
+  while (top > 0) {
+    Entry e = stack[--top];
+    if (!levels[e.level][e.index].intersects(range))
+      continue;
+    size_t first = e.index * FANOUT;
+    if (e.level == 0) {
+      size_t last = std::min(first + FANOUT, order.size());
+      for (size_t k = first; k < last; ++k) {
+        int idx = order[k];
+        if (any_hidden && source.hidden.contains(idx))
+          continue;
+        if (source.box(idx).intersects(range) && !fn(idx))
+          return;
+      }
+      continue;
+    }
+    size_t last = std::min(first + FANOUT, levels[e.level - 1].size());
+    for (size_t k = last; k-- > first;)
+      stack[top++] = {e.level - 1, k};
+  }
+}
+
+void SpatialIndex::query(const Rect &range, std::vector<int> &found) const {
+  visit(range, [&](int idx) {
+    found.push_back(idx);
+    return true;
+  });
+}
+
+size_t SpatialIndex::count(const Rect &range, size_t limit) const {
+  size_t found = 0;
+  if (limit == 0)
+    return 0;
+  visit(range, [&](int) { return ++found < limit; });
+  return found;
+}
+
+// Squared distance from (x, y) to r, 0 inside it.
+static float box_distance(const Rect &r, float x, float y) {
+  float dx = SDL_max(SDL_max(r.x1 - x, x - r.x2), 0.0f);
+  float dy = SDL_max(SDL_max(r.y1 - y, y - r.y2), 0.0f);
+  return dx * dx + dy * dy;
+}
+
+void SpatialIndex::nearest(float x, float y, size_t k, float max_distance,
+                           std::vector<int> &found) const {
+  if (order.empty() || k == 0 || !(max_distance >= 0.0f))
+    return;
+  const NodeStore &source = *nodes;
+  bool any_hidden = !source.hidden.empty();
+  float limit = max_distance * max_distance;
+
+  // Best first over boxes and nodes. Nodes are drawn in index order, so at
+  // equal distance the later rank wins. A box ranks as the last node it
+  // covers and is never further than its nodes, so no node can be passed
+  // over for one still inside an unopened box.
+  struct Candidate {
+    float distance;
+    size_t rank; // the box's last node rank, or the node's own
+    size_t index;
+    int level; // -1 for a node
+  };
+  auto worse = [](const Candidate &a, const Candidate &b) {
+    return a.distance > b.distance ||
+           (a.distance == b.distance && a.rank < b.rank);
+  };
+  std::vector<size_t> span(levels.size());
+  size_t nodes_per_box = FANOUT;
+  for (size_t l = 0; l < levels.size(); ++l, nodes_per_box *= FANOUT)
+    span[l] = nodes_per_box;
+  auto push_box = [&](std::vector<Candidate> &heap, int level, size_t j) {
+    float d = box_distance(levels[level][j], x, y);
+    if (d > limit)
+      return;
+    size_t last = SDL_min((j + 1) * span[level], order.size()) - 1;
+    heap.push_back({d, last, j, level});
+    std::push_heap(heap.begin(), heap.end(), worse);
+  };
+
+  std::vector<Candidate> heap;
+  heap.reserve(FANOUT * levels.size() * 2);
+  size_t wanted = found.size() + k;
+  push_box(heap, (int)levels.size() - 1, 0);
+  while (!heap.empty() && found.size() < wanted) {
+    std::pop_heap(heap.begin(), heap.end(), worse);
+    Candidate c = heap.back();
+    heap.pop_back();
+    if (c.level < 0) {
+      found.push_back(order[c.index]);
+      continue;
+    }
+    size_t first = c.index * FANOUT;
+    if (c.level == 0) {
+      size_t last = std::min(first + FANOUT, order.size());
+      for (size_t r = first; r < last; ++r) {
+        int idx = order[r];
+        if (any_hidden && source.hidden.contains(idx))
+          continue;
+        float d = box_distance(source.box(idx), x, y);
+        if (d > limit)
+          continue;
+        heap.push_back({d, r, r, -1});
+        std::push_heap(heap.begin(), heap.end(), worse);
+      }
+      continue;
+    }
+    size_t last = std::min(first + FANOUT, levels[c.level - 1].size());
+    for (size_t j = first; j < last; ++j)
+      push_box(heap, c.level - 1, j);
+  }
+}
+
+int SpatialIndex::pick(float x, float y, float radius) const {
+  std::vector<int> found;
+  nearest(x, y, 1, radius, found);
+  return found.empty() ? -1 : found[0];
+}
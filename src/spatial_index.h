@@ -0,0 +1,98 @@
+#pragma once
+
+#include <SDL3/SDL_stdinc.h>
+#include <vector>
+
+#include "node.h"
+
+// Quantizes points to 16 bits per axis over bounds and interleaves the
+// bits, so sorting by code keeps nearby points together.
+struct MortonGrid {
+  float x1, y1, sx, sy;
+
+  explicit MortonGrid(const Rect &bounds)
+      : x1(bounds.x1), y1(bounds.y1),
+        sx(bounds.x2 > bounds.x1 ? 65535.0f / (bounds.x2 - bounds.x1) : 0.0f),
+        sy(bounds.y2 > bounds.y1 ? 65535.0f / (bounds.y2 - bounds.y1)
+                                 : 0.0f) {}
+
+  // Spreads the low 16 bits of v to the even bit positions.
+  static Uint32 spread(Uint32 v) {
+    v &= 0xFFFF;
+    v = (v | (v << 8)) & 0x00FF00FF;
+    v = (v | (v << 4)) & 0x0F0F0F0F;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+  }
+  Uint32 code(float x, float y) const {
+    return spread((Uint32)((x - x1) * sx)) |
+           (spread((Uint32)((y - y1) * sy)) << 1);
+  }
+};
+
+// Packed R-tree over node extents in Morton order.
+//
+// Nodes are sorted by the Morton code of their center and grouped FANOUT at
+// a time into leaves; every level above groups FANOUT boxes of the level
+// below, so the tree is implicit in the level arrays and needs no pointers.
+// Boxes cover the full node rectangle, so queries return exactly the nodes
+// overlapping the range with no padding guesswork.
+//
+// Hidden nodes stay in the tree and are skipped by queries, so hiding and
+// showing nodes needs no rebuild.
+//
+// Positions may change after a build: refit() recomputes the boxes in the
+// existing order, which stays correct but loosens as nodes travel, and
+// build() re-sorts. Live edits go through update() and insert(), which
+// only refit the path from one leaf to the root.
+struct SpatialIndex {
+  static constexpr int FANOUT = 16;
+
+  const NodeStore *nodes = nullptr;
+  std::vector<int> order; // node indices in Morton order
+  // levels[0] holds the leaf boxes, levels.back() the single root box.
+  std::vector<std::vector<Rect>> levels;
+  std::vector<int> ranks; // inverse of order, built by the first update()
+  size_t edits = 0;       // update() and insert() calls since build()
+
+  void build(const NodeStore &source);
+  // Same as build() given the order a build() over the same centers
+  // produced, e.g. one read back from the layout cache. Costs one refit().
+  void adopt(const NodeStore &source, std::vector<int> sorted);
+  void refit();
+  // Node i moved or changed size.
+  void update(int i);
+  // Node i was appended to the store. It goes after every other node in
+  // the order, so it is drawn on top until the next build().
+  void insert(int i);
+  // Edits have loosened the tree enough that a build() pays for itself:
+  // moved nodes widen their leaves and inserted ones share tail leaves
+  // regardless of position.
+  bool worn() const { return edits > order.size() / 4 + 4096; }
+
+  bool empty() const { return order.empty(); }
+  Rect bounds() const {
+    return levels.empty() ? Rect{0, 0, 0, 0} : levels.back()[0];
+  }
+  size_t memory_bytes() const;
+
+  // Appends every node whose rectangle intersects range. found is not
+  // cleared so callers can keep one buffer alive across frames.
+  void query(const Rect &range, std::vector<int> &found) const;
+  // Number of nodes intersecting range, counting no further than limit.
+  size_t count(const Rect &range, size_t limit) const;
+  // Appends up to k nodes nearest (x, y) and no further than max_distance,
+  // nearest first. Distances are measured to the node rectangles, so every
+  // node under the point is at distance 0; equally distant nodes come in
+  // reverse draw order, which puts the topmost of overlapping nodes first.
+  void nearest(float x, float y, size_t k, float max_distance,
+               std::vector<int> &found) const;
+  // The topmost node under (x, y), else the nearest within radius; -1 if
+  // there is none.
+  int pick(float x, float y, float radius) const;
+
+private:
+  void refit_path(size_t rank);
+  template <typename Fn> void visit(const Rect &range, Fn fn) const;
+};
@@ -0,0 +1,100 @@
+#include "thread_pool.h"
+
+#include "parallel.h"
+
+#include "debug.h"
+
+ThreadPool::ThreadPool(int threads) {
+  if (threads <= 0)
+    threads = worker_count();
+  for (int i = 0; i < threads; ++i)
+    queues.emplace_back(new Queue);
+  for (int i = 1; i < threads; ++i)
+    workers.emplace_back(&ThreadPool::worker_main, this, i);
+  log("Thread pool: %d threads\n", threads);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(state_mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto &t : workers)
+    t.join();
+}
+
+void ThreadPool::run(int task_count, const std::function<void(int)> &fn) {
+  if (task_count <= 0)
+    return;
+  if (queues.size() == 1) {
+    for (int task = 0; task < task_count; ++task)
+      fn(task);
+    return;
+  }
+
+  job = &fn;
+  remaining.store(task_count);
+  int n = size();
+  for (int q = 0; q < n; ++q) {
+    std::lock_guard<std::mutex> lock(queues[q]->mutex);
+    for (int task = task_count * q / n; task < task_count * (q + 1) / n;
+         ++task)
+      queues[q]->tasks.push_back(task);
+  }
+  {
+    std::lock_guard<std::mutex> lock(state_mutex);
+    ++generation;
+  }
+  wake.notify_all();
+
+  work(0);
+  std::unique_lock<std::mutex> lock(state_mutex);
+  done.wait(lock, [&] { return remaining.load() == 0; });
+}
+
+// Pops from the front of the own queue, then steals from the back of the
+// others, starting with the next participant.
+bool ThreadPool::take(int self, int &task) {
+  int n = size();
+  for (int k = 0; k < n; ++k) {
+    Queue &q = *queues[(self + k) % n];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.tasks.empty())
+      continue;
+    if (k == 0) {
+      task = q.tasks.front();
+      q.tasks.pop_front();
+    } else {
+      task = q.tasks.back();
+      q.tasks.pop_back();
+    }
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::work(int self) {
+  int task;
+  while (take(self, task)) {
+    (*job)(task);
+    if (remaining.fetch_sub(1) == 1) {
+      std::lock_guard<std::mutex> lock(state_mutex);
+      done.notify_all();
+    }
+  }
+}
+
+void ThreadPool::worker_main(int self) {
+  Uint64 seen = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(state_mutex);
+      wake.wait(lock, [&] { return stopping || generation != seen; });
+      if (stopping)
+        return;
+      seen = generation;
+    }
+    work(self);
+  }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <SDL3/SDL_stdinc.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent pool for short fork-join jobs such as rendering one frame.
+//
+// run() deals the task indices out in contiguous blocks, one per
+// participant, and the calling thread works alongside the workers. A
+// participant that drains its own queue steals from the back of the
+// others, so uneven tiles do not leave threads idle.
+struct ThreadPool {
+  // threads counts the calling thread; 0 means one per hardware thread.
+  explicit ThreadPool(int threads = 0);
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+  ~ThreadPool();
+
+  int size() const { return (int)queues.size(); }
+
+  // Calls fn(task) for every task in [0, task_count) and returns when all
+  // calls have finished.
+  void run(int task_count, const std::function<void(int)> &fn);
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<int> tasks;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues; // queues[0] is the caller's
+  std::vector<std::thread> workers;
+  const std::function<void(int)> *job = nullptr;
+  std::atomic<int> remaining{0};
+
+  std::mutex state_mutex;
+  std::condition_variable wake, done;
+  Uint64 generation = 0; // guarded by state_mutex
+  bool stopping = false; // guarded by state_mutex
+
+  bool take(int self, int &task);
+  void work(int self);
+  void worker_main(int self);
+};
@@ -0,0 +1,141 @@
+#include "tile_renderer.h"
+
+#include "pixel_format.h"
+#include "raster.h"
+
+#include "debug.h"
+
+// Pixels is a PixelLayout or PixelAnyFormat.
+template <typename Pixels>
+static void draw_point(SDL_Surface *surface, const NodeStore &nodes, int i,
+                       float pan_x, float pan_y, float zoom,
+                       const SDL_Rect &clip) {
+  int cx = (int)((nodes.x[i] + pan_x) * zoom);
+  int cy = (int)((nodes.y[i] + pan_y) * zoom);
+  if (cx < clip.x || cx >= clip.x + clip.w || cy < clip.y ||
+      cy >= clip.y + clip.h)
+    return;
+  Uint32 rgba = nodes.color[i];
+  bool selected = nodes.selection.contains(i);
+  Pixels::put(surface, cx, cy, selected ? 255 : rgba_r(rgba),
+              selected ? 255 : rgba_g(rgba), selected ? 0 : rgba_b(rgba),
+              rgba_a(rgba));
+}
+
+// Counting sort of entries [0, count) into per-tile bins, keeping their
+// order. box(k, x1, y1, x2, y2) yields the inclusive pixel box of entry k;
+// boxes are clamped to the clip box and entries outside it are dropped.
+template <typename Box>
+void TileRenderer::bin(SDL_Surface *surface, size_t count, Box box) {
+  tiles_x = (surface->w + TILE - 1) / TILE;
+  tiles_y = (surface->h + TILE - 1) / TILE;
+  int tile_count = tiles_x * tiles_y;
+  tile_offsets.assign(tile_count + 1, 0);
+
+  int cx1 = clip.x, cy1 = clip.y;
+  int cx2 = clip.x + clip.w - 1, cy2 = clip.y + clip.h - 1;
+  auto tile_range = [&](size_t k, int &tx1, int &ty1, int &tx2, int &ty2) {
+    int x1, y1, x2, y2;
+    box(k, x1, y1, x2, y2);
+    if (x2 < cx1 || y2 < cy1 || x1 > cx2 || y1 > cy2)
+      return false;
+    tx1 = (x1 < cx1 ? cx1 : x1) / TILE;
+    ty1 = (y1 < cy1 ? cy1 : y1) / TILE;
+    tx2 = (x2 > cx2 ? cx2 : x2) / TILE;
+    ty2 = (y2 > cy2 ? cy2 : y2) / TILE;
+    return true;
+  };
+
+  int tx1, ty1, tx2, ty2;
+  for (size_t k = 0; k < count; ++k) {
+    if (!tile_range(k, tx1, ty1, tx2, ty2))
+      continue;
+    for (int ty = ty1; ty <= ty2; ++ty)
+      for (int tx = tx1; tx <= tx2; ++tx)
+        tile_offsets[ty * tiles_x + tx + 1]++;
+  }
+  for (int t = 0; t < tile_count; ++t)
+    tile_offsets[t + 1] += tile_offsets[t];
+  tile_entries.resize(tile_offsets[tile_count]);
+
+  std::vector<Uint32> cursor(tile_offsets.begin(), tile_offsets.end() - 1);
+  for (size_t k = 0; k < count; ++k) {
+    if (!tile_range(k, tx1, ty1, tx2, ty2))
+      continue;
+    for (int ty = ty1; ty <= ty2; ++ty)
+      for (int tx = tx1; tx <= tx2; ++tx)
+        tile_entries[cursor[ty * tiles_x + tx]++] = (Uint32)k;
+  }
+}
+
+// Tile t intersected with the clip box, as inclusive pixel bounds.
+bool TileRenderer::tile_clip(int tile, int &x1, int &y1, int &x2,
+                             int &y2) const {
+  x1 = SDL_max((tile % tiles_x) * TILE, clip.x);
+  y1 = SDL_max((tile / tiles_x) * TILE, clip.y);
+  x2 = SDL_min(((tile % tiles_x) + 1) * TILE, clip.x + clip.w) - 1;
+  y2 = SDL_min(((tile / tiles_x) + 1) * TILE, clip.y + clip.h) - 1;
+  return x1 <= x2 && y1 <= y2;
+}
+
+void TileRenderer::render_nodes(SDL_Surface *surface, const NodeStore &nodes,
+                                const std::vector<int> &visible, float pan_x,
+                                float pan_y, float zoom,
+                                const SDL_Rect &clip_rect) {
+  clip = clip_rect;
+  const SDL_PixelFormatDetails *format =
+      SDL_GetPixelFormatDetails(surface->format);
+  transform_nodes(nodes, visible, pan_x, pan_y, zoom, format, screen);
+  if (pool.size() == 1 || visible.size() < SERIAL_LIMIT) {
+    for (size_t k = 0; k < screen.size(); ++k)
+      raster_node(surface, screen, k, clip.x, clip.y, clip.x + clip.w - 1,
+                  clip.y + clip.h - 1);
+    return;
+  }
+
+  bin(surface, screen.size(),
+      [&](size_t k, int &x1, int &y1, int &x2, int &y2) {
+        screen_node_box(screen, k, x1, y1, x2, y2);
+      });
+  pool.run(tiles_x * tiles_y, [&](int tile) {
+    int clip_x1, clip_y1, clip_x2, clip_y2;
+    if (!tile_clip(tile, clip_x1, clip_y1, clip_x2, clip_y2))
+      return;
+    for (Uint32 e = tile_offsets[tile]; e < tile_offsets[tile + 1]; ++e)
+      raster_node(surface, screen, tile_entries[e], clip_x1, clip_y1, clip_x2,
+                  clip_y2);
+  });
+}
+
+void TileRenderer::render_points(SDL_Surface *surface, const NodeStore &nodes,
+                                 const std::vector<int> &visible, float pan_x,
+                                 float pan_y, float zoom,
+                                 const SDL_Rect &clip_rect) {
+  clip = clip_rect;
+  if (!with_pixel_layout(surface->format, [&](auto layout) {
+        points<decltype(layout)>(surface, nodes, visible, pan_x, pan_y, zoom);
+      }))
+    points<PixelAnyFormat>(surface, nodes, visible, pan_x, pan_y, zoom);
+}
+
+template <typename Pixels>
+void TileRenderer::points(SDL_Surface *surface, const NodeStore &nodes,
+                          const std::vector<int> &visible, float pan_x,
+                          float pan_y, float zoom) {
+  if (pool.size() == 1 || visible.size() < SERIAL_LIMIT) {
+    for (int idx : visible)
+      draw_point<Pixels>(surface, nodes, idx, pan_x, pan_y, zoom, clip);
+    return;
+  }
+
+  bin(surface, visible.size(),
+      [&](size_t k, int &x1, int &y1, int &x2, int &y2) {
+        x1 = x2 = (int)((nodes.x[visible[k]] + pan_x) * zoom);
+        y1 = y2 = (int)((nodes.y[visible[k]] + pan_y) * zoom);
+      });
+  pool.run(tiles_x * tiles_y, [&](int tile) {
+    for (Uint32 e = tile_offsets[tile]; e < tile_offsets[tile + 1]; ++e)
+      draw_point<Pixels>(surface, nodes, visible[tile_entries[e]], pan_x,
+                         pan_y, zoom, clip);
+  });
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <vector>
+
+#include "node.h"
+#include "raster.h"
+#include "thread_pool.h"
+
+// Rasterizes visible nodes on a ThreadPool by splitting the surface into
+// TILE x TILE pixel tiles. Nodes are binned to every tile their pixel box
+// touches, keeping the order of the visible list, and each tile draws its
+// bin clipped to itself. Later nodes still overwrite earlier ones pixel by
+// pixel, so the image matches the single-threaded draw exactly.
+struct TileRenderer {
+  static constexpr int TILE = 64;
+  // Below this many nodes the binning costs more than it saves.
+  static constexpr size_t SERIAL_LIMIT = 256;
+
+  ThreadPool pool;
+  int tiles_x = 0, tiles_y = 0;
+  std::vector<Uint32> tile_offsets; // tiles_x * tiles_y + 1 entries
+  std::vector<Uint32> tile_entries; // positions in the visible list
+  ScreenNodes screen;
+  SDL_Rect clip = {0, 0, 0, 0}; // of the current call
+
+  // threads counts the main thread; 0 means one per hardware thread.
+  explicit TileRenderer(int threads = 0) : pool(threads) {}
+
+  // Both calls only write pixels inside clip_rect, which must lie within
+  // the surface; those pixels do not depend on clip_rect.
+
+  // Draws node borders with the span kernel from raster.h.
+  void render_nodes(SDL_Surface *surface, const NodeStore &nodes,
+                    const std::vector<int> &visible, float pan_x, float pan_y,
+                    float zoom, const SDL_Rect &clip_rect);
+  // Draws one pixel per node at its center, through a PixelLayout picked
+  // once for the surface format when it has one.
+  void render_points(SDL_Surface *surface, const NodeStore &nodes,
+                     const std::vector<int> &visible, float pan_x, float pan_y,
+                     float zoom, const SDL_Rect &clip_rect);
+
+private:
+  template <typename Box> void bin(SDL_Surface *surface, size_t count, Box box);
+  template <typename Pixels>
+  void points(SDL_Surface *surface, const NodeStore &nodes,
+              const std::vector<int> &visible, float pan_x, float pan_y,
+              float zoom);
+  bool tile_clip(int tile, int &x1, int &y1, int &x2, int &y2) const;
+};
@@ -0,0 +1,118 @@
+#include "widgets.h"
+
+#include <string.h>
+
+SDL_Rect measure_string_widget(int x, int y, const char *str) {
+  int scale = 4;
+  int num_chars = (int)strlen(str);
+  return {x, y, 20 + num_chars * (4 * scale), 20 + (5 * scale)};
+}
+
+void draw_string_widget(SDL_Surface *surface, int x, int y, const char *str,
+                        Uint32 bg_color, Uint32 fg_color) {
+  int scale = 4;
+  SDL_Rect bg = measure_string_widget(x, y, str);
+  SDL_FillSurfaceRect(surface, &bg, bg_color);
+
+  const Uint8 font_0_9[10][15] = {
+      {1, 1, 1, 1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 1, 1}, // 0
+      {0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0}, // 1
+      {1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1}, // 2
+      {1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1}, // 3
+      {1, 0, 1, 1, 0, 1, 1, 1, 1, 0, 0, 1, 0, 0, 1}, // 4
+      {1, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 1}, // 5
+      {1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 1, 1, 1, 1}, // 6
+      {1, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1}, // 7
+      {1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1}, // 8
+      {1, 1, 1, 1, 0, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1}  // 9
+  };
+  const Uint8 font_F[15] = {1, 1, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1, 0, 0};
+  const Uint8 font_I[15] = {1, 1, 1, 0, 1, 0, 0, 1, 0, 0, 1, 0, 1, 1, 1};
+  const Uint8 font_N[15] = {1, 1, 1, 1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0, 1};
+  const Uint8 font_D[15] = {1, 1, 0, 1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 1, 0};
+  const Uint8 font_R[15] = {1, 1, 1, 1, 0, 1, 1, 1, 0, 1, 0, 1, 1, 0, 1};
+  const Uint8 font_E[15] = {1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 1};
+  const Uint8 font_S[15] = {1, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 1};
+  const Uint8 font_P[15] = {1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 0, 0, 1, 0, 0};
+  const Uint8 font_U[15] = {1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 1, 1};
+  const Uint8 font_T[15] = {1, 1, 1, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0};
+  const Uint8 font_O[15] = {1, 1, 1, 1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 1, 1};
+  const Uint8 font_SPACE[15] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  const Uint8 font_COLON[15] = {0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0};
+
+  int cursor_x = x + 10;
+  int cursor_y = y + 10;
+
+  for (int i = 0; str[i] != '\0'; ++i) {
+    const Uint8 *c_font = nullptr;
+    if (str[i] >= '0' && str[i] <= '9') {
+      c_font = font_0_9[str[i] - '0'];
+    } else if (str[i] == 'F') {
+      c_font = font_F;
+    } else if (str[i] == 'I') {
+      c_font = font_I;
+    } else if (str[i] == 'N') {
+      c_font = font_N;
+    } else if (str[i] == 'D') {
+      c_font = font_D;
+    } else if (str[i] == 'R') {
+      c_font = font_R;
+    } else if (str[i] == 'E') {
+      c_font = font_E;
+    } else if (str[i] == 'S') {
+      c_font = font_S;
+    } else if (str[i] == 'P') {
+      c_font = font_P;
+    } else if (str[i] == 'U') {
+      c_font = font_U;
+    } else if (str[i] == 'T') {
+      c_font = font_T;
+    } else if (str[i] == 'O') {
+      c_font = font_O;
+    } else if (str[i] == ' ') {
+      c_font = font_SPACE;
+    } else if (str[i] == ':') {
+      c_font = font_COLON;
+    }
+
+    if (c_font) {
+      for (int y_pos = 0; y_pos < 5; ++y_pos) {
+        for (int x_pos = 0; x_pos < 3; ++x_pos) {
+          if (c_font[y_pos * 3 + x_pos]) {
+            SDL_Rect pixel = {cursor_x + x_pos * scale,
+                              cursor_y + y_pos * scale, scale, scale};
+            SDL_FillSurfaceRect(surface, &pixel, fg_color);
+          }
+        }
+      }
+    }
+    cursor_x += 4 * scale;
+  }
+}
+
+// TTF widgets lay out and rasterize their text through the atlas, so an
+// unchanged label costs a cache lookup and a blend per covered pixel.
+static constexpr int WIDGET_TEXT_PX = 24;
+
+SDL_Rect measure_ttf_widget(int x, int y, const char *text,
+                            GlyphAtlas *atlas) {
+  const GlyphAtlas::TextRun &run = atlas->layout(text, WIDGET_TEXT_PX);
+  return {x, y, run.width + 20, run.ascent - run.descent + 20};
+}
+
+void draw_ttf_widget(SDL_Surface *surface, int x, int y, const char *text,
+                     GlyphAtlas *atlas, Uint32 bg_color, Uint32 fg_color) {
+  const GlyphAtlas::TextRun &run = atlas->layout(text, WIDGET_TEXT_PX);
+  SDL_Rect bg = {x, y, run.width + 20, run.ascent - run.descent + 20};
+  SDL_FillSurfaceRect(surface, &bg, bg_color);
+  atlas->draw(surface, run, x + 10, y + 10 + run.ascent, fg_color);
+}
+
+void draw_ui_widget(SDL_Surface *surface, int x, int y, const char *text,
+                    GlyphAtlas *atlas, Uint32 bg_color, Uint32 fg_color) {
+  if (atlas) {
+    draw_ttf_widget(surface, x, y, text, atlas, bg_color, fg_color);
+  } else {
+    draw_string_widget(surface, x, y, text, bg_color, fg_color);
+  }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+#include "glyph_atlas.h"
+
+// Overlay widgets: a text on a filled box with a 10 pixel padding. The
+// measure_* functions return the box the matching draw_* call fills.
+
+// Digits and the few capitals the UI needs, from a built-in 3x5 bitmap
+// font scaled by 4.
+SDL_Rect measure_string_widget(int x, int y, const char *str);
+void draw_string_widget(SDL_Surface *surface, int x, int y, const char *str,
+                        Uint32 bg_color, Uint32 fg_color);
+
+// Any text, laid out and rasterized through the atlas.
+SDL_Rect measure_ttf_widget(int x, int y, const char *text,
+                            GlyphAtlas *atlas);
+void draw_ttf_widget(SDL_Surface *surface, int x, int y, const char *text,
+                     GlyphAtlas *atlas, Uint32 bg_color, Uint32 fg_color);
+
+// TTF widget when a font is loaded, bitmap one otherwise.
+void draw_ui_widget(SDL_Surface *surface, int x, int y, const char *text,
+                    GlyphAtlas *atlas, Uint32 bg_color, Uint32 fg_color);
@@ -0,0 +1,279 @@
+// Converts any graph format understood by ogdf::GraphIO (GML, GraphML, DOT,
+// GEXF, TLP, ...) into the memory-mapped .gvb format loaded by the viewer.
+//
+//   gvconvert [--layout=ENGINE] [--threads=N] <input> <output.gvb>
+//   gvconvert [options] <input> <output.gvp>
+//
+// Inputs without coordinates are laid out with the selected engine (the
+// viewer's overlap removal by default), so the result opens instantly.
+// Computed layouts are cached by a hash of the input graph, so converting
+// the same graph again skips the layout; --recompute forces it.
+// A .gvp output is the paged format the viewer streams from disk for graphs
+// too large for memory; a .gvb input is read directly, without GraphIO, and
+// converts to .gvp in bounded memory however large it is.
+// Edge lists (.txt, .edges, .el, .csv, .tsv), DOT and GraphML are read by
+// the parallel importer instead of GraphIO, with progress on stderr.
+
+#include <ogdf/basic/Graph.h>
+#include <ogdf/basic/GraphAttributes.h>
+#include <ogdf/fileformats/GraphIO.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "graph_file.h"
+#include "graph_import.h"
+#include "layout.h"
+#include "layout_cache.h"
+#include "paged_graph.h"
+
+#include "debug.h"
+
+// Numeric labels win over the format's node id so that the IDs users see in
+// their source tool are the ones the viewer searches for.
+static Uint32 node_data(const ogdf::GraphAttributes &GA, ogdf::node v) {
+  const std::string &label = GA.label(v);
+  if (!label.empty()) {
+    char *end = NULL;
+    unsigned long value = strtoul(label.c_str(), &end, 10);
+    if (*end == '\0')
+      return (Uint32)value;
+  }
+  return (Uint32)GA.idNode(v);
+}
+
+static bool has_extension(const char *path, const char *ext) {
+  size_t len = strlen(path), ext_len = strlen(ext);
+  return len >= ext_len && strcmp(path + len - ext_len, ext) == 0;
+}
+
+// Places nodes randomly and runs the layout on them, or reads the result
+// back from the cache if this graph was laid out before. Keyed like the
+// viewer's layouts, so the two share cache entries.
+static void lay_out(NodeStore &nodes, const EdgeCSR &csr,
+                    const LayoutOptions &options, LayoutCache &cache) {
+  size_t count = nodes.size();
+  int side = 1;
+  while ((size_t)side * side < count)
+    side++;
+  for (size_t i = 0; i < count; ++i) {
+    nodes.x[i] = (float)(rand() % (side * 40 + 1));
+    nodes.y[i] = (float)(rand() % (side * 40 + 1));
+  }
+
+  cache.open();
+  Uint64 key = layout_cache_key(nodes, csr, options.engine);
+  std::vector<float> cached_x(count), cached_y(count);
+  if (cache.load_positions(key, count, cached_x.data(), cached_y.data())) {
+    log("No coordinates in input, using the cached %s layout\n",
+        layout_engine_name(options.engine));
+    nodes.x.assign(cached_x.begin(), cached_x.end());
+    nodes.y.assign(cached_y.begin(), cached_y.end());
+    return;
+  }
+
+  log("No coordinates in input, running %s layout\n",
+      layout_engine_name(options.engine));
+  ogdf::Graph G;
+  ogdf::GraphAttributes GA(G, ogdf::GraphAttributes::nodeGraphics);
+  std::vector<ogdf::node> ogdf_nodes(count);
+  for (size_t i = 0; i < count; ++i) {
+    ogdf::node v = G.newNode();
+    GA.x(v) = nodes.x[i];
+    GA.y(v) = nodes.y[i];
+    GA.width(v) = nodes.width[i] + 2.0f * nodes.border_thickness[i];
+    GA.height(v) = nodes.height[i] + 2.0f * nodes.border_thickness[i];
+    ogdf_nodes[i] = v;
+  }
+  for (int i = 0; csr.offsets && i < csr.node_count; ++i)
+    for (Uint64 e = csr.offsets[i]; e < csr.offsets[i + 1]; ++e)
+      G.newEdge(ogdf_nodes[i], ogdf_nodes[csr.targets[e]]);
+  run_layout(GA, options);
+  for (size_t i = 0; i < count; ++i) {
+    nodes.x[i] = (float)GA.x(ogdf_nodes[i]);
+    nodes.y[i] = (float)GA.y(ogdf_nodes[i]);
+  }
+  cache.store_positions(key, count, nodes.x.data(), nodes.y.data());
+}
+
+// Imports on this thread while another reports progress and throughput.
+static bool import_with_progress(const char *path, ImportFormat format,
+                                 ImportedGraph &out) {
+  using Clock = std::chrono::steady_clock;
+  ImportProgress progress;
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool finished = false;
+  Clock::time_point start = Clock::now();
+  auto seconds = [&]() {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  };
+  std::thread reporter([&]() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!wake.wait_for(lock, std::chrono::milliseconds(250),
+                          [&]() { return finished; })) {
+      double mb = progress.bytes_parsed.load() / 1e6;
+      double total = progress.bytes_total / 1e6;
+      fprintf(stderr, "\r%-8s %5.1f%%  %8.1f MB/s",
+              import_stage_name(progress.stage.load()),
+              total > 0.0 ? 100.0 * mb / total : 100.0, mb / seconds());
+      fflush(stderr);
+    }
+  });
+  bool ok = import_graph(path, format, out, progress);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    finished = true;
+  }
+  wake.notify_one();
+  reporter.join();
+  double elapsed = seconds();
+  if (ok)
+    fprintf(stderr, "\rRead %s: %.1f MB in %.2f s, %.1f MB/s\n", path,
+            progress.bytes_total / 1e6, elapsed,
+            progress.bytes_total / 1e6 / elapsed);
+  return ok;
+}
+
+static bool write_output(const char *path, const GraphColumns &columns) {
+  if (has_extension(path, ".gvp"))
+    return write_paged_file(path, columns);
+  return write_graph_file(path, columns);
+}
+
+static bool write_nodes(const char *path, const NodeStore &nodes,
+                        const EdgeCSR &csr) {
+  GraphColumns columns;
+  columns.node_count = nodes.size();
+  columns.x = nodes.x.data();
+  columns.y = nodes.y.data();
+  columns.width = nodes.width.data();
+  columns.height = nodes.height.data();
+  columns.border_thickness = nodes.border_thickness.data();
+  columns.color = nodes.color.data();
+  columns.data = nodes.data.data();
+  columns.edge_count = csr.edge_count;
+  columns.edge_offsets = csr.offsets;
+  columns.edge_targets = csr.targets;
+  return write_output(path, columns);
+}
+
+int main(int argc, char **argv) {
+  LayoutOptions layout_options;
+  LayoutCache cache;
+  const char *paths[2] = {NULL, NULL};
+  int path_count = 0;
+  for (int i = 1; i < argc; ++i) {
+    int parsed = parse_layout_arg(argv[i], layout_options);
+    if (parsed == 0)
+      parsed = parse_cache_arg(argv[i], cache);
+    if (parsed == 1)
+      continue;
+    if (parsed < 0 || argv[i][0] == '-' || path_count == 2) {
+      path_count = -1;
+      break;
+    }
+    paths[path_count++] = argv[i];
+  }
+  if (path_count != 2) {
+    fprintf(stderr, "usage: %s [options] <input> <output.gvb|output.gvp>\n",
+            argv[0]);
+    print_layout_usage(stderr);
+    print_cache_usage(stderr);
+    return 2;
+  }
+  const char *input_path = paths[0];
+  const char *output_path = paths[1];
+
+  if (has_extension(input_path, ".gvb")) {
+    GraphFile input;
+    if (!input.open(input_path)) {
+      fprintf(stderr, "Failed to read %s\n", input_path);
+      return 1;
+    }
+    if (!write_output(output_path, input.columns)) {
+      fprintf(stderr, "Failed to write %s\n", output_path);
+      return 1;
+    }
+    printf("Wrote %s: %llu nodes\n", output_path,
+           (unsigned long long)input.columns.node_count);
+    return 0;
+  }
+
+  ImportFormat format = import_format(input_path);
+  if (format != IMPORT_UNKNOWN) {
+    ImportedGraph input;
+    if (!import_with_progress(input_path, format, input)) {
+      fprintf(stderr, "Failed to read %s\n", input_path);
+      return 1;
+    }
+    if (!input.has_coordinates)
+      lay_out(input.nodes, input.csr, layout_options, cache);
+    if (!write_nodes(output_path, input.nodes, input.csr)) {
+      fprintf(stderr, "Failed to write %s\n", output_path);
+      return 1;
+    }
+    printf("Wrote %s: %zu nodes, %llu edges\n", output_path,
+           input.nodes.size(), (unsigned long long)input.csr.edge_count);
+    return 0;
+  }
+
+  ogdf::Graph G;
+  ogdf::GraphAttributes GA(G, ogdf::GraphAttributes::nodeGraphics |
+                                  ogdf::GraphAttributes::nodeStyle |
+                                  ogdf::GraphAttributes::nodeId |
+                                  ogdf::GraphAttributes::nodeLabel);
+  if (!ogdf::GraphIO::read(GA, G, input_path)) {
+    fprintf(stderr, "Failed to read %s\n", input_path);
+    return 1;
+  }
+  log("Read %s: %d nodes, %d edges\n", input_path, G.numberOfNodes(),
+      G.numberOfEdges());
+
+  bool has_coordinates = false;
+  size_t n = (size_t)G.numberOfNodes();
+  NodeStore nodes;
+  nodes.resize(n);
+  ogdf::NodeArray<int> index(G);
+  size_t i = 0;
+  for (ogdf::node v : G.nodes) {
+    // GA sizes include the border on both sides, node store sizes do not.
+    float t = GA.strokeWidth(v);
+    const ogdf::Color &c = GA.fillColor(v);
+    index[v] = (int)i;
+    nodes.x[i] = (float)GA.x(v);
+    nodes.y[i] = (float)GA.y(v);
+    nodes.width[i] = (float)GA.width(v) - 2.0f * t;
+    nodes.height[i] = (float)GA.height(v) - 2.0f * t;
+    nodes.border_thickness[i] = t;
+    nodes.color[i] = pack_rgba(c.red(), c.green(), c.blue(), c.alpha());
+    nodes.data[i] = node_data(GA, v);
+    has_coordinates |= GA.x(v) != 0.0 || GA.y(v) != 0.0;
+    i++;
+  }
+
+  std::vector<Uint32> sources, targets;
+  sources.reserve(G.numberOfEdges());
+  targets.reserve(G.numberOfEdges());
+  for (ogdf::edge e : G.edges) {
+    sources.push_back((Uint32)index[e->source()]);
+    targets.push_back((Uint32)index[e->target()]);
+  }
+  EdgeCSR csr;
+  csr.assign((int)n, sources.data(), targets.data(), sources.size());
+
+  if (!has_coordinates)
+    lay_out(nodes, csr, layout_options, cache);
+  if (!write_nodes(output_path, nodes, csr)) {
+    fprintf(stderr, "Failed to write %s\n", output_path);
+    return 1;
+  }
+  printf("Wrote %s: %zu nodes, %zu edges\n", output_path, n,
+         sources.size());
+  return 0;
+}